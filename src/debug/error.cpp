@@ -33,6 +33,14 @@ const char *HTMPFS_error_t::what() const noexcept
         ERROR_SWITCH_CASE(HTMPFS_INVALID_WRITE_INVOKE);
         ERROR_SWITCH_CASE(HTMPFS_INVALID_READ_INVOKE);
         ERROR_SWITCH_CASE(HTMPFS_CANNOT_REMOVE_ROOT);
+        ERROR_SWITCH_CASE(HTMPFS_JOURNAL_CURSOR_EXPIRED);
+        ERROR_SWITCH_CASE(HTMPFS_NAME_TOO_LONG);
+        ERROR_SWITCH_CASE(HTMPFS_IS_A_DIRECTORY);
+        ERROR_SWITCH_CASE(HTMPFS_INVALID_RENAME_FLAGS);
+        ERROR_SWITCH_CASE(HTMPFS_INVALID_BATCH_OPERATION);
+        ERROR_SWITCH_CASE(HTMPFS_MALFORMED_ARCHIVE);
+        ERROR_SWITCH_CASE(HTMPFS_LOWER_LAYER_ERROR);
+        ERROR_SWITCH_CASE(HTMPFS_CANNOT_MAP_FILE);
     ERROR_SWITCH_END;
 }
 
@@ -73,5 +81,13 @@ void HTMPFS_error_t::fill_out_errno()
         ERRNO_SWITCH_CASE(HTMPFS_INVALID_WRITE_INVOKE);
         ERRNO_SWITCH_CASE(HTMPFS_INVALID_READ_INVOKE);
         ERRNO_SWITCH_CASE(HTMPFS_CANNOT_REMOVE_ROOT);
+        ERRNO_SWITCH_CASE(HTMPFS_JOURNAL_CURSOR_EXPIRED);
+        ERRNO_SWITCH_CASE(HTMPFS_NAME_TOO_LONG);
+        ERRNO_SWITCH_CASE(HTMPFS_IS_A_DIRECTORY);
+        ERRNO_SWITCH_CASE(HTMPFS_INVALID_RENAME_FLAGS);
+        ERRNO_SWITCH_CASE(HTMPFS_INVALID_BATCH_OPERATION);
+        ERRNO_SWITCH_CASE(HTMPFS_MALFORMED_ARCHIVE);
+        ERRNO_SWITCH_CASE(HTMPFS_LOWER_LAYER_ERROR);
+        ERRNO_SWITCH_CASE(HTMPFS_CANNOT_MAP_FILE);
     ERRNO_SWITCH_END;
 }
@@ -14,16 +14,37 @@ buffer_t::buffer_t(const char * new_data, htmpfs_size_t length)
     }
 }
 
-htmpfs_size_t buffer_t::read(char *buffer, htmpfs_size_t length, htmpfs_size_t offset)
+buffer_t buffer_t::share(const char * bytes, htmpfs_size_t length)
 {
+    buffer_t ret;
+    ret.shared = bytes;
+    ret.shared_length = length;
+    return ret;
+}
+
+void buffer_t::unshare()
+{
+    if (!shared)
+    {
+        return;
+    }
+
+    data.assign(shared, shared + shared_length);
+    shared = nullptr;
+    shared_length = 0;
+}
+
+htmpfs_size_t buffer_t::read(char *buffer, htmpfs_size_t length, htmpfs_size_t offset) const
+{
+    const char * bytes = shared ? shared : data.data();
     htmpfs_size_t read_size;
-    if (offset > data.size())
+    if (offset > size())
     {
         read_size = 0;
     }
-    else if (data.size() < (length + offset))
+    else if (size() < (length + offset))
     {
-        read_size = data.size() - offset;
+        read_size = size() - offset;
     }
     else
     {
@@ -32,7 +53,7 @@ htmpfs_size_t buffer_t::read(char *buffer, htmpfs_size_t length, htmpfs_size_t o
 
     for (htmpfs_size_t i = 0; i < read_size; i++)
     {
-        buffer[i] = data[i + offset];
+        buffer[i] = bytes[i + offset];
     }
 
     return read_size;
@@ -41,6 +62,7 @@ htmpfs_size_t buffer_t::read(char *buffer, htmpfs_size_t length, htmpfs_size_t o
 htmpfs_size_t buffer_t::write(const char *buffer, htmpfs_size_t length, htmpfs_size_t offset, bool resize)
 {
     htmpfs_size_t write_size;
+    unshare();
 
     if (!resize)
     {
@@ -90,6 +112,11 @@ htmpfs_size_t buffer_t::write(const char *buffer, htmpfs_size_t length, htmpfs_s
 
 std::string buffer_t::to_string()
 {
+    if (shared)
+    {
+        return { shared, shared_length };
+    }
+
     std::string ret(data.begin(), data.end());
     return ret;
 }
@@ -101,6 +128,7 @@ uint64_t buffer_t::hash64()
 
 void buffer_t::truncate(htmpfs_size_t length)
 {
+    unshare();
     if (length > data.size())
     {
         htmpfs_size_t append_count = length - data.size();
@@ -0,0 +1,79 @@
+/** @file
+ *
+ * This file implements the bounded in-memory change journal
+ */
+
+#include <htmpfs/change_journal.h>
+#include <htmpfs_error.h>
+
+uint64_t change_journal_t::record(operation_t operation,
+                                  inode_id_t inode_id,
+                                  inode_id_t parent_inode_id,
+                                  inode_id_t source_parent_inode_id,
+                                  htmpfs_size_t offset,
+                                  htmpfs_size_t length)
+{
+    if (!capacity)
+    {
+        return ++last_sequence;
+    }
+
+    if (entries.size() == capacity)
+    {
+        entries.pop_front();
+    }
+
+    entries.emplace_back(entry_t {
+            .sequence = ++last_sequence,
+            .operation = operation,
+            .inode_id = inode_id,
+            .parent_inode_id = parent_inode_id,
+            .source_parent_inode_id = source_parent_inode_id,
+            .offset = offset,
+            .length = length
+    });
+
+    return last_sequence;
+}
+
+std::vector < change_journal_t::entry_t >
+change_journal_t::read(uint64_t cursor, htmpfs_size_t max_entries) const
+{
+    std::vector < entry_t > ret;
+
+    if (cursor >= last_sequence)
+    {
+        return ret;
+    }
+
+    // the entry right after cursor has been dropped
+    uint64_t oldest_sequence = entries.empty() ? last_sequence + 1 : entries.front().sequence;
+    if (cursor + 1 < oldest_sequence)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_JOURNAL_CURSOR_EXPIRED);
+    }
+
+    // sequence numbers are contiguous, locate cursor directly
+    for (auto it = entries.begin() + (htmpfs_size_t)(cursor + 1 - oldest_sequence);
+         it != entries.end() && ret.size() < max_entries;
+         it++)
+    {
+        ret.emplace_back(*it);
+    }
+
+    return ret;
+}
+
+const char * change_journal_t::operation_name(operation_t operation)
+{
+    switch (operation)
+    {
+        case JOURNAL_CREATE:    return "create";
+        case JOURNAL_UNLINK:    return "unlink";
+        case JOURNAL_RENAME:    return "rename";
+        case JOURNAL_WRITE:     return "write";
+        case JOURNAL_TRUNCATE:  return "truncate";
+        case JOURNAL_SETATTR:   return "setattr";
+        default:                return "unknown";
+    }
+}
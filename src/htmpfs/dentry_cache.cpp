@@ -0,0 +1,144 @@
+/** @file
+ *
+ * This file implements the dentry cache
+ */
+
+#include <htmpfs/dentry_cache.h>
+#include <iterator>
+
+void dentry_cache_t::emplace(inode_id_t parent_inode_id, std::string_view version,
+                             std::string_view name, inode_id_t inode_id, bool negative)
+{
+    if (!capacity)
+    {
+        return;
+    }
+
+    directory_key_t key { .parent_inode_id = parent_inode_id, .version = snapshot_ver_t(version) };
+    auto & directory = directories[key];
+
+    auto it = directory.find(name);
+    if (it != directory.end())
+    {
+        it->second->inode_id = inode_id;
+        it->second->negative = negative;
+        lru.splice(lru.begin(), lru, it->second);
+        return;
+    }
+
+    lru.emplace_front(entry_t {
+            .directory = key,
+            .name = std::string(name),
+            .inode_id = inode_id,
+            .negative = negative
+    });
+    directory.emplace(lru.front().name, lru.begin());
+
+    if (lru.size() > capacity)
+    {
+        erase(std::prev(lru.end()));
+    }
+}
+
+void dentry_cache_t::erase(entry_iterator_t entry)
+{
+    auto directory = directories.find(entry->directory);
+    directory->second.erase(entry->name);
+    if (directory->second.empty())
+    {
+        directories.erase(directory);
+    }
+
+    lru.erase(entry);
+}
+
+dentry_cache_t::lookup_result_t dentry_cache_t::lookup(inode_id_t parent_inode_id,
+                                                       std::string_view version,
+                                                       std::string_view name,
+                                                       inode_id_t & inode_id)
+{
+    auto directory = directories.find(directory_key_view_t { .parent_inode_id = parent_inode_id, .version = version });
+    if (directory == directories.end())
+    {
+        return DENTRY_CACHE_MISS;
+    }
+
+    auto it = directory->second.find(name);
+    if (it == directory->second.end())
+    {
+        return DENTRY_CACHE_MISS;
+    }
+
+    lru.splice(lru.begin(), lru, it->second);
+
+    if (it->second->negative)
+    {
+        return DENTRY_CACHE_NEGATIVE;
+    }
+
+    inode_id = it->second->inode_id;
+    return DENTRY_CACHE_HIT;
+}
+
+void dentry_cache_t::insert(inode_id_t parent_inode_id, std::string_view version,
+                            std::string_view name, inode_id_t inode_id)
+{
+    emplace(parent_inode_id, version, name, inode_id, false);
+}
+
+void dentry_cache_t::insert_negative(inode_id_t parent_inode_id, std::string_view version,
+                                     std::string_view name)
+{
+    emplace(parent_inode_id, version, name, 0, true);
+}
+
+void dentry_cache_t::invalidate(inode_id_t parent_inode_id, std::string_view version,
+                                std::string_view name)
+{
+    auto directory = directories.find(directory_key_view_t { .parent_inode_id = parent_inode_id, .version = version });
+    if (directory == directories.end())
+    {
+        return;
+    }
+
+    auto it = directory->second.find(name);
+    if (it != directory->second.end())
+    {
+        erase(it->second);
+    }
+}
+
+void dentry_cache_t::invalidate_directory(inode_id_t parent_inode_id, std::string_view version)
+{
+    auto directory = directories.find(directory_key_view_t { .parent_inode_id = parent_inode_id, .version = version });
+    if (directory == directories.end())
+    {
+        return;
+    }
+
+    for (const auto & i : directory->second)
+    {
+        lru.erase(i.second);
+    }
+
+    directories.erase(directory);
+}
+
+void dentry_cache_t::invalidate_version(std::string_view version)
+{
+    for (auto directory = directories.begin(); directory != directories.end(); )
+    {
+        if (directory->first.version != version)
+        {
+            directory++;
+            continue;
+        }
+
+        for (const auto & i : directory->second)
+        {
+            lru.erase(i.second);
+        }
+
+        directory = directories.erase(directory);
+    }
+}
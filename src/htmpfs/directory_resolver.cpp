@@ -10,6 +10,7 @@
 #include <functional>
 #include <algorithm>
 #include <utility>
+#include <cstddef>
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
 
@@ -33,15 +34,41 @@ inline Type string_to_type(const std::string & str)
     return ret;
 }
 
-template < typename Type >
-inline void delete_elem_of_str_at_head(std::string & str)
+/// append an unsigned LEB128 varint
+inline void encode_varint(std::string & str, uint64_t val)
 {
-    for (uint64_t i = 0; i < sizeof(Type); i++)
+    while (val >= 0x80)
     {
-        if (!str.empty()) {
-            str.erase(str.begin());
+        str += (char)(uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+
+    str += (char)(uint8_t)val;
+}
+
+/// decode an unsigned LEB128 varint at offset, offset is moved past it
+inline uint64_t decode_varint(const std::string & str, htmpfs_size_t & offset)
+{
+    uint64_t val = 0;
+    for (uint64_t shift = 0; offset < str.length() && shift < 64; shift += 7)
+    {
+        auto byte = (uint8_t)str[offset++];
+        val |= (uint64_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            break;
         }
     }
+
+    return val;
+}
+
+directory_resolver_t::parsed_directory_t::~parsed_directory_t()
+{
+    for (const auto & i : path)
+    {
+        names->unlink(i.name);
+    }
 }
 
 directory_resolver_t::directory_resolver_t(inode_t *_associated_inode, snapshot_ver_t ver)
@@ -53,21 +80,75 @@ directory_resolver_t::directory_resolver_t(inode_t *_associated_inode, snapshot_
 
     associated_inode = _associated_inode;
     access_version = std::move(ver);
+
+    // dentries of a directory still on lower layer are made on first access
+    if (associated_inode->lower_pending && access_version == FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        associated_inode->filesystem->populate_lower_directory(associated_inode);
+    }
+
+    // reuse parsed directory of version 0
+    if (access_version == FILESYSTEM_CUR_MODIFIABLE_VER && associated_inode->parsed_directory)
+    {
+        directory = associated_inode->parsed_directory;
+        return;
+    }
+
     refresh();
 }
 
+directory_resolver_t::~directory_resolver_t()
+{
+    // cached directory no longer matches inode
+    if (is_dirty && associated_inode->parsed_directory == directory)
+    {
+        associated_inode->parsed_directory.reset();
+        invalidate_dentry_cache();
+    }
+}
+
+void directory_resolver_t::invalidate_dentry_cache(const std::string & pathname)
+{
+    if (!associated_inode->filesystem)
+    {
+        return;
+    }
+
+    auto & dentry_cache = associated_inode->filesystem->dentry_cache;
+    if (pathname.empty())
+    {
+        dentry_cache.invalidate_directory(associated_inode->inode_id, access_version);
+        return;
+    }
+
+    dentry_cache.invalidate(associated_inode->inode_id, access_version, pathname);
+}
+
 void directory_resolver_t::refresh()
 {
-    path.clear();
+    // unsaved changes may have been seen by lookups
+    if (is_dirty)
+    {
+        invalidate_dentry_cache();
+    }
+
+    directory = std::make_shared < parsed_directory_t > (&associated_inode->filesystem->name_table);
+    is_dirty = false;
+
+    if (access_version == FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        associated_inode->parsed_directory = directory;
+    }
+
+    // an empty directory still reserves room for record count
+    directory->persisted_length = sizeof(uint64_t);
 
     if (associated_inode->current_data_size(access_version) == 0)
     {
         return;
     }
 
-    std::string name, inode_id;
     std::string all_path = associated_inode->to_string(access_version);
-    char name_buff[129] { };
 
     // ignore empty dentry
     if (all_path.empty())
@@ -75,103 +156,282 @@ void directory_resolver_t::refresh()
         return;
     }
 
-    // get save pack count, which is at the head of the string
-    auto save_pack_count = string_to_type<uint64_t>(all_path);
-    delete_elem_of_str_at_head<uint64_t>(all_path);
+    // get record count, which is at the head of the string
+    auto record_count = string_to_type<uint64_t>(all_path);
+    htmpfs_size_t offset = sizeof(uint64_t);
+
+    directory->path.reserve(record_count);
+    directory->path_index.reserve(record_count);
 
-    for (uint64_t i = 0; i < save_pack_count; i++)
+    // name of current record, prefix is shared with previous record
+    std::string name;
+    name.reserve(DENTRY_NAME_MAX);
+    for (uint64_t i = 0; i < record_count; i++)
     {
-        flat_path_pack_t save_pack;
-        path_pack_t runtime_path_pack;
+        dentry_record_head_t head { };
+        dentry_slot_t slot;
+        slot.record_offset = offset;
+        slot.cookie = ++directory->last_cookie;
 
-        save_pack = string_to_type<flat_path_pack_t>(all_path);
-        delete_elem_of_str_at_head<flat_path_pack_t>(all_path);
-        strcpy(name_buff, save_pack.pathname);
-        runtime_path_pack.pathname = name_buff;
-        runtime_path_pack.inode_id = save_pack.inode_id;
+        memcpy(&head, all_path.c_str() + offset, sizeof(head));
+        offset += sizeof(head);
+        slot.inode_id = decode_varint(all_path, offset);
+        name.resize(head.shared_length);
+        name.append(all_path, offset, head.suffix_length);
+        offset += head.suffix_length;
+        slot.name = directory->names->intern(name);
 
-        path.emplace_back(runtime_path_pack);
+        // tombstone
+        if (head.flags & record_removed)
+        {
+            slot.removed = true;
+            directory->path.emplace_back(slot);
+            directory->tombstone_count++;
+            continue;
+        }
+
+        directory->path_index.emplace(slot.name, directory->path.size());
+        directory->path.emplace_back(slot);
     }
+
+    directory->persisted_count = record_count;
+    directory->persisted_length = offset;
 }
 
-std::vector < directory_resolver_t::path_pack_t > directory_resolver_t::to_vector()
+std::string directory_resolver_t::encode_records(htmpfs_size_t begin, htmpfs_size_t end, htmpfs_size_t offset)
 {
-    return path;
+    std::string ret;
+
+    for (htmpfs_size_t i = begin; i < end; i++)
+    {
+        auto name = directory->names->get(directory->path[i].name);
+        auto previous_name = i == 0 ? std::string_view() : directory->names->get(directory->path[i - 1].name);
+
+        // shared prefix with previous record
+        htmpfs_size_t shared_length = 0;
+        htmpfs_size_t max_shared_length = MIN(name.length(), previous_name.length());
+        while (shared_length < max_shared_length && name[shared_length] == previous_name[shared_length])
+        {
+            shared_length++;
+        }
+
+        dentry_record_head_t head {
+            .flags = (uint8_t)(directory->path[i].removed ? record_removed : 0),
+            .shared_length = (uint8_t)shared_length,
+            .suffix_length = (uint8_t)(name.length() - shared_length),
+        };
+
+        directory->path[i].record_offset = offset + ret.length();
+        ret += type_to_string(head);
+        encode_varint(ret, directory->path[i].inode_id);
+        ret.append(name.substr(shared_length));
+    }
+
+    return ret;
 }
 
-void directory_resolver_t::add_path(const std::string & pathname, uint64_t inode_id)
+void directory_resolver_t::compact()
+{
+    std::vector < dentry_slot_t > live;
+    live.reserve(directory->path_index.size());
+
+    for (auto & i : directory->path)
+    {
+        if (i.removed)
+        {
+            directory->names->unlink(i.name);
+            continue;
+        }
+
+        directory->path_index[i.name] = live.size();
+        live.emplace_back(i);
+    }
+
+    directory->path = std::move(live);
+    directory->tombstone_count = 0;
+}
+
+std::vector < directory_resolver_t::path_pack_t > directory_resolver_t::to_vector()
 {
-    for (const auto& i : path)
+    std::vector < path_pack_t > ret;
+    ret.reserve(directory->path_index.size());
+
+    for (const auto & i : directory->path)
     {
-        if ( pathname.length() == i.pathname.length() &&
-            !memcmp(i.pathname.c_str(), pathname.c_str(),  pathname.length()) )
+        if (!i.removed)
         {
-            THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_MKPATHNAME);
+            ret.emplace_back(path_pack_t {
+                    .pathname = std::string(directory->names->get(i.name)),
+                    .inode_id = i.inode_id
+            });
         }
     }
 
-    path.emplace_back(path_pack_t { .pathname = pathname, .inode_id = inode_id} );
+    return ret;
 }
 
-uint64_t directory_resolver_t::namei(const std::string & pathname)
+void directory_resolver_t::add_path(const std::string & pathname, uint64_t inode_id)
 {
-    for (const auto& i : path)
+    if (pathname.empty())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
+    }
+
+    if (pathname.length() > DENTRY_NAME_MAX)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NAME_TOO_LONG);
+    }
+
+    auto name = directory->names->intern(pathname);
+    if (!directory->path_index.emplace(name, directory->path.size()).second)
     {
-        if (    (pathname.length() == i.pathname.length())
-            && (!memcmp(i.pathname.c_str(), pathname.c_str(),pathname.length()))
-                    )
+        directory->names->unlink(name);
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_MKPATHNAME);
+    }
+
+    directory->path.emplace_back(dentry_slot_t {
+            .inode_id = inode_id,
+            .cookie = ++directory->last_cookie,
+            .name = name
+    });
+    invalidate_dentry_cache(pathname);
+    is_dirty = true;
+}
+
+void directory_resolver_t::readdir(uint64_t after_cookie,
+                                   const std::function < bool (const char *, uint64_t, uint64_t) > & func)
+{
+    auto & path = directory->path;
+
+    // cookies increase in dentry order
+    auto it = std::upper_bound(path.begin(), path.end(), after_cookie,
+                               [](uint64_t cookie, const dentry_slot_t & slot) { return cookie < slot.cookie; });
+
+    for (; it != path.end(); it++)
+    {
+        if (!it->removed && !func(directory->names->c_str(it->name), it->inode_id, it->cookie))
         {
-            return i.inode_id;
+            return;
         }
     }
+}
+
+uint64_t directory_resolver_t::namei(std::string_view pathname)
+{
+    uint64_t inode_id = 0;
+    if (lookup(pathname, inode_id))
+    {
+        return inode_id;
+    }
 
     THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
 }
 
-void directory_resolver_t::save_current()
+bool directory_resolver_t::lookup(std::string_view pathname, uint64_t & inode_id)
 {
-    std::string ret;
-    ret += type_to_string<uint64_t>(path.size());
-
-    for (const auto& i : path)
+    // a name unknown to name table exists in no directory
+    auto name = directory->names->find(pathname);
+    if (name == name_table_t::no_name)
     {
-        flat_path_pack_t save_pack;
-        memcpy(save_pack.pathname,
-               i.pathname.c_str(),
-               MIN ( sizeof(save_pack.pathname), i.pathname.size() )
-               );
-        save_pack.inode_id = i.inode_id;
+        return false;
+    }
 
-        ret += type_to_string(save_pack);
+    auto it = directory->path_index.find(name);
+    if (it == directory->path_index.end())
+    {
+        return false;
     }
 
+    inode_id = directory->path[it->second].inode_id;
+    return true;
+}
+
+void directory_resolver_t::save_all()
+{
+    std::string ret = type_to_string<uint64_t>(directory->path.size());
+    ret += encode_records(0, directory->path.size(), sizeof(uint64_t));
+
     associated_inode->write(ret.c_str(), ret.length(), 0,
                             true, __dentry_only(true));
+
+    directory->persisted_count = directory->path.size();
+    directory->persisted_length = ret.length();
+    directory->pending_removals.clear();
+    is_dirty = false;
 }
 
-bool directory_resolver_t::check_availability(const std::string &pathname)
+void directory_resolver_t::save_current()
 {
-    return !std::ranges::any_of(path.cbegin(), path.cend(), [&](const path_pack_t & i)->bool
-                        {
-                            return ( i.pathname.length() == pathname.length() &&
-                                    !memcmp(i.pathname.c_str(), pathname.c_str(),pathname.length())
-                            );
-                        });
+    // compact tombstones, rewrite whole directory
+    if (directory->tombstone_count > directory->path_index.size())
+    {
+        compact();
+        save_all();
+        return;
+    }
+
+    // nothing changed
+    if (directory->pending_removals.empty() && directory->persisted_count == directory->path.size())
+    {
+        is_dirty = false;
+        return;
+    }
+
+    // set tombstone flag of removed records in place
+    const uint8_t flags = record_removed;
+    for (const auto & i : directory->pending_removals)
+    {
+        associated_inode->write((const char*)&flags, sizeof(flags),
+                                directory->path[i].record_offset + offsetof(dentry_record_head_t, flags),
+                                false, __dentry_only(true));
+    }
+    directory->pending_removals.clear();
+
+    // append new records
+    if (directory->path.size() > directory->persisted_count)
+    {
+        std::string appended = encode_records(directory->persisted_count, directory->path.size(),
+                                              directory->persisted_length);
+        associated_inode->write(appended.c_str(), appended.length(), directory->persisted_length,
+                                true, __dentry_only(true));
+
+        // update record count
+        directory->persisted_count = directory->path.size();
+        directory->persisted_length += appended.length();
+        std::string count = type_to_string<uint64_t>(directory->persisted_count);
+        associated_inode->write(count.c_str(), count.length(), 0,
+                                false, __dentry_only(true));
+    }
+
+    is_dirty = false;
+}
+
+bool directory_resolver_t::check_availability(std::string_view pathname)
+{
+    uint64_t inode_id;
+    return !lookup(pathname, inode_id);
 }
 
 void directory_resolver_t::remove_path(const std::string &pathname)
 {
-    for (auto i = path.begin(); i != path.end(); i++)
+    auto name = directory->names->find(pathname);
+    auto it = name == name_table_t::no_name ? directory->path_index.end() : directory->path_index.find(name);
+    if (it == directory->path_index.end())
     {
-        if ( i->pathname.length() == pathname.length() &&
-            !memcmp(i->pathname.c_str(), pathname.c_str(),pathname.length())
-            )
-        {
-            path.erase(i);
-            return;
-        }
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND,
+                                  "No dentry matching provided name under current parent inode");
+    }
+
+    // leave a tombstone, so that order and positions of other dentries are kept
+    // tombstones keep their name for prefix compression, and are compacted by save_current()
+    if (it->second < directory->persisted_count)
+    {
+        directory->pending_removals.emplace_back(it->second);
     }
 
-    THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND,
-                              "No dentry matching provided name under current parent inode");
+    directory->path[it->second].removed = true;
+    directory->path_index.erase(it);
+    directory->tombstone_count++;
+    invalidate_dentry_cache(pathname);
+    is_dirty = true;
 }
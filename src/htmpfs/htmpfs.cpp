@@ -7,7 +7,15 @@
 #include <algorithm>
 #include <htmpfs_error.h>
 #include <htmpfs/directory_resolver.h>
+#include <htmpfs/tree_walker.h>
 #include <sstream>
+#include <functional>
+#include <tuple>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #define VERIFY_DATA_OPS_LEN(operation, len) \
     if ((operation) != len)                 \
@@ -15,11 +23,25 @@
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_BUFFER_SHORT_OPS); \
     } __asm__("nop")
 
-inode_t::inode_t(uint64_t _block_size, inode_id_t _inode_id, inode_smi_t * _filesystem, bool _is_dentry)
-: block_size(_block_size), inode_id(_inode_id), filesystem(_filesystem), is_dentry(_is_dentry)
+inode_t::inode_t(inode_id_t _inode_id, inode_smi_t * _filesystem, bool _is_dentry)
+: inode_id(_inode_id), filesystem(_filesystem), is_dentry(_is_dentry)
 {
-    // create root snapshot
-    buffer_map.emplace(FILESYSTEM_CUR_MODIFIABLE_VER, std::vector < buffer_result_t >());
+}
+
+inode_t::block_list_t * inode_t::find_block_list(const snapshot_ver_t & version)
+{
+    if (version == FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        return &current_blocks;
+    }
+
+    if (!snapshot_blocks)
+    {
+        return nullptr;
+    }
+
+    auto it = snapshot_blocks->find(version);
+    return it == snapshot_blocks->end() ? nullptr : &it->second;
 }
 
 htmpfs_size_t inode_t::write(const char *buffer,
@@ -45,7 +67,24 @@ htmpfs_size_t inode_t::write(const char *buffer,
 
     /**                     SANITY CHECK END                    **/
 
-    auto &snapshot_0_block_list = buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER);
+    // data still on lower layer is copied up before it changes
+    if (lower_pending)
+    {
+        filesystem->copy_up_lower_file(this);
+    }
+
+    // dentry changes are journaled as create/unlink/rename by their callers
+    if (!__is_dentry())
+    {
+        filesystem->change_journal.record(change_journal_t::JOURNAL_WRITE, inode_id,
+                                          change_journal_t::no_parent, change_journal_t::no_parent,
+                                          offset, length);
+        filesystem->touch_write_recency(inode_id);
+    }
+
+    content_generation++;
+    const htmpfs_size_t block_size = filesystem->block_size;
+    auto &snapshot_0_block_list = current_blocks;
 
     htmpfs_size_t offset_for_starting_buffer = offset % block_size;
     buffer_id_t starting_buffer = offset / block_size;
@@ -56,7 +95,7 @@ htmpfs_size_t inode_t::write(const char *buffer,
     // if resizing buffer
     if (resize)
     {
-        truncate(offset + length);
+        resize_data(offset + length);
 
         /*
          *     A       B       C       D       E       F
@@ -84,6 +123,12 @@ htmpfs_size_t inode_t::write(const char *buffer,
         // write_length_in_last_buffer
         write_length_in_last_buffer = remaining_write_length % block_size;
 
+        // reallocate snapshot-frozen buffers in written range
+        for (htmpfs_size_t i = starting_buffer; i <= (offset + length - 1) / block_size; i++)
+        {
+            unfreeze_block(i);
+        }
+
         // =================================================================== //
         // write starting block
         VERIFY_DATA_OPS_LEN(snapshot_0_block_list.at(starting_buffer).data->write(
@@ -143,23 +188,7 @@ htmpfs_size_t inode_t::write(const char *buffer,
              i < existing_buffer_pending_for_modification_end;
              i++)
         {
-            // if frozen buffer detected
-            if ((buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)[i])._is_snapshoted)
-            {
-                // read data from old buffer
-                char * tmp = new char [block_size];
-                auto frozen_buffer = &buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)[i];
-                uint64_t len = frozen_buffer->data->read(tmp, block_size, 0);
-
-                // allocate new buffer
-                auto new_buffer = filesystem->request_buffer_allocation();
-                new_buffer.data->write(tmp, len, 0);
-
-                // replace buffer
-                buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)[i] = new_buffer;
-
-                delete []tmp;
-            }
+            unfreeze_block(i);
         }
 
         // =================================================================== //
@@ -224,12 +253,20 @@ htmpfs_size_t inode_t::read(const snapshot_ver_t& version,
         return 0;
     }
 
-    if (buffer_map.find(version) == buffer_map.end())
+    // data not copied up yet is read from host
+    if (lower_pending && !is_dentry && version == FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        return filesystem->lower_layer->read(inode_id, buffer, length, offset);
+    }
+
+    auto * block_list = find_block_list(version);
+    if (!block_list)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
     }
 
-    auto &snapshot_block_list = buffer_map.at(version);
+    const htmpfs_size_t block_size = filesystem->block_size;
+    auto &snapshot_block_list = *block_list;
 
     htmpfs_size_t read_size;
     if (offset > current_data_size(version)) // read beyond buffer bank
@@ -307,42 +344,38 @@ htmpfs_size_t inode_t::read(const snapshot_ver_t& version,
 
 std::string inode_t::to_string(const snapshot_ver_t& version)
 {
-    if (buffer_map.empty() || !current_data_size(version))
+    if (!current_data_size(version))
     {
         return "";
     }
 
-    char * buffer = new char [block_size * buffer_map.at(version).size() + 1] { };
-    std::string ret;
+    // read directly into result, no intermediate buffer
+    std::string ret(current_data_size(version), 0);
+    auto read_len = read(version, ret.data(), ret.length(), 0);
 
-    auto read_len =
-            read(version, buffer, block_size * buffer_map.at(version).size() + 1, 0);
-
-    if (read_len != current_data_size(version))
+    if (read_len != ret.length())
     {
-        delete []buffer;
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_BUFFER_SHORT_OPS);
     }
 
-    for (uint64_t i = 0; i < read_len; i++)
-    {
-        ret += buffer[i];
-    }
-
-    delete []buffer;
     return ret;
 }
 
 htmpfs_size_t inode_t::current_data_size(const snapshot_ver_t& version)
 {
-    auto it = buffer_map.find(version);
-    if (it == buffer_map.end())
+    if (lower_pending && !is_dentry && version == FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        return filesystem->lower_layer->data_size(inode_id);
+    }
+
+    auto * block_list = find_block_list(version);
+    if (!block_list)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
     }
 
     htmpfs_size_t size = 0;
-    auto & vec = it->second;
+    auto & vec = *block_list;
     for (const auto & i : vec)
     {
         size += i.data->size();
@@ -353,14 +386,15 @@ htmpfs_size_t inode_t::current_data_size(const snapshot_ver_t& version)
 
 void inode_t::create_new_volume(const snapshot_ver_t& volume_version)
 {
-    if (buffer_map.find(volume_version) != buffer_map.end())
+    if (find_block_list(volume_version))
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_SNAPSHOT);
     }
 
-    std::vector < buffer_result_t > new_volume;
+    block_list_t new_volume;
+    new_volume.reserve(current_blocks.size());
 
-    for (auto & i : buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER))
+    for (auto & i : current_blocks)
     {
         // frozen this buffer
         i._is_snapshoted = 1;
@@ -370,24 +404,86 @@ void inode_t::create_new_volume(const snapshot_ver_t& volume_version)
         filesystem->link_buffer(i.id);
     }
 
-    buffer_map.emplace(volume_version, new_volume);
+    if (!snapshot_blocks)
+    {
+        snapshot_blocks = std::make_unique < snapshot_block_map_t > ();
+    }
+
+    snapshot_blocks->emplace(volume_version, std::move(new_volume));
+}
+
+void inode_t::unfreeze_block(htmpfs_size_t index)
+{
+    auto & block = current_blocks.at(index);
+    if (!block._is_snapshoted)
+    {
+        return;
+    }
+
+    const htmpfs_size_t block_size = filesystem->block_size;
+
+    // read data from frozen buffer
+    data_t tmp(block_size);
+    uint64_t len = block.data->read(tmp.data(), block_size, 0);
+
+    // allocate new buffer
+    auto new_buffer = filesystem->request_buffer_allocation();
+    new_buffer.data->write(tmp.data(), len, 0);
+
+    // drop link held by version 0, frozen buffer is still linked by snapshot volumes
+    filesystem->unlink_buffer(block.id);
+    block = new_buffer;
+}
+
+htmpfs_size_t inode_t::break_frozen_blocks(htmpfs_size_t byte_budget, bool & done)
+{
+    auto & snapshot_0_block_list = current_blocks;
+    const htmpfs_size_t block_size = filesystem->block_size;
+    htmpfs_size_t copied = 0;
+    done = false;
+
+    for (htmpfs_size_t i = 0; i < snapshot_0_block_list.size(); i++)
+    {
+        if (!snapshot_0_block_list[i]._is_snapshoted)
+        {
+            continue;
+        }
+
+        // out of budget
+        if (copied + block_size > byte_budget)
+        {
+            return copied;
+        }
+
+        unfreeze_block(i);
+        copied += block_size;
+    }
+
+    done = true;
+    return copied;
 }
 
 void inode_t::delete_volume(const snapshot_ver_t& volume_version)
 {
-    if ((volume_version == FILESYSTEM_CUR_MODIFIABLE_VER)
-    || (buffer_map.find(volume_version) == buffer_map.end()))
+    auto * block_list = find_block_list(volume_version);
+    if ((volume_version == FILESYSTEM_CUR_MODIFIABLE_VER) || !block_list)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
     }
 
-    for (auto & i : buffer_map.at(volume_version))
+    for (auto & i : *block_list)
     {
         // create a new link for buffer
         filesystem->unlink_buffer(i.id);
     }
 
-    buffer_map.erase(volume_version);
+    snapshot_blocks->erase(volume_version);
+
+    // most inodes never outlive their last snapshot volume, give the map back
+    if (snapshot_blocks->empty())
+    {
+        snapshot_blocks.reset();
+    }
 }
 
 //htmpfs_size_t inode_t::block_count(const snapshot_ver_t& version)
@@ -402,192 +498,79 @@ void inode_t::delete_volume(const snapshot_ver_t& volume_version)
 
 void inode_t::truncate(htmpfs_size_t length)
 {
-    auto & snapshot_0_block_list = buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER);
-    // check buffer bank availability
-    htmpfs_size_t current_bank_size = snapshot_0_block_list.size() * block_size;
-    htmpfs_size_t length_after_write = length;
-    htmpfs_size_t offset = 0;
+    filesystem->change_journal.record(change_journal_t::JOURNAL_TRUNCATE, inode_id,
+                                      change_journal_t::no_parent, change_journal_t::no_parent,
+                                      length);
 
-    // meet bank size shortage, i.e., grow bank at the end of the buffer list
-    if (current_bank_size < length_after_write)
+    // only data kept by truncate is copied up
+    if (lower_pending)
     {
-        // first, calculate how much additional buffer is required
-        htmpfs_size_t wanted_size = length_after_write - current_bank_size;
-        htmpfs_size_t wanted_buffer_count = wanted_size / block_size + (wanted_size % block_size != 0);
-
-        // append these additional buffer
-        for (htmpfs_size_t i = 0; i < wanted_buffer_count; i++)
-        {
-            // emplace lost buffer
-            auto result = filesystem->request_buffer_allocation();
-            snapshot_0_block_list.emplace_back(result);
-        }
-
-        // second, check how many buffer (since offset) need to be reallocated
-        // because of snapshot
-        // before we do that, let's see how much existing buffer needs to be modified
-        htmpfs_size_t existing_buffer_pending_for_modification_start = offset / block_size;
-        // end - modification-starting-buffer
-        htmpfs_size_t existing_buffer_pending_for_modification_count =
-                snapshot_0_block_list.size() - existing_buffer_pending_for_modification_start;
+        filesystem->copy_up_lower_file(this, length);
+    }
 
-        // check all buffers pending for modification
-        // reallocate buffer when detecting snapshot-frozen buffers
-        for (uint64_t i = 0;
-             i < existing_buffer_pending_for_modification_count;
-             i++)
-        {
-            // if frozen buffer detected
-            if ((buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)
-            [i + existing_buffer_pending_for_modification_start])._is_snapshoted)
-            {
-                // read data from old buffer
-                char * tmp = new char [block_size];
-                auto frozen_buffer =
-                        &buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)
-                        [i + existing_buffer_pending_for_modification_start];
-                uint64_t len = frozen_buffer->data->read(tmp, block_size, 0);
-
-                // allocate new buffer
-                auto new_buffer = filesystem->request_buffer_allocation();
-                new_buffer.data->write(tmp, len, 0);
-
-                // replace buffer
-                buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)
-                [i + existing_buffer_pending_for_modification_start] = new_buffer;
-
-                delete []tmp;
-            }
-        }
+    resize_data(length);
+}
 
-    }
-    else // buffer bank is larger than wanted size
+void inode_t::resize_data(htmpfs_size_t length)
+{
+    content_generation++;
+    const htmpfs_size_t block_size = filesystem->block_size;
+    auto & snapshot_0_block_list = current_blocks;
+    htmpfs_size_t current_bank_count = snapshot_0_block_list.size();
+    htmpfs_size_t bank_count_after_resize = length / block_size + (length % block_size != 0);
+
+    // buffer bank is larger than wanted size, drop lost buffers at the end of the buffer list
+    // frozen buffers are still linked by snapshot volumes
+    if (snapshot_0_block_list.size() > bank_count_after_resize)
     {
-        // first, see how much buffer is pending for deletion
-        htmpfs_size_t current_bank_count = snapshot_0_block_list.size();
-        htmpfs_size_t bank_count_after_write =
-                length_after_write / block_size + (length_after_write % block_size != 0);
-        htmpfs_size_t lost_buffer_count = current_bank_count - bank_count_after_write;
-
-        // check frozen buffer in lost buffer list
-        for (htmpfs_size_t i = 0; i < lost_buffer_count; i++)
+        block_list_t dropped;
+        if (bank_count_after_resize == 0)
         {
-            auto last_buffer = *(--(snapshot_0_block_list.end()));
-
-            // if not a snapshot frozen buffer (now becomes a owner-less buffer)
-            if (!last_buffer._is_snapshoted)
-            {
-                // delete lost buffer
-                filesystem->unlink_buffer(last_buffer.id);
-            }
-
-            // remove buffer in the buffer list
-            snapshot_0_block_list.pop_back();
+            dropped.swap(snapshot_0_block_list);
         }
-
-        // second, check the buffer pending for modification
-        htmpfs_size_t existing_buffer_pending_for_modification_start = offset / block_size;
-        // end - modification-starting-buffer
-        htmpfs_size_t existing_buffer_pending_for_modification_end
-                = (offset + length) / block_size + (((offset + length) % block_size) != 0);
-
-        // check all buffers pending for modification
-        // reallocate buffer when detecting snapshot-frozen buffers
-        for (uint64_t i = existing_buffer_pending_for_modification_start;
-             i < existing_buffer_pending_for_modification_end;
-             i++)
+        else
         {
-            // if frozen buffer detected
-            if ((buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)[i])._is_snapshoted)
-            {
-                // read data from old buffer
-                char * tmp = new char [block_size];
-                auto frozen_buffer = &buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)[i];
-                uint64_t len = frozen_buffer->data->read(tmp, block_size, 0);
-
-                // allocate new buffer
-                auto new_buffer = filesystem->request_buffer_allocation();
-                new_buffer.data->write(tmp, len, 0);
-
-                // replace buffer
-                buffer_map.at(FILESYSTEM_CUR_MODIFIABLE_VER)[i] = new_buffer;
-
-                delete []tmp;
-            }
+            dropped.assign(snapshot_0_block_list.begin() + (int64_t)bank_count_after_resize,
+                           snapshot_0_block_list.end());
+            snapshot_0_block_list.erase(snapshot_0_block_list.begin() + (int64_t)bank_count_after_resize,
+                                        snapshot_0_block_list.end());
         }
-    }
-
-    htmpfs_size_t offset_for_starting_buffer = offset % block_size;
-    buffer_id_t starting_buffer = 0;
-    htmpfs_size_t write_length_in_starting_buffer = 0;
-    htmpfs_size_t write_length_in_last_buffer = 0;
-    htmpfs_size_t full_block_operation_count = 0;
 
-    // if offset == 0; then starting_buffer == 0;
-    // if offset != 0, but offset < block_size, then starting_buffer = 0
-    if ((!offset) or (offset < block_size)) { }
-        // offset == block_size starting_buffer == 1
-    else if (offset == block_size) { starting_buffer = 1; }
-        // if offset > block_size, then starting_buffer = offset / block_size
-    else if (offset > block_size)
-    {
-        starting_buffer = offset / block_size;
+        filesystem->reclaim_blocks(std::move(dropped));
     }
 
-    /*
-     *     A       B       C       D       E       F
-     * ++++++++.+++|===.=======.=======.=======.==|
-     * .-------.---|---.-------.-------.-------.--|----.-------.-------.
-     * |       |       |       |       |       |       |       |       |
-     * .-------.-------.-------.-------.-------.-------.-------.-------.
-     */
-
-    // write_length_in_starting_buffer
-    if ((block_size - offset_for_starting_buffer) /* remaining space in starting buffer */
-        >= length) // all write operation is in starting buffer
+    // meet bank size shortage, grow bank at the end of the buffer list
+    while (snapshot_0_block_list.size() < bank_count_after_resize)
     {
-        write_length_in_starting_buffer = length;
+        snapshot_0_block_list.emplace_back(filesystem->request_buffer_allocation());
     }
-    else // write length is beyond starting buffer
-    {
-        write_length_in_starting_buffer = block_size - offset_for_starting_buffer;
-    }
-
-    // full_block_operation_count
-    htmpfs_size_t remaining_write_length = length - write_length_in_starting_buffer;
-    full_block_operation_count = remaining_write_length / block_size;
 
-    // write_length_in_last_buffer
-    write_length_in_last_buffer = remaining_write_length % block_size;
+    // every buffer but the last one is full, so only buffers from the old last one
+    // to the new last one change in size. other buffers, frozen or not, are left untouched
+    htmpfs_size_t first_resized_buffer = std::min(current_bank_count, bank_count_after_resize);
+    first_resized_buffer = first_resized_buffer ? first_resized_buffer - 1 : 0;
 
-    // no data pending for modification, skip
-    if (length == 0)
+    for (htmpfs_size_t i = first_resized_buffer; i < bank_count_after_resize; i++)
     {
-        return;
-    }
-
-    // =================================================================== //
-    // resize block
-    snapshot_0_block_list.at(starting_buffer).data->truncate(write_length_in_starting_buffer
-                            /* + offset_for_starting_buffer */);
+        htmpfs_size_t wanted_size = block_size;
+        if (i == bank_count_after_resize - 1 && length % block_size)
+        {
+            wanted_size = length % block_size;
+        }
 
-    // full block operation
-    for (buffer_id_t i = 1; i <= full_block_operation_count; i++) {
-        snapshot_0_block_list.at(starting_buffer + i).data->truncate(block_size);
-    }
+        if (snapshot_0_block_list[i].data->size() == wanted_size)
+        {
+            continue;
+        }
 
-    // last block operation
-    if (write_length_in_last_buffer) {
-        snapshot_0_block_list.at(starting_buffer + full_block_operation_count + 1
-            ).data->truncate(write_length_in_last_buffer);
+        unfreeze_block(i);
+        snapshot_0_block_list[i].data->truncate(wanted_size);
     }
 }
 
 buffer_result_t inode_smi_t::request_buffer_allocation()
 {
-    auto id = get_free_id(buffer_pool);
-
-    buffer_pool.emplace(id, buffer_pack_t
+    auto id = buffer_pool.emplace(buffer_pack_t
             {
                     .link_count = 1,
                     .buffer = buffer_t(),
@@ -596,7 +579,7 @@ buffer_result_t inode_smi_t::request_buffer_allocation()
 
     return buffer_result_t {
         .id = id,
-        .data = &buffer_pool.at(id).buffer,
+        .data = &buffer_pool.find(id)->buffer,
         ._is_snapshoted = 0
     };
 }
@@ -604,72 +587,67 @@ buffer_result_t inode_smi_t::request_buffer_allocation()
 void inode_smi_t::unlink_buffer(buffer_id_t buffer_id)
 {
     // attempt to delete a non-exist buffer
-    auto it = buffer_pool.find(buffer_id);
-    if (it == buffer_pool.end())
+    auto * pack = buffer_pool.find(buffer_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_BUFFER_NOT_FOUND);
     }
 
-    if (it->second.link_count == 1) {
-        buffer_pool.erase(it);
+    if (pack->link_count == 1) {
+        buffer_pool.erase(buffer_id);
     } else {
-        it->second.link_count -= 1;
+        pack->link_count -= 1;
     }
 }
 
-// check is given path starts with /.snapshot/$(version)/
-snapshot_ver_t if_snapshot(const std::string & path, std::string & output)
+bool parse_snapshot_prefix(std::string_view path, std::string_view & version, std::string_view & output)
 {
-    // ignore root
-    if (path == "/")
+    path_view_t view_path(path);
+    auto head = view_path.begin();
+
+    if (head == view_path.end() || *head != ".snapshot")
     {
         output = path;
-        return FILESYSTEM_CUR_MODIFIABLE_VER;
+        return false;
     }
 
-    path_t before_parse_vec_path(path);
-    auto head = before_parse_vec_path.begin();
-    head++;
-    if (head == before_parse_vec_path.end())
+    // if no version provided
+    if (++head == view_path.end())
     {
-        return FILESYSTEM_CUR_MODIFIABLE_VER;
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
     }
 
-    snapshot_ver_t version = FILESYSTEM_CUR_MODIFIABLE_VER;
-    if (*head == ".snapshot")
-    {
-        // get snapshot version
-        head++;
-
-        // if no version provided
-        if (head == before_parse_vec_path.end())
-        {
-            THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
-        }
-
-        version = *head;
+    // pathname inside of snapshot volume starts right after version
+    version = *head;
+    output = path.substr(version.data() + version.length() - path.data());
+    return true;
+}
 
-        // parse pathname
-        head++;
-        for (auto it = head; it != before_parse_vec_path.end(); it++)
-        {
-            output += "/" + *it;
-        }
-    }
-    else
+// check is given path starts with /.snapshot/$(version)/
+snapshot_ver_t if_snapshot(const std::string & path, std::string & output)
+{
+    std::string_view version, parsed_path;
+    if (!parse_snapshot_prefix(path, version, parsed_path))
     {
         output = path;
         return FILESYSTEM_CUR_MODIFIABLE_VER;
     }
 
-    return version;
+    for (const auto & i : path_view_t(parsed_path))
+    {
+        output += "/";
+        output += i;
+    }
+
+    return snapshot_ver_t(version);
 }
 
-inode_id_t inode_smi_t::get_inode_id_by_path(const std::string & path)
+bool inode_smi_t::try_get_inode_id_by_path(std::string_view path, inode_id_t & inode_id)
 {
     if (path.empty())
     {
-        return FILESYSTEM_ROOT_INODE_NUMBER;
+        inode_id = FILESYSTEM_ROOT_INODE_NUMBER;
+        return true;
     }
 
     if (path[0] != '/')
@@ -678,48 +656,79 @@ inode_id_t inode_smi_t::get_inode_id_by_path(const std::string & path)
     }
 
     inode_id_t current_inode = 0;
-    snapshot_ver_t version;
-    std::string parsed_path;
-    version = if_snapshot(path, parsed_path);
-    path_t vec_path(parsed_path);
+    std::string_view version = FILESYSTEM_CUR_MODIFIABLE_VER;
+    std::string_view parsed_path;
+    bool is_snapshot = parse_snapshot_prefix(path, version, parsed_path);
+    path_view_t vec_path(parsed_path);
 
     // if access /.snapshot/$(version)
-    if (version != FILESYSTEM_CUR_MODIFIABLE_VER && vec_path.size() == 1)
+    if (is_snapshot && vec_path.empty())
     {
-        auto it = snapshot_version_list.find(version);
+        auto it = snapshot_version_list.find(snapshot_ver_t(version));
         if (it == snapshot_version_list.end())
         {
             THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
         }
 
-        return FILESYSTEM_ROOT_INODE_NUMBER;
+        inode_id = FILESYSTEM_ROOT_INODE_NUMBER;
+        return true;
     }
 
     // access /.snapshot/$(version)/$(pathname)
     for (const auto & i : vec_path)
     {
-        // ignore filesystem root
-        if (i.empty()) { continue; }
+        // get next level of inode from dentry cache
+        inode_id_t child_inode;
+        switch (dentry_cache.lookup(current_inode, version, i, child_inode))
+        {
+            case dentry_cache_t::DENTRY_CACHE_HIT:
+                current_inode = child_inode;
+                continue;
+
+            case dentry_cache_t::DENTRY_CACHE_NEGATIVE:
+                return false;
+
+            default:
+                break;
+        }
 
-        // get next level of inode
-        directory_resolver_t directoryResolver(&inode_pool.at(current_inode).inode, version);
-        current_inode = directoryResolver.namei(i);
+        // get next level of inode from directory
+        directory_resolver_t directoryResolver(&inode_pool.at(current_inode).inode, snapshot_ver_t(version));
+        if (!directoryResolver.lookup(i, child_inode))
+        {
+            dentry_cache.insert_negative(current_inode, version, i);
+            return false;
+        }
+
+        dentry_cache.insert(current_inode, version, i, child_inode);
+        current_inode = child_inode;
+    }
+
+    inode_id = current_inode;
+    return true;
+}
+
+inode_id_t inode_smi_t::get_inode_id_by_path(std::string_view path)
+{
+    inode_id_t inode_id = 0;
+    if (!try_get_inode_id_by_path(path, inode_id))
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
     }
 
-    return current_inode;
+    return inode_id;
 }
 
-inode_smi_t::inode_smi_t(htmpfs_size_t _block_size)
-: block_size(_block_size)
+inode_smi_t::inode_smi_t(htmpfs_size_t _block_size, htmpfs_size_t _journal_capacity)
+: block_size(_block_size), change_journal(_journal_capacity), dentry_cache(dentry_cache_capacity)
 {
+    // first slot of an empty pool, always FILESYSTEM_ROOT_INODE_NUMBER
     inode_pool.emplace
     (
-            0,
             inode_pack_t
             {
                 .link_count = 1,
                 .inode = inode_t(
-                        _block_size,
                         FILESYSTEM_ROOT_INODE_NUMBER,
                         this,
                         true)
@@ -727,39 +736,46 @@ inode_smi_t::inode_smi_t(htmpfs_size_t _block_size)
     );
 
     filesystem_root = &inode_pool.at(FILESYSTEM_ROOT_INODE_NUMBER).inode;
-    snapshot_version_list.emplace(FILESYSTEM_CUR_MODIFIABLE_VER,
-                                  std::vector <inode_result_t >
-                                          ({
-                                              inode_result_t
-                                              {
-                                                  .id = FILESYSTEM_ROOT_INODE_NUMBER,
-                                                  .inode = filesystem_root
-                                              }
-                                          })
-    );
+    published_snapshot_views.store(new snapshot_view_map_t);
+    snapshot_version_list[FILESYSTEM_CUR_MODIFIABLE_VER].insert(
+            slot_map_t < inode_pack_t >::slot_index(FILESYSTEM_ROOT_INODE_NUMBER));
+}
+
+/// check if name has no character a dentry name cannot hold
+static bool has_valid_dentry_characters(const std::string & name)
+{
+    return std::none_of(name.begin(), name.end(), [](char i) { return i == '/' || i < 0x1F || i >= 0x7F; });
+}
+
+/// check if name can be used as a dentry name
+static void check_dentry_name(const std::string & name)
+{
+    if (!has_valid_dentry_characters(name))
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
+    }
+
+    if (name.length() > DENTRY_NAME_MAX)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NAME_TOO_LONG);
+    }
 }
 
 inode_id_t inode_smi_t::make_child_dentry_under_parent(inode_id_t parent_inode_id,
                                                        const std::string & name,
                                                        bool is_dir)
 {
-    for (const auto & i : name)
-    {
-        if (i == '/' || i < 0x1F || i >= 0x7F)
-        {
-            THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
-        }
-    }
+    check_dentry_name(name);
 
     // make sure parent inode is valid
-    auto it = inode_pool.find(parent_inode_id);
-    if (it == inode_pool.end())
+    auto * pack = inode_pool.find(parent_inode_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
     // get parent inode pointer
-    inode_t * parent_inode = &it->second.inode;
+    inode_t * parent_inode = &pack->inode;
     // directory resolver
     directory_resolver_t directoryResolver(parent_inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
@@ -770,26 +786,22 @@ inode_id_t inode_smi_t::make_child_dentry_under_parent(inode_id_t parent_inode_i
     }
 
     // make a new inode
-    auto new_inode_id = get_free_id(inode_pool);
+    // inode records its own id, so id is taken before the inode is constructed
+    auto new_inode_id = inode_pool.next_id();
     inode_pool.emplace(
-            new_inode_id,
             inode_pack_t
             {
                 .link_count = 1,
-                .inode = inode_t(block_size, new_inode_id, this, is_dir)
+                .inode = inode_t(new_inode_id, this, is_dir)
             }
     );
 
     directoryResolver.add_path(name, new_inode_id);
     directoryResolver.save_current();
 
-    inode_result_t inodeResult
-            {
-        .id = new_inode_id,
-        .inode = &inode_pool.at(new_inode_id).inode
-            };
-
-    snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).emplace_back(inodeResult);
+    snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).insert(
+            slot_map_t < inode_pack_t >::slot_index(new_inode_id));
+    change_journal.record(change_journal_t::JOURNAL_CREATE, new_inode_id, parent_inode_id, parent_inode_id);
 
     return new_inode_id;
 }
@@ -797,78 +809,92 @@ inode_id_t inode_smi_t::make_child_dentry_under_parent(inode_id_t parent_inode_i
 void inode_smi_t::link_buffer(buffer_id_t buffer_id)
 {
     // attempt to link a non-exist buffer
-    auto it = buffer_pool.find(buffer_id);
-    if (it == buffer_pool.end())
+    auto * pack = buffer_pool.find(buffer_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_BUFFER_NOT_FOUND);
     }
 
-    it->second.link_count += 1;
+    pack->link_count += 1;
 }
 
 void inode_smi_t::link_inode(inode_id_t inode_id)
 {
     // attempt to link a non-exist inode
-    auto it = inode_pool.find(inode_id);
-    if (it == inode_pool.end())
+    auto * pack = inode_pool.find(inode_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
-    it->second.link_count += 1;
+    pack->link_count += 1;
 }
 
 void inode_smi_t::unlink_inode(inode_id_t inode_id)
 {
     // attempt to unlink a non-exist inode
-    auto it = inode_pool.find(inode_id);
-    if (it == inode_pool.end())
+    auto * pack = inode_pool.find(inode_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
-    it->second.link_count -= 1;
+    pack->link_count -= 1;
+
+    if (pack->link_count == 0)
+    {
+        release_inode(inode_id);
+    }
+}
 
-    if (it->second.link_count == 0)
+void inode_smi_t::release_inode(inode_id_t inode_id)
+{
+    // every snapshot volume holds a link of its own, only blocks of version 0 are left
+    auto & inode = inode_pool.at(inode_id).inode;
+    if (inode.lower_pending)
     {
-        inode_pool.erase(inode_id);
+        lower_layer->forget(inode_id);
     }
+
+    reclaim_blocks(std::move(inode.current_blocks));
+    version_history.erase(inode_id);
+    inode_pool.erase(inode_id);
 }
 
 inode_t *inode_smi_t::get_inode_by_id(inode_id_t inode_id)
 {
-    auto it = inode_pool.find(inode_id);
-    if (it == inode_pool.end())
+    auto * pack = inode_pool.find(inode_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
-    return &it->second.inode;
+    return &pack->inode;
 }
 
 void inode_smi_t::remove_child_dentry_under_parent(inode_id_t parent_inode_id, const std::string &name)
 {
     // make sure parent inode is valid
-    auto it = inode_pool.find(parent_inode_id);
-    if (it == inode_pool.end())
+    auto * pack = inode_pool.find(parent_inode_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
     // get parent inode pointer
-    inode_t * parent_inode = &it->second.inode;
+    inode_t * parent_inode = &pack->inode;
     // directory resolver
     directory_resolver_t directoryResolver(parent_inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
     auto target_id = directoryResolver.namei(name);
-    auto target_it = inode_pool.find(target_id);
+    auto * target_pack = inode_pool.find(target_id);
 
     try
     {
 #ifdef CMAKE_BUILD_DEBUG
         __disable_output = true;
 #endif // CMAKE_BUILD_DEBUG
-        directory_resolver_t if_target_is_dir(&target_it->second.inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+        directory_resolver_t if_target_is_dir(&target_pack->inode, FILESYSTEM_CUR_MODIFIABLE_VER);
         if (if_target_is_dir.target_count() != 0)
         {
 #ifdef CMAKE_BUILD_DEBUG
@@ -894,161 +920,501 @@ void inode_smi_t::remove_child_dentry_under_parent(inode_id_t parent_inode_id, c
     directoryResolver.remove_path(name);
     directoryResolver.save_current();
 
+    drop_current_link(parent_inode_id, target_id);
+}
+
+void inode_smi_t::drop_current_link(inode_id_t parent_inode_id, inode_id_t target_id)
+{
+    auto * target_pack = inode_pool.find(target_id);
+
     // remove inode in version current
-    auto * vec = &snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER);
-    for (auto vec_it = vec->begin(); vec_it != vec->end(); vec_it++)
-    {
-        if (vec_it->id == target_id)
-        {
-            vec->erase(vec_it);
-            break;
-        }
-    }
+    forget_write_recency(target_id);
+    dentry_cache.invalidate_directory(target_id, FILESYSTEM_CUR_MODIFIABLE_VER);
+    snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).erase(
+            slot_map_t < inode_pack_t >::slot_index(target_id));
+
+    change_journal.record(change_journal_t::JOURNAL_UNLINK, target_id, parent_inode_id, parent_inode_id);
 
     // remove link
-    target_it->second.link_count -= 1;
+    target_pack->link_count -= 1;
 
     // if no link is associated to this inode, remove it
-    if (target_it->second.link_count == 0)
+    if (target_pack->link_count == 0)
     {
-        inode_pool.erase(target_it);
+        release_inode(target_id);
     }
 }
 
-// don't touch this
-// i literally modified nothing and it doesn't work for some reason. don't change it
-// or you are going to waste more time than you can think of
-std::vector < std::string > inode_smi_t::export_as_filesystem_map(snapshot_ver_t version)
+void inode_smi_t::remove_tree(inode_id_t parent_inode_id, const std::string & name)
 {
-    std::vector < std::string > filesystem_map;
-    /* traverse filesystem
-     * first, a function that shows all targets within the current directory
-     * */
-
-    // get inode pathname package by parent inode
-    // basically list all inode entries in parent inode
-    auto get_sub_inode_list_by_parent =
-            [&](inode_t * parent_inode)->std::vector < directory_resolver_t::path_pack_t >
+    auto * pack = inode_pool.find(parent_inode_id);
+    if (!pack)
     {
-        directory_resolver_t directoryResolver(parent_inode, version);
-        return directoryResolver.to_vector();
-    };
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
+    }
 
-    auto make_path_for_current_dentry =
-            [&](const std::string& pathname_prefix)->std::vector < std::string >
+    directory_resolver_t directoryResolver(&pack->inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+    inode_id_t target_id;
+    if (!directoryResolver.lookup(name, target_id))
     {
-        std::vector < std::string > ret;
-        std::vector < directory_resolver_t::path_pack_t > current_sub_inode_list;
-
-        // get parent inode
-        auto * parent_inode =
-                get_inode_by_id(
-                        get_inode_id_by_path(
-                                make_path_with_version(pathname_prefix, version)
-                                )
-                );
-
-        // check if parent inode is a dentry inode
-        if (!parent_inode->__is_dentry())
-        {
-            return {};
-        }
-
-        // get sub inode list under dentry inode
-        current_sub_inode_list = get_sub_inode_list_by_parent(parent_inode);
-
-        // make pathname
-        for (const auto & i : current_sub_inode_list)
-        {
-//            sys_map.emplace_back(pathname_prefix + "/" + i.pathname);
-//            std::cout << pathname_prefix + i.pathname << std::endl;
-            filesystem_map.emplace_back(pathname_prefix + i.pathname);
-            ret.emplace_back(pathname_prefix + i.pathname);
-        }
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
+    }
 
-        return ret;
-    };
+    // detach subtree, the only directory written
+    directoryResolver.remove_path(name);
+    directoryResolver.save_current();
 
-    // recursively check filesystem tree
-    std::function < void (const std::vector < std::string > &) >
-            recursion_check = [&](const std::vector < std::string /* full pathname */ >& dentry_list)->void
+    // drop every inode of subtree, a directory is listed before it is dropped, but never rewritten
+    std::vector < std::pair < inode_id_t /* parent */, inode_id_t > > pending { { parent_inode_id, target_id } };
+    while (!pending.empty())
     {
-        for (const auto &i: dentry_list)
+        auto [parent_id, inode_id] = pending.back();
+        pending.pop_back();
+
+        // a directory still on lower layer has no dentry to drop, it is not listed from host
+        auto & inode = inode_pool.at(inode_id).inode;
+        if (inode.__is_dentry() && !inode.lower_pending)
         {
-            if (i == "/") {
-                recursion_check(make_path_for_current_dentry("/"));
-            } else {
-                recursion_check(make_path_for_current_dentry(i + "/"));
-            }
+            directory_resolver_t subdirectory(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            subdirectory.readdir(0, [&](const char *, uint64_t child_id, uint64_t)
+            {
+                pending.emplace_back(inode_id, child_id);
+                return true;
+            });
         }
-    };
 
-    recursion_check(std::vector <std::string>({"/"}));
-
-    return filesystem_map;
+        // directory may be kept by a snapshot volume, but is no longer resolved in version 0
+        inode.parsed_directory.reset();
+        drop_current_link(parent_id, inode_id);
+    }
 }
 
-buffer_t *inode_smi_t::get_buffer_by_id(buffer_id_t buffer_id)
+bool inode_smi_t::is_empty_directory(inode_id_t inode_id)
 {
-    auto it = buffer_pool.find(buffer_id);
-    if (it == buffer_pool.end())
+    auto & inode = inode_pool.at(inode_id).inode;
+    if (!inode.__is_dentry())
     {
-        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_BUFFER_NOT_FOUND);
+        return false;
     }
 
-    return &it->second.buffer;
+    directory_resolver_t directoryResolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+    return directoryResolver.target_count() == 0;
 }
 
-void inode_smi_t::create_snapshot_volume(const snapshot_ver_t& snapshot_ver)
+void inode_smi_t::rename(inode_id_t source_parent_inode_id, const std::string & source_name,
+                         inode_id_t target_parent_inode_id, const std::string & target_name,
+                         unsigned int flags)
 {
-    if (snapshot_version_list.find(snapshot_ver) != snapshot_version_list.end())
+    if ((flags & ~(RENAME_NOREPLACE | RENAME_EXCHANGE))
+        || ((flags & RENAME_NOREPLACE) && (flags & RENAME_EXCHANGE)))
     {
-        THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_SNAPSHOT);
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_RENAME_FLAGS);
     }
 
-    auto root_vec = snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER);
-    for (auto i : root_vec)
+    check_dentry_name(target_name);
+
+    auto * source_parent_pack = inode_pool.find(source_parent_inode_id);
+    auto * target_parent_pack = inode_pool.find(target_parent_inode_id);
+    if (!source_parent_pack || !target_parent_pack)
     {
-        link_inode(i.id);
-        i.inode->create_new_volume(snapshot_ver);
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
-    snapshot_version_list.emplace(snapshot_ver, root_vec);
-}
-
-void inode_smi_t::delete_snapshot_volume(const snapshot_ver_t& version)
-{
-    if (snapshot_version_list.find(version) == snapshot_version_list.end())
+    // one resolver serves both sides of a rename inside of one directory
+    directory_resolver_t source_resolver(&source_parent_pack->inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+    std::unique_ptr < directory_resolver_t > target_resolver_holder;
+    directory_resolver_t * target_resolver = &source_resolver;
+    if (target_parent_inode_id != source_parent_inode_id)
     {
-        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
+        target_resolver_holder = std::make_unique < directory_resolver_t > (&target_parent_pack->inode,
+                                                                            FILESYSTEM_CUR_MODIFIABLE_VER);
+        target_resolver = target_resolver_holder.get();
     }
 
-    auto target_vec = snapshot_version_list.at(version);
-    for (auto i : target_vec)
+    inode_id_t source_id, target_id;
+    if (!source_resolver.lookup(source_name, source_id))
     {
-        i.inode->delete_volume(version);
-        unlink_inode(i.id);
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
     }
 
-    snapshot_version_list.erase(version);
-}
+    bool target_exists = target_resolver->lookup(target_name, target_id);
 
-void inode_smi_t::remove_inode_by_path(const std::string &pathname)
-{
-    if (pathname == "/")
+    // everything is checked before the first change, so that a failed rename changes nothing
+    if ((flags & RENAME_NOREPLACE) && target_exists)
     {
-        THROW_HTMPFS_ERROR_STDERR(HTMPFS_CANNOT_REMOVE_ROOT);
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_MKPATHNAME);
     }
 
-    // parse pathname
-    path_t path(pathname);
-    inode_t * ops_inode = filesystem_root;
-    std::string target_name = *path.last();
+    if ((flags & RENAME_EXCHANGE) && !target_exists)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
+    }
 
-    auto it = ++path.begin();
-    for (uint64_t i = 0; i< path.size() - 1 /* filesystem root */ - 1 /* last target */; i++)
+    // both names refer to the same inode, nothing to do
+    if (target_exists && target_id == source_id)
     {
-        directory_resolver_t directoryResolver(ops_inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+        return;
+    }
+
+    if (target_exists && !(flags & RENAME_EXCHANGE))
+    {
+        bool source_is_dir = inode_pool.at(source_id).inode.__is_dentry();
+        bool target_is_dir = inode_pool.at(target_id).inode.__is_dentry();
+
+        if (source_is_dir && !target_is_dir)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+        }
+
+        if (!source_is_dir && target_is_dir)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_IS_A_DIRECTORY);
+        }
+
+        if (target_is_dir && !is_empty_directory(target_id))
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_DIR_NOT_EMPTY);
+        }
+    }
+
+    // update dentries, each directory is saved once
+    source_resolver.remove_path(source_name);
+    if (target_exists)
+    {
+        target_resolver->remove_path(target_name);
+    }
+
+    target_resolver->add_path(target_name, source_id);
+    if (flags & RENAME_EXCHANGE)
+    {
+        source_resolver.add_path(source_name, target_id);
+    }
+
+    source_resolver.save_current();
+    if (target_resolver != &source_resolver)
+    {
+        target_resolver->save_current();
+    }
+
+    change_journal.record(change_journal_t::JOURNAL_RENAME, source_id,
+                          target_parent_inode_id, source_parent_inode_id);
+
+    if (flags & RENAME_EXCHANGE)
+    {
+        change_journal.record(change_journal_t::JOURNAL_RENAME, target_id,
+                              source_parent_inode_id, target_parent_inode_id);
+    }
+    else if (target_exists)
+    {
+        // replaced inode
+        drop_current_link(target_parent_inode_id, target_id);
+    }
+}
+
+/// copy attributes of a namespace batch operation, file type is kept
+static void apply_batch_attributes(inode_stat_t & fs_stat, const inode_stat_t & attributes)
+{
+    fs_stat.st_mode = (fs_stat.st_mode & S_IFMT) | (attributes.st_mode & ~S_IFMT);
+    fs_stat.st_uid  = attributes.st_uid;
+    fs_stat.st_gid  = attributes.st_gid;
+    fs_stat.st_atim = attributes.st_atim;
+    fs_stat.st_mtim = attributes.st_mtim;
+    fs_stat.st_ctim = attributes.st_ctim;
+}
+
+std::vector < inode_id_t > inode_smi_t::apply_namespace_batch(const std::vector < namespace_op_t > & operations)
+{
+    // names made by the batch: (parent made by batch, parent inode id or operation index, name) -> operation index
+    typedef std::tuple < bool, uint64_t, std::string_view > batch_name_t;
+    std::map < batch_name_t, htmpfs_size_t > batch_names;
+
+    // one resolver per parent directory, shared by every operation under it
+    std::unordered_map < inode_id_t, std::unique_ptr < directory_resolver_t > > resolvers;
+    auto resolver_of = [&](inode_id_t inode_id)->directory_resolver_t &
+    {
+        auto & resolver = resolvers[inode_id];
+        if (!resolver)
+        {
+            resolver = std::make_unique < directory_resolver_t > (&inode_pool.at(inode_id).inode,
+                                                                  FILESYSTEM_CUR_MODIFIABLE_VER);
+        }
+
+        return *resolver;
+    };
+
+    std::vector < inode_id_t > result(operations.size());
+
+    // operation that made the target of a setattr, no_index if target existed before the batch
+    std::vector < htmpfs_size_t > setattr_source(operations.size(), namespace_op_t::no_index);
+
+    // everything is checked before the first change, so that a failed batch changes nothing
+    for (htmpfs_size_t i = 0; i < operations.size(); i++)
+    {
+        const auto & operation = operations[i];
+        if (operation.operation > namespace_op_t::NAMESPACE_SETATTR)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_BATCH_OPERATION);
+        }
+
+        if (operation.name.empty())
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
+        }
+
+        check_dentry_name(operation.name);
+
+        if (operation.operation == namespace_op_t::NAMESPACE_MKNOD)
+        {
+            auto type = operation.attributes.st_mode & S_IFMT;
+            if (type != S_IFIFO && type != S_IFSOCK && type != S_IFCHR && type != S_IFBLK)
+            {
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_BATCH_OPERATION);
+            }
+        }
+
+        bool parent_in_batch = operation.parent_index != namespace_op_t::no_index;
+        if (parent_in_batch)
+        {
+            // parent must be made by an earlier mkdir of the same batch
+            if (operation.parent_index >= i
+                || operations[operation.parent_index].operation != namespace_op_t::NAMESPACE_MKDIR)
+            {
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_BATCH_OPERATION);
+            }
+        }
+        else
+        {
+            auto * pack = inode_pool.find(operation.parent_inode_id);
+            if (!pack)
+            {
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
+            }
+
+            if (!pack->inode.__is_dentry())
+            {
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+            }
+        }
+
+        batch_name_t key { parent_in_batch,
+                           parent_in_batch ? operation.parent_index : operation.parent_inode_id,
+                           operation.name };
+        auto made = batch_names.find(key);
+        inode_id_t existing_id = 0;
+        bool exists = made != batch_names.end()
+                      || (!parent_in_batch && resolver_of(operation.parent_inode_id).lookup(operation.name, existing_id));
+
+        if (operation.operation == namespace_op_t::NAMESPACE_SETATTR)
+        {
+            if (!exists)
+            {
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
+            }
+
+            if (made != batch_names.end())
+            {
+                setattr_source[i] = made->second;
+            }
+            else
+            {
+                result[i] = existing_id;
+            }
+
+            continue;
+        }
+
+        if (exists)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_MKPATHNAME);
+        }
+
+        batch_names.emplace(key, i);
+    }
+
+    // make inodes and add their dentries, directories are not saved yet
+    std::vector < inode_id_t > made_inodes;
+    try
+    {
+        for (htmpfs_size_t i = 0; i < operations.size(); i++)
+        {
+            const auto & operation = operations[i];
+            if (operation.operation == namespace_op_t::NAMESPACE_SETATTR)
+            {
+                continue;
+            }
+
+            auto parent_id = operation.parent_index != namespace_op_t::no_index ?
+                             result[operation.parent_index] : operation.parent_inode_id;
+            bool is_dir = operation.operation == namespace_op_t::NAMESPACE_MKDIR;
+
+            auto new_inode_id = inode_pool.next_id();
+            inode_pool.emplace(
+                    inode_pack_t
+                    {
+                            .link_count = 1,
+                            .inode = inode_t(new_inode_id, this, is_dir)
+                    }
+            );
+
+            made_inodes.emplace_back(new_inode_id);
+            snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).insert(
+                    slot_map_t < inode_pack_t >::slot_index(new_inode_id));
+            result[i] = new_inode_id;
+
+            resolver_of(parent_id).add_path(operation.name, new_inode_id);
+        }
+    }
+    catch (...)
+    {
+        // unsaved resolvers drop their changes on destruction
+        resolvers.clear();
+        for (const auto & i : made_inodes)
+        {
+            snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).erase(slot_map_t < inode_pack_t >::slot_index(i));
+            release_inode(i);
+        }
+
+        throw;
+    }
+
+    // every directory is saved once
+    for (auto & i : resolvers)
+    {
+        i.second->save_current();
+    }
+
+    for (htmpfs_size_t i = 0; i < operations.size(); i++)
+    {
+        const auto & operation = operations[i];
+        auto parent_id = operation.parent_index != namespace_op_t::no_index ?
+                         result[operation.parent_index] : operation.parent_inode_id;
+
+        if (operation.operation == namespace_op_t::NAMESPACE_SETATTR)
+        {
+            if (setattr_source[i] != namespace_op_t::no_index)
+            {
+                result[i] = result[setattr_source[i]];
+            }
+
+            apply_batch_attributes(inode_pool.at(result[i]).inode.fs_stat, operation.attributes);
+            change_journal.record(change_journal_t::JOURNAL_SETATTR, result[i],
+                                  change_journal_t::no_parent, change_journal_t::no_parent);
+            continue;
+        }
+
+        auto & inode = inode_pool.at(result[i]).inode;
+        switch (operation.operation)
+        {
+            case namespace_op_t::NAMESPACE_MKDIR:   inode.fs_stat.st_mode = S_IFDIR; break;
+            case namespace_op_t::NAMESPACE_SYMLINK: inode.fs_stat.st_mode = S_IFLNK; break;
+            case namespace_op_t::NAMESPACE_MKNOD:
+                inode.fs_stat.st_mode = operation.attributes.st_mode & S_IFMT;
+                inode.fs_stat.st_dev = operation.attributes.st_dev;
+                break;
+            default:                                inode.fs_stat.st_mode = S_IFREG; break;
+        }
+
+        inode.fs_stat.st_nlink = 1;
+        apply_batch_attributes(inode.fs_stat, operation.attributes);
+        change_journal.record(change_journal_t::JOURNAL_CREATE, result[i], parent_id, parent_id);
+
+        if (operation.operation == namespace_op_t::NAMESPACE_SYMLINK)
+        {
+            inode.write(operation.symlink_target.c_str(), operation.symlink_target.length(), 0);
+            inode.fs_stat.st_size = (off_t)operation.symlink_target.length();
+        }
+    }
+
+    return result;
+}
+
+std::vector < std::string > inode_smi_t::export_as_filesystem_map(snapshot_ver_t version)
+{
+    std::vector < std::string > filesystem_map;
+    walk_tree(*this, version, [&](const tree_entry_t & entry)
+    {
+        filesystem_map.emplace_back(entry.pathname);
+        return TREE_WALK_CONTINUE;
+    });
+
+    return filesystem_map;
+}
+
+buffer_t *inode_smi_t::get_buffer_by_id(buffer_id_t buffer_id)
+{
+    auto * pack = buffer_pool.find(buffer_id);
+    if (!pack)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_BUFFER_NOT_FOUND);
+    }
+
+    return &pack->buffer;
+}
+
+void inode_smi_t::create_snapshot_volume(const snapshot_ver_t& snapshot_ver)
+{
+    if (snapshot_version_list.find(snapshot_ver) != snapshot_version_list.end())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_DOUBLE_SNAPSHOT);
+    }
+
+    // snapshot volumes read blocks only, files left on host are mapped into frozen blocks
+    materialize_lower_layer();
+
+    // copy shares all chunks with version 0
+    auto members = snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER);
+    members.for_each([&](uint64_t slot_index)
+    {
+        auto i = inode_in_slot(slot_index);
+        link_inode(i.id);
+        i.inode->create_new_volume(snapshot_ver);
+        record_version_history(i.inode, snapshot_ver);
+    });
+
+    snapshot_version_list.emplace(snapshot_ver, std::move(members));
+    publish_snapshot_view(snapshot_ver);
+
+    // hot inodes are about to hit COW, queue them for background break
+    cow_break_queue.assign(write_recency.begin(), write_recency.end());
+}
+
+void inode_smi_t::delete_snapshot_volume(const snapshot_ver_t& version)
+{
+    if (snapshot_version_list.find(version) == snapshot_version_list.end())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
+    }
+
+    unpublish_snapshot_view(version);
+    dentry_cache.invalidate_version(version);
+
+    snapshot_version_list.at(version).for_each([&](uint64_t slot_index)
+    {
+        auto i = inode_in_slot(slot_index);
+        i.inode->delete_volume(version);
+        forget_version_history(i.id, version);
+        unlink_inode(i.id);
+    });
+
+    snapshot_version_list.erase(version);
+}
+
+void inode_smi_t::remove_inode_by_path(const std::string &pathname)
+{
+    if (pathname == "/")
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_CANNOT_REMOVE_ROOT);
+    }
+
+    // parse pathname
+    path_t path(pathname);
+    inode_t * ops_inode = filesystem_root;
+    std::string target_name = *path.last();
+
+    auto it = ++path.begin();
+    for (uint64_t i = 0; i< path.size() - 1 /* filesystem root */ - 1 /* last target */; i++)
+    {
+        directory_resolver_t directoryResolver(ops_inode, FILESYSTEM_CUR_MODIFIABLE_VER);
         auto inode_id = directoryResolver.namei(*it);
         ops_inode = get_inode_by_id(inode_id);
         it++;
@@ -1060,12 +1426,633 @@ void inode_smi_t::remove_inode_by_path(const std::string &pathname)
 
 htmpfs_size_t inode_smi_t::count_link_for_inode(inode_id_t inode_id)
 {
-    auto it = inode_pool.find(inode_id);
-    if (it == inode_pool.end())
+    auto * pack = inode_pool.find(inode_id);
+    if (!pack)
     {
         THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
     }
 
-    return it->second.link_count;
+    return pack->link_count;
+}
+
+void inode_smi_t::record_version_history(inode_t * inode, const snapshot_ver_t & version)
+{
+    auto & history = version_history[inode->inode_id];
+
+    // content unchanged since last snapshot, share the entry
+    if (!history.empty() && history.back().content_generation == inode->content_generation)
+    {
+        history.back().versions.emplace_back(version);
+        return;
+    }
+
+    history.emplace_back(version_history_entry_t
+            {
+                    .content_generation = inode->content_generation,
+                    .data_size = inode->current_data_size(version),
+                    .versions = { version }
+            }
+    );
+}
+
+void inode_smi_t::forget_version_history(inode_id_t inode_id, const snapshot_ver_t & version)
+{
+    auto it = version_history.find(inode_id);
+    if (it == version_history.end())
+    {
+        return;
+    }
+
+    auto & history = it->second;
+    for (auto entry = history.begin(); entry != history.end(); entry++)
+    {
+        auto ver = std::find(entry->versions.begin(), entry->versions.end(), version);
+        if (ver == entry->versions.end())
+        {
+            continue;
+        }
+
+        entry->versions.erase(ver);
+        if (entry->versions.empty())
+        {
+            history.erase(entry);
+        }
+
+        break;
+    }
+
+    if (history.empty())
+    {
+        version_history.erase(it);
+    }
 }
 
+std::vector < version_history_entry_t > inode_smi_t::get_version_history(const std::string & pathname)
+{
+    auto inode_id = get_inode_id_by_path(pathname);
+    auto * inode = get_inode_by_id(inode_id);
+    std::vector < version_history_entry_t > ret;
+
+    auto it = version_history.find(inode_id);
+    if (it != version_history.end())
+    {
+        ret = it->second;
+    }
+
+    // version 0 exists as long as the inode is still linked in current filesystem
+    if (!snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).contains(
+            slot_map_t < inode_pack_t >::slot_index(inode_id)))
+    {
+        return ret;
+    }
+
+    if (!ret.empty() && ret.back().content_generation == inode->content_generation)
+    {
+        ret.back().versions.emplace_back(FILESYSTEM_CUR_MODIFIABLE_VER);
+    }
+    else
+    {
+        ret.emplace_back(version_history_entry_t
+                {
+                        .content_generation = inode->content_generation,
+                        .data_size = inode->current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER),
+                        .versions = { FILESYSTEM_CUR_MODIFIABLE_VER }
+                }
+        );
+    }
+
+    return ret;
+}
+
+inode_smi_t::~inode_smi_t()
+{
+    std::vector < snapshot_ver_t > versions;
+    for (const auto & i : *published_snapshot_views.load())
+    {
+        versions.emplace_back(i.first);
+    }
+
+    for (const auto & i : versions)
+    {
+        unpublish_snapshot_view(i);
+    }
+
+    auto * views = published_snapshot_views.exchange(nullptr);
+    snapshot_epoch.retire([views] { delete views; });
+    snapshot_epoch.collect(true);
+
+    // buffers left in buffer pool no longer read shared bytes
+    for (const auto & i : host_mappings)
+    {
+        munmap(i.first, i.second);
+    }
+}
+
+inode_result_t inode_smi_t::inode_in_slot(uint64_t slot_index)
+{
+    auto inode_id = inode_pool.id_at(slot_index);
+    return inode_result_t {
+        .id = inode_id,
+        .inode = &inode_pool.at(inode_id).inode
+    };
+}
+
+void inode_smi_t::publish_snapshot_view(const snapshot_ver_t & version)
+{
+    auto * view = new snapshot_view_t(version, block_size);
+
+    snapshot_version_list.at(version).for_each([&](uint64_t slot_index)
+    {
+        auto i = inode_in_slot(slot_index);
+        snapshot_view_t::inode_view_t inode_view;
+        inode_view.fs_stat = i.inode->fs_stat;
+        inode_view.is_dentry = i.inode->__is_dentry();
+        inode_view.data_size = i.inode->current_data_size(version);
+        inode_view.blocks = *i.inode->find_block_list(version);
+
+        if (inode_view.is_dentry)
+        {
+            directory_resolver_t directoryResolver(i.inode, version);
+            inode_view.dentries = directoryResolver.to_vector();
+        }
+
+        // view keeps frozen buffers alive until reclaimed
+        for (const auto & block : inode_view.blocks)
+        {
+            link_buffer(block.id);
+        }
+
+        view->add_inode(i.id, std::move(inode_view));
+    });
+
+    // read-copy-update the published map
+    auto * views = new snapshot_view_map_t(*published_snapshot_views.load());
+    views->emplace(version, view);
+    auto * old_views = published_snapshot_views.exchange(views);
+    snapshot_epoch.retire([old_views] { delete old_views; });
+    snapshot_epoch.collect();
+}
+
+void inode_smi_t::unpublish_snapshot_view(const snapshot_ver_t & version)
+{
+    auto * views = new snapshot_view_map_t(*published_snapshot_views.load());
+    auto it = views->find(version);
+    if (it == views->end())
+    {
+        delete views;
+        return;
+    }
+
+    auto * view = it->second;
+    views->erase(it);
+    auto * old_views = published_snapshot_views.exchange(views);
+
+    snapshot_epoch.retire([old_views] { delete old_views; });
+    retire_snapshot_view(view);
+    snapshot_epoch.collect();
+}
+
+void inode_smi_t::retire_snapshot_view(const snapshot_view_t * view)
+{
+    snapshot_epoch.retire([this, view]
+    {
+        view->for_each_block([this](const buffer_result_t & block)
+        {
+            unlink_buffer(block.id);
+        });
+
+        delete view;
+    });
+}
+
+void inode_smi_t::collect_retired()
+{
+    snapshot_epoch.collect();
+}
+
+void inode_smi_t::seal_snapshot_volume(const snapshot_ver_t & version)
+{
+    auto * views = new snapshot_view_map_t(*published_snapshot_views.load());
+    auto it = views->find(version);
+    if (it == views->end())
+    {
+        delete views;
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
+    }
+
+    if (it->second->is_sealed())
+    {
+        delete views;
+        return;
+    }
+
+    auto * view = it->second;
+    auto * sealed_view = snapshot_view_t::seal(*view);
+
+    // sealed view keeps its own links to frozen buffers
+    sealed_view->for_each_block([this](const buffer_result_t & block)
+    {
+        link_buffer(block.id);
+    });
+
+    it->second = sealed_view;
+    auto * old_views = published_snapshot_views.exchange(views);
+
+    snapshot_epoch.retire([old_views] { delete old_views; });
+    retire_snapshot_view(view);
+    snapshot_epoch.collect();
+}
+
+snapshot_reader_t inode_smi_t::pin_snapshot_volume(std::string_view version)
+{
+    auto guard = snapshot_epoch.pin();
+    const auto * views = published_snapshot_views.load();
+
+    auto it = views->find(version);
+    if (it == views->end())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_SNAPSHOT);
+    }
+
+    return { std::move(guard), it->second };
+}
+
+uint64_t inode_smi_t::record_change(change_journal_t::operation_t operation,
+                                   inode_id_t inode_id,
+                                   inode_id_t parent_inode_id,
+                                   inode_id_t source_parent_inode_id)
+{
+    return change_journal.record(operation, inode_id, parent_inode_id, source_parent_inode_id);
+}
+
+std::vector < change_journal_t::entry_t > inode_smi_t::read_change_journal(uint64_t cursor,
+                                                                         htmpfs_size_t max_entries)
+{
+    return change_journal.read(cursor, max_entries);
+}
+
+void inode_smi_t::touch_write_recency(inode_id_t inode_id)
+{
+    auto it = write_recency_index.find(inode_id);
+    if (it != write_recency_index.end())
+    {
+        write_recency.splice(write_recency.begin(), write_recency, it->second);
+        return;
+    }
+
+    write_recency.emplace_front(inode_id);
+    write_recency_index.emplace(inode_id, write_recency.begin());
+
+    if (write_recency.size() > write_recency_capacity)
+    {
+        write_recency_index.erase(write_recency.back());
+        write_recency.pop_back();
+    }
+}
+
+void inode_smi_t::forget_write_recency(inode_id_t inode_id)
+{
+    auto it = write_recency_index.find(inode_id);
+    if (it != write_recency_index.end())
+    {
+        write_recency.erase(it->second);
+        write_recency_index.erase(it);
+    }
+
+    std::erase(cow_break_queue, inode_id);
+}
+
+htmpfs_size_t inode_smi_t::break_cow_step(htmpfs_size_t byte_budget)
+{
+    htmpfs_size_t copied = 0;
+
+    while (!cow_break_queue.empty() && copied + block_size <= byte_budget)
+    {
+        auto * pack = inode_pool.find(cow_break_queue.front());
+        if (!pack)
+        {
+            cow_break_queue.pop_front();
+            continue;
+        }
+
+        bool done;
+        copied += pack->inode.break_frozen_blocks(byte_budget - copied, done);
+        if (!done)
+        {
+            break;
+        }
+
+        cow_break_queue.pop_front();
+    }
+
+    return copied;
+}
+
+htmpfs_size_t inode_smi_t::break_cow_with_credit(htmpfs_size_t & byte_credit)
+{
+    if (cow_break_queue.empty())
+    {
+        byte_credit = 0;
+        return 0;
+    }
+
+    if (byte_credit < block_size)
+    {
+        return 0;
+    }
+
+    auto copied = break_cow_step(byte_credit);
+    byte_credit -= copied;
+    if (cow_break_queue.empty())
+    {
+        byte_credit = 0;
+    }
+
+    return copied;
+}
+
+void inode_smi_t::reclaim_blocks(inode_t::block_list_t && blocks)
+{
+    if (blocks.empty())
+    {
+        return;
+    }
+
+    if (!deferred_reclaim)
+    {
+        for (const auto & i : blocks)
+        {
+            unlink_buffer(i.id);
+        }
+
+        return;
+    }
+
+    // the list is moved, not copied, so that dropping a large file is O(1)
+    reclaim_pending_blocks += blocks.size();
+    reclaim_queue.emplace_back(std::move(blocks));
+}
+
+void inode_smi_t::set_deferred_reclaim(bool deferred)
+{
+    deferred_reclaim = deferred;
+    if (!deferred)
+    {
+        reclaim_step(UINT64_MAX);
+    }
+}
+
+htmpfs_size_t inode_smi_t::reclaim_step(htmpfs_size_t block_budget)
+{
+    htmpfs_size_t reclaimed = 0;
+
+    while (!reclaim_queue.empty() && reclaimed < block_budget)
+    {
+        auto & blocks = reclaim_queue.front();
+        while (reclaim_cursor < blocks.size() && reclaimed < block_budget)
+        {
+            unlink_buffer(blocks[reclaim_cursor++].id);
+            reclaimed++;
+        }
+
+        if (reclaim_cursor == blocks.size())
+        {
+            reclaim_queue.pop_front();
+            reclaim_cursor = 0;
+        }
+    }
+
+    reclaim_pending_blocks -= reclaimed;
+    reclaimed_block_count += reclaimed;
+    return reclaimed;
+}
+
+void inode_smi_t::attach_lower_layer(const std::string & host_directory)
+{
+    if (lower_layer)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, "lower layer already attached");
+    }
+
+    // host directory is kept as absolute pathname, daemon may change its working directory
+    char resolved [PATH_MAX];
+    struct stat attributes { };
+    if (!realpath(host_directory.c_str(), resolved) || stat(resolved, &attributes) < 0)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, host_directory + ": " + strerror(errno));
+    }
+
+    if (!S_ISDIR(attributes.st_mode))
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    lower_layer = std::make_unique < lower_layer_t > ();
+    lower_layer->track(FILESYSTEM_ROOT_INODE_NUMBER, resolved, attributes);
+    filesystem_root->lower_pending = true;
+}
+
+void inode_smi_t::populate_lower_directory(inode_t * directory)
+{
+    // a directory failing to list is left pending, nothing is made
+    std::string host_directory = lower_layer->host_path(directory->inode_id);
+    auto host_entries = lower_layer_t::list(host_directory);
+
+    directory->lower_pending = false;
+    lower_layer->forget(directory->inode_id);
+
+    directory_resolver_t directoryResolver(directory, FILESYSTEM_CUR_MODIFIABLE_VER);
+    for (auto & entry : host_entries)
+    {
+        // names htmpfs cannot hold are left out
+        if (entry.name.length() > DENTRY_NAME_MAX || !has_valid_dentry_characters(entry.name)
+            || !directoryResolver.check_availability(entry.name))
+        {
+            continue;
+        }
+
+        const auto & host = entry.attributes;
+        auto new_inode_id = inode_pool.next_id();
+        inode_pool.emplace(
+                inode_pack_t
+                {
+                    .link_count = 1,
+                    .inode = inode_t(new_inode_id, this, S_ISDIR(host.st_mode))
+                }
+        );
+
+        auto & inode = inode_pool.at(new_inode_id).inode;
+        inode.fs_stat.st_mode = host.st_mode;
+        inode.fs_stat.st_nlink = 1;
+        inode.fs_stat.st_size = S_ISDIR(host.st_mode) ? 0 : host.st_size;
+        inode.fs_stat.st_mtim = host.st_mtim;
+        inode.fs_stat.st_uid = host.st_uid;
+        inode.fs_stat.st_gid = host.st_gid;
+        inode.fs_stat.st_atim = host.st_atim;
+        inode.fs_stat.st_ctim = host.st_ctim;
+        inode.fs_stat.st_dev = (S_ISCHR(host.st_mode) || S_ISBLK(host.st_mode)) ? host.st_rdev : 0;
+
+        // device nodes, fifos and sockets hold no data, they are made as they are
+        if (S_ISDIR(host.st_mode) || S_ISREG(host.st_mode) || S_ISLNK(host.st_mode))
+        {
+            inode.lower_pending = true;
+            lower_layer->track(new_inode_id, host_directory + "/" + entry.name, host);
+        }
+
+        directoryResolver.add_path(entry.name, new_inode_id);
+        snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).insert(
+                slot_map_t < inode_pack_t >::slot_index(new_inode_id));
+    }
+
+    directoryResolver.save_current();
+}
+
+void inode_smi_t::copy_up_lower_file(inode_t * inode, htmpfs_size_t length)
+{
+    length = std::min(length, lower_layer->data_size(inode->inode_id));
+    inode->resize_data(length);
+
+    // a failed copy leaves data on host, blocks already made are dropped
+    try
+    {
+        for (htmpfs_size_t i = 0; i < inode->current_blocks.size(); i++)
+        {
+            auto & block = *inode->current_blocks[i].data;
+            data_t tmp(block.size());
+            auto read_length = lower_layer->read(inode->inode_id, tmp.data(), tmp.size(), i * block_size);
+            block.write(tmp.data(), read_length, 0, false);
+        }
+    }
+    catch (...)
+    {
+        inode->resize_data(0);
+        throw;
+    }
+
+    inode->lower_pending = false;
+    lower_layer->forget(inode->inode_id);
+}
+
+void inode_smi_t::materialize_lower_layer()
+{
+    // once host refuses a mapping, i.e., mapping count limit is reached, files left are copied
+    bool can_map = true;
+
+    while (lower_layer && lower_layer->size())
+    {
+        // listing a directory tracks its dentries, they are picked up by the next round
+        for (auto inode_id : lower_layer->tracked())
+        {
+            auto * inode = &inode_pool.at(inode_id).inode;
+            if (inode->__is_dentry())
+            {
+                populate_lower_directory(inode);
+                continue;
+            }
+
+            // symbolic links are small, and are read by readlink() instead of read()
+            if (!can_map || S_ISLNK(inode->fs_stat.st_mode))
+            {
+                copy_up_lower_file(inode);
+                continue;
+            }
+
+            std::string_view bytes;
+            try
+            {
+                bytes = map_host_file(lower_layer->host_path(inode_id));
+            }
+            catch (HTMPFS_error_t & error)
+            {
+                if (error.my_errcode() != HTMPFS_CANNOT_MAP_FILE)
+                {
+                    throw;
+                }
+
+                can_map = false;
+                copy_up_lower_file(inode);
+                continue;
+            }
+
+            // host file may have grown since it was listed, no more than listed size is seen
+            share_mapped_blocks(inode, bytes.data(),
+                                std::min < htmpfs_size_t > (bytes.length(), lower_layer->data_size(inode_id)));
+            inode->lower_pending = false;
+            lower_layer->forget(inode_id);
+        }
+    }
+}
+
+std::string_view inode_smi_t::map_host_file(const std::string & pathname)
+{
+    int fd = open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat attributes { };
+    if (fd < 0 || fstat(fd, &attributes) < 0)
+    {
+        int error = errno;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_CANNOT_MAP_FILE, pathname + ": " + strerror(error));
+    }
+
+    if (attributes.st_size == 0)
+    {
+        close(fd);
+        return { };
+    }
+
+    // mapping outlives descriptor
+    void * address = mmap(nullptr, attributes.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (address == MAP_FAILED)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_CANNOT_MAP_FILE, pathname + ": " + strerror(error));
+    }
+
+    host_mappings.emplace_back(address, attributes.st_size);
+    return { static_cast < const char * > (address), (htmpfs_size_t)attributes.st_size };
+}
+
+void inode_smi_t::share_mapped_data(inode_id_t inode_id, const char * bytes, htmpfs_size_t length)
+{
+    auto * inode = get_inode_by_id(inode_id);
+    if (inode->__is_dentry())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_WRITE_INVOKE);
+    }
+
+    change_journal.record(change_journal_t::JOURNAL_WRITE, inode_id,
+                          change_journal_t::no_parent, change_journal_t::no_parent, 0, length);
+
+    if (inode->lower_pending)
+    {
+        inode->lower_pending = false;
+        lower_layer->forget(inode_id);
+    }
+
+    share_mapped_blocks(inode, bytes, length);
+}
+
+void inode_smi_t::share_mapped_blocks(inode_t * inode, const char * bytes, htmpfs_size_t length)
+{
+    inode->resize_data(0);
+    for (htmpfs_size_t offset = 0; offset < length; offset += block_size)
+    {
+        auto id = buffer_pool.emplace(buffer_pack_t
+                {
+                        .link_count = 1,
+                        .buffer = buffer_t::share(bytes + offset, std::min(block_size, length - offset)),
+                }
+        );
+
+        inode->current_blocks.emplace_back(buffer_result_t {
+                .id = id,
+                .data = &buffer_pool.find(id)->buffer,
+                ._is_snapshoted = 1
+        });
+    }
+}
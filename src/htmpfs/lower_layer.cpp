@@ -0,0 +1,192 @@
+/** @file
+ *
+ * This file implements the read-only host directory a filesystem is lazily populated from
+ */
+
+#include <htmpfs/lower_layer.h>
+#include <htmpfs_error.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+lower_layer_t::~lower_layer_t()
+{
+    for (auto & i : tracked_inodes)
+    {
+        if (i.second.fd >= 0)
+        {
+            close(i.second.fd);
+        }
+    }
+}
+
+lower_layer_t::tracked_inode_t & lower_layer_t::at(inode_id_t inode_id)
+{
+    auto it = tracked_inodes.find(inode_id);
+    if (it == tracked_inodes.end())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
+    }
+
+    return it->second;
+}
+
+void lower_layer_t::track(inode_id_t inode_id, std::string host_path, const struct stat & attributes)
+{
+    auto & tracked = tracked_inodes[inode_id];
+    tracked.host_path = std::move(host_path);
+    tracked.size = S_ISDIR(attributes.st_mode) ? 0 : (htmpfs_size_t)attributes.st_size;
+    tracked.is_symlink = S_ISLNK(attributes.st_mode);
+}
+
+void lower_layer_t::forget(inode_id_t inode_id)
+{
+    auto it = tracked_inodes.find(inode_id);
+    if (it == tracked_inodes.end())
+    {
+        return;
+    }
+
+    // inode stays in open file list, it is skipped once it comes out
+    if (it->second.fd >= 0)
+    {
+        close(it->second.fd);
+    }
+
+    tracked_inodes.erase(it);
+}
+
+std::vector < lower_layer_t::host_entry_t > lower_layer_t::list(const std::string & host_path)
+{
+    DIR * directory = opendir(host_path.c_str());
+    if (!directory)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, host_path + ": " + strerror(errno));
+    }
+
+    std::vector < host_entry_t > ret;
+    struct dirent * dentry;
+    errno = 0;
+    while ((dentry = readdir(directory)))
+    {
+        if (!strcmp(dentry->d_name, ".") || !strcmp(dentry->d_name, ".."))
+        {
+            continue;
+        }
+
+        // a dentry removed on host since listing is left out
+        host_entry_t entry { .name = dentry->d_name, .attributes = { } };
+        if (fstatat(dirfd(directory), dentry->d_name, &entry.attributes, AT_SYMLINK_NOFOLLOW) == 0)
+        {
+            ret.emplace_back(std::move(entry));
+        }
+
+        errno = 0;
+    }
+
+    int error = errno;
+    closedir(directory);
+    if (error)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, host_path + ": " + strerror(error));
+    }
+
+    return ret;
+}
+
+int lower_layer_t::open_file(inode_id_t inode_id, tracked_inode_t & tracked)
+{
+    if (tracked.fd >= 0)
+    {
+        return tracked.fd;
+    }
+
+    tracked.fd = open(tracked.host_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (tracked.fd < 0)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, tracked.host_path + ": " + strerror(errno));
+    }
+
+    open_files.emplace_back(inode_id);
+    while (open_files.size() > open_file_capacity)
+    {
+        auto it = tracked_inodes.find(open_files.front());
+        open_files.pop_front();
+
+        // inode may have been forgotten, or its id reused by an inode opened later
+        if (it != tracked_inodes.end() && it->second.fd >= 0
+            && std::find(open_files.begin(), open_files.end(), it->first) == open_files.end())
+        {
+            close(it->second.fd);
+            it->second.fd = -1;
+        }
+    }
+
+    return tracked.fd;
+}
+
+htmpfs_size_t lower_layer_t::read(inode_id_t inode_id, char * buffer, htmpfs_size_t length, htmpfs_size_t offset)
+{
+    auto & tracked = at(inode_id);
+    if (offset >= tracked.size)
+    {
+        return 0;
+    }
+
+    length = std::min(length, tracked.size - offset);
+
+    if (tracked.is_symlink)
+    {
+        std::string target(tracked.size + 1, 0);
+        auto target_length = readlink(tracked.host_path.c_str(), target.data(), target.length());
+        if (target_length < 0)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, tracked.host_path + ": " + strerror(errno));
+        }
+
+        length = std::min(length, (htmpfs_size_t)std::max(target_length - (ssize_t)offset, (ssize_t)0));
+        memcpy(buffer, target.data() + offset, length);
+        return length;
+    }
+
+    int fd = open_file(inode_id, tracked);
+    htmpfs_size_t done = 0;
+    while (done < length)
+    {
+        auto ret = pread(fd, buffer + done, length - done, (off_t)(offset + done));
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (ret < 0)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_LOWER_LAYER_ERROR, tracked.host_path + ": " + strerror(errno));
+        }
+
+        // host file shrank since it was tracked
+        if (ret == 0)
+        {
+            break;
+        }
+
+        done += ret;
+    }
+
+    return done;
+}
+
+std::vector < inode_id_t > lower_layer_t::tracked() const
+{
+    std::vector < inode_id_t > ret;
+    ret.reserve(tracked_inodes.size());
+    for (const auto & i : tracked_inodes)
+    {
+        ret.emplace_back(i.first);
+    }
+
+    return ret;
+}
@@ -0,0 +1,67 @@
+/** @file
+ *
+ * This file implements the copy-on-write membership set
+ */
+
+#include <htmpfs/membership_set.h>
+
+membership_set_t::chunk_t & membership_set_t::writable_chunk(uint64_t chunk_index)
+{
+    if (chunk_index >= chunks.size())
+    {
+        chunks.resize(chunk_index + 1);
+    }
+
+    auto & chunk = chunks[chunk_index];
+    if (!chunk)
+    {
+        chunk = std::make_shared < chunk_t > ();
+    }
+    else if (chunk.use_count() > 1)
+    {
+        // shared with a copy, clone before modification
+        chunk = std::make_shared < chunk_t > (*chunk);
+    }
+
+    return *chunk;
+}
+
+bool membership_set_t::insert(uint64_t index)
+{
+    if (contains(index))
+    {
+        return false;
+    }
+
+    auto & chunk = writable_chunk(index >> chunk_bits);
+    auto bit = index & (chunk_size - 1);
+    chunk[bit / 64] |= 1ULL << (bit % 64);
+    member_count++;
+    return true;
+}
+
+bool membership_set_t::erase(uint64_t index)
+{
+    if (!contains(index))
+    {
+        return false;
+    }
+
+    auto & chunk = writable_chunk(index >> chunk_bits);
+    auto bit = index & (chunk_size - 1);
+    chunk[bit / 64] &= ~(1ULL << (bit % 64));
+    member_count--;
+    return true;
+}
+
+bool membership_set_t::contains(uint64_t index) const
+{
+    auto chunk_index = index >> chunk_bits;
+    if (chunk_index >= chunks.size() || !chunks[chunk_index])
+    {
+        return false;
+    }
+
+    auto bit = index & (chunk_size - 1);
+    return (*chunks[chunk_index])[bit / 64] & (1ULL << (bit % 64));
+}
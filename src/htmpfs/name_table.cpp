@@ -0,0 +1,65 @@
+/** @file
+ *
+ * This file implements the interned dentry name table
+ */
+
+#include <htmpfs/name_table.h>
+#include <htmpfs_error.h>
+#include <cstring>
+
+name_id_t name_table_t::intern(std::string_view name)
+{
+    auto it = index.find(name);
+    if (it != index.end())
+    {
+        entries[it->second].ref_count++;
+        return it->second;
+    }
+
+    name_id_t name_id;
+    if (!free_ids.empty())
+    {
+        name_id = free_ids.back();
+        free_ids.pop_back();
+    }
+    else
+    {
+        if (entries.size() == no_name)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_BUFFER_ID_DEPLETED);
+        }
+
+        name_id = (name_id_t)entries.size();
+        entries.emplace_back();
+    }
+
+    auto & entry = entries[name_id];
+    entry.name = std::make_unique < char [] > (name.length() + 1);
+    memcpy(entry.name.get(), name.data(), name.length());
+    entry.name[name.length()] = 0;
+    entry.length = (uint32_t)name.length();
+    entry.ref_count = 1;
+
+    index.emplace(std::string_view(entry.name.get(), entry.length), name_id);
+    return name_id;
+}
+
+name_id_t name_table_t::find(std::string_view name) const
+{
+    auto it = index.find(name);
+    return it == index.end() ? no_name : it->second;
+}
+
+void name_table_t::unlink(name_id_t name_id)
+{
+    auto & entry = entries[name_id];
+    if (--entry.ref_count)
+    {
+        return;
+    }
+
+    index.erase(std::string_view(entry.name.get(), entry.length));
+    entry.name.reset();
+    entry.length = 0;
+    free_ids.emplace_back(name_id);
+}
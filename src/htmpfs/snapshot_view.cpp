@@ -0,0 +1,592 @@
+/** @file
+ *
+ * This file implements immutable snapshot views and epoch based reclamation
+ */
+
+#include <htmpfs/snapshot_view.h>
+#include <htmpfs/path_t.h>
+#include <htmpfs_error.h>
+#include <thread>
+#include <algorithm>
+#include <numeric>
+
+#define VERIFY_DATA_OPS_LEN(operation, len) \
+    if ((operation) != len)                 \
+    {                                       \
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_BUFFER_SHORT_OPS); \
+    } __asm__("nop")
+
+/// 64-bit FNV-1a hash of a dentry name
+static uint64_t name_hash64(const char * name, htmpfs_size_t length)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (htmpfs_size_t i = 0; i < length; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+/// re-mix a name hash with a seed (splitmix64 finalizer)
+static uint64_t seeded_hash64(uint64_t hash, uint64_t seed)
+{
+    hash += (seed + 1) * 0x9e3779b97f4a7c15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/// perfect hash bucket of a name
+static uint64_t perfect_hash_bucket(uint64_t hash, uint64_t bucket_count)
+{
+    return seeded_hash64(hash, UINT32_MAX) % bucket_count;
+}
+
+epoch_domain_t::guard_t::~guard_t()
+{
+    if (slot)
+    {
+        slot->epoch.store(0);
+        slot->in_use.store(false);
+    }
+}
+
+epoch_domain_t::guard_t epoch_domain_t::pin()
+{
+    while (true)
+    {
+        for (auto & slot : reader_slots)
+        {
+            bool expected = false;
+            if (!slot.in_use.load(std::memory_order_relaxed)
+                && slot.in_use.compare_exchange_strong(expected, true))
+            {
+                slot.epoch.store(global_epoch.load());
+                return guard_t(&slot);
+            }
+        }
+
+        // all slots are occupied, wait for a reader to leave
+        std::this_thread::yield();
+    }
+}
+
+void epoch_domain_t::retire(std::function < void () > reclaim)
+{
+    std::lock_guard < std::mutex > lock(retired_lock);
+    retired.emplace_back(retired_t {
+            .epoch = global_epoch.fetch_add(1),
+            .reclaim = std::move(reclaim)
+    });
+}
+
+void epoch_domain_t::collect(bool force)
+{
+    std::vector < retired_t > reclaimable;
+
+    {
+        std::lock_guard < std::mutex > lock(retired_lock);
+
+        // oldest epoch still pinned by a reader
+        uint64_t oldest_pinned = UINT64_MAX;
+        if (!force)
+        {
+            for (auto & slot : reader_slots)
+            {
+                uint64_t epoch = slot.epoch.load();
+                if (slot.in_use.load() && epoch != 0 && epoch < oldest_pinned)
+                {
+                    oldest_pinned = epoch;
+                }
+            }
+        }
+
+        for (auto it = retired.begin(); it != retired.end(); )
+        {
+            if (it->epoch < oldest_pinned)
+            {
+                reclaimable.emplace_back(std::move(*it));
+                it = retired.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+    }
+
+    for (auto & i : reclaimable)
+    {
+        i.reclaim();
+    }
+}
+
+htmpfs_size_t epoch_domain_t::pending()
+{
+    std::lock_guard < std::mutex > lock(retired_lock);
+    return retired.size();
+}
+
+void snapshot_view_t::add_inode(inode_id_t inode_id, inode_view_t inode_view)
+{
+    for (htmpfs_size_t i = 0; i < inode_view.dentries.size(); i++)
+    {
+        inode_view.dentry_index.emplace(inode_view.dentries[i].pathname,
+                                        inode_view.dentries[i].inode_id);
+    }
+
+    inodes.emplace(inode_id, std::move(inode_view));
+}
+
+snapshot_view_t * snapshot_view_t::seal(const snapshot_view_t & view)
+{
+    auto * ret = new snapshot_view_t(view.version, view.block_size);
+    auto & layout = ret->sealed;
+    ret->is_sealed_view = true;
+
+    if (view.is_sealed_view)
+    {
+        layout = view.sealed;
+        return ret;
+    }
+
+    // contiguous inode array, sorted by inode id
+    std::vector < inode_id_t > inode_ids;
+    inode_ids.reserve(view.inodes.size());
+    for (const auto & i : view.inodes)
+    {
+        inode_ids.emplace_back(i.first);
+    }
+    std::sort(inode_ids.begin(), inode_ids.end());
+
+    auto index_of = [&](inode_id_t inode_id)->uint32_t
+    {
+        return (uint32_t)(std::lower_bound(inode_ids.begin(), inode_ids.end(), inode_id)
+                          - inode_ids.begin());
+    };
+
+    layout.inodes.reserve(inode_ids.size());
+    for (const auto & inode_id : inode_ids)
+    {
+        auto & inode = view.inodes.at(inode_id);
+        sealed_layout_t::sealed_inode_t sealed_inode
+        {
+            .inode_id       = inode_id,
+            .fs_stat        = inode.fs_stat,
+            .data_size      = inode.data_size,
+            .block_begin    = layout.blocks.size(),
+            .block_count    = inode.blocks.size(),
+            .dentry_begin   = layout.dentries.size(),
+            .dentry_count   = inode.dentries.size(),
+            .bucket_begin   = layout.buckets.size(),
+            .bucket_count   = 0,
+            .slot_begin     = layout.slots.size(),
+            .slot_count     = 0,
+            .is_dentry      = inode.is_dentry,
+        };
+
+        // flattened block list
+        layout.blocks.insert(layout.blocks.end(), inode.blocks.begin(), inode.blocks.end());
+
+        // flattened dentries and name pool
+        std::vector < uint64_t > hashes;
+        for (const auto & dentry : inode.dentries)
+        {
+            layout.dentries.emplace_back(sealed_layout_t::sealed_dentry_t {
+                    .name_offset = layout.names.size(),
+                    .name_length = (uint32_t)dentry.pathname.length(),
+                    .child = index_of(dentry.inode_id)
+            });
+            layout.names.insert(layout.names.end(), dentry.pathname.begin(), dentry.pathname.end());
+            layout.names.emplace_back(0);
+            hashes.emplace_back(name_hash64(dentry.pathname.c_str(), dentry.pathname.length()));
+        }
+
+        // perfect hash table (hash and displace)
+        // every bucket gets a seed, so that all names in the bucket land in distinct free slots
+        if (!hashes.empty())
+        {
+            uint64_t bucket_count = hashes.size() / 4 + 1;
+            uint64_t slot_count = hashes.size() + hashes.size() / 4 + 1;
+
+            while (true)
+            {
+                std::vector < std::vector < uint32_t > > bucket_members(bucket_count);
+                for (uint32_t i = 0; i < hashes.size(); i++)
+                {
+                    bucket_members[perfect_hash_bucket(hashes[i], bucket_count)].emplace_back(i);
+                }
+
+                std::vector < uint32_t > order(bucket_count);
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+                {
+                    return bucket_members[a].size() > bucket_members[b].size();
+                });
+
+                std::vector < uint32_t > seeds(bucket_count, 0);
+                std::vector < uint32_t > slots(slot_count, UINT32_MAX);
+                bool succeed = true;
+
+                for (auto bucket : order)
+                {
+                    auto & members = bucket_members[bucket];
+                    if (members.empty())
+                    {
+                        break;
+                    }
+
+                    bool placed = false;
+                    for (uint32_t seed = 0; seed < 4096 && !placed; seed++)
+                    {
+                        std::vector < uint64_t > taken;
+                        placed = true;
+                        for (auto member : members)
+                        {
+                            uint64_t slot = seeded_hash64(hashes[member], seed) % slot_count;
+                            if (slots[slot] != UINT32_MAX
+                                || std::find(taken.begin(), taken.end(), slot) != taken.end())
+                            {
+                                placed = false;
+                                break;
+                            }
+                            taken.emplace_back(slot);
+                        }
+
+                        if (placed)
+                        {
+                            for (uint64_t i = 0; i < members.size(); i++)
+                            {
+                                slots[taken[i]] = members[i];
+                            }
+                            seeds[bucket] = seed;
+                        }
+                    }
+
+                    if (!placed)
+                    {
+                        succeed = false;
+                        break;
+                    }
+                }
+
+                if (succeed)
+                {
+                    sealed_inode.bucket_count = bucket_count;
+                    sealed_inode.slot_count = slot_count;
+                    layout.buckets.insert(layout.buckets.end(), seeds.begin(), seeds.end());
+                    layout.slots.insert(layout.slots.end(), slots.begin(), slots.end());
+                    break;
+                }
+
+                // retry with a sparser table
+                slot_count += slot_count / 2;
+                bucket_count += bucket_count / 2 + 1;
+            }
+        }
+
+        layout.inodes.emplace_back(sealed_inode);
+    }
+
+    return ret;
+}
+
+const snapshot_view_t::inode_view_t & snapshot_view_t::get_inode(inode_id_t inode_id) const
+{
+    auto it = inodes.find(inode_id);
+    if (it == inodes.end())
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
+    }
+
+    return it->second;
+}
+
+uint64_t snapshot_view_t::sealed_index(inode_id_t inode_id) const
+{
+    auto it = std::lower_bound(sealed.inodes.begin(), sealed.inodes.end(), inode_id,
+                               [](const sealed_layout_t::sealed_inode_t & inode, inode_id_t id)
+                               {
+                                    return inode.inode_id < id;
+                               });
+
+    if (it == sealed.inodes.end() || it->inode_id != inode_id)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
+    }
+
+    return it - sealed.inodes.begin();
+}
+
+uint64_t snapshot_view_t::sealed_namei(uint64_t parent_index, std::string_view name) const
+{
+    auto & parent = sealed.inodes[parent_index];
+    if (!parent.is_dentry)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    if (parent.slot_count != 0)
+    {
+        uint64_t hash = name_hash64(name.data(), name.length());
+        uint32_t seed = sealed.buckets[parent.bucket_begin
+                                       + perfect_hash_bucket(hash, parent.bucket_count)];
+        uint32_t candidate = sealed.slots[parent.slot_begin
+                                          + seeded_hash64(hash, seed) % parent.slot_count];
+
+        if (candidate != UINT32_MAX)
+        {
+            auto & dentry = sealed.dentries[parent.dentry_begin + candidate];
+            if (dentry.name_length == name.length()
+                && !memcmp(&sealed.names[dentry.name_offset], name.data(), name.length()))
+            {
+                return dentry.child;
+            }
+        }
+    }
+
+    return no_index;
+}
+
+struct stat snapshot_view_t::get_stat(inode_id_t inode_id) const
+{
+    struct stat ret { };
+
+    if (is_sealed_view)
+    {
+        auto & inode = sealed.inodes[sealed_index(inode_id)];
+        ret = inode.fs_stat.to_stat();
+        ret.st_size = (off_t)inode.data_size;
+    }
+    else
+    {
+        auto & inode = get_inode(inode_id);
+        ret = inode.fs_stat.to_stat();
+        ret.st_size = (off_t)inode.data_size;
+    }
+
+    ret.st_ino = inode_id;
+    return ret;
+}
+
+htmpfs_size_t snapshot_view_t::data_size(inode_id_t inode_id) const
+{
+    if (is_sealed_view)
+    {
+        return sealed.inodes[sealed_index(inode_id)].data_size;
+    }
+
+    return get_inode(inode_id).data_size;
+}
+
+bool snapshot_view_t::is_dentry(inode_id_t inode_id) const
+{
+    if (is_sealed_view)
+    {
+        return sealed.inodes[sealed_index(inode_id)].is_dentry;
+    }
+
+    return get_inode(inode_id).is_dentry;
+}
+
+bool snapshot_view_t::lookup(inode_id_t parent_inode_id, std::string_view name, inode_id_t & inode_id) const
+{
+    auto & parent = get_inode(parent_inode_id);
+    if (!parent.is_dentry)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    auto it = parent.dentry_index.find(name);
+    if (it == parent.dentry_index.end())
+    {
+        return false;
+    }
+
+    inode_id = it->second;
+    return true;
+}
+
+inode_id_t snapshot_view_t::namei(inode_id_t parent_inode_id, std::string_view name) const
+{
+    inode_id_t inode_id = 0;
+
+    if (is_sealed_view)
+    {
+        auto index = sealed_namei(sealed_index(parent_inode_id), name);
+        if (index != no_index)
+        {
+            return sealed.inodes[index].inode_id;
+        }
+    }
+    else if (lookup(parent_inode_id, name, inode_id))
+    {
+        return inode_id;
+    }
+
+    THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
+}
+
+bool snapshot_view_t::try_get_inode_id_by_path(std::string_view pathname, inode_id_t & inode_id) const
+{
+    path_view_t vec_path(pathname);
+
+    // sealed view walks child indexes, no inode id translation in between
+    if (is_sealed_view)
+    {
+        uint64_t current_index = sealed_index(FILESYSTEM_ROOT_INODE_NUMBER);
+        for (const auto & i : vec_path)
+        {
+            current_index = sealed_namei(current_index, i);
+            if (current_index == no_index)
+            {
+                return false;
+            }
+        }
+
+        inode_id = sealed.inodes[current_index].inode_id;
+        return true;
+    }
+
+    inode_id_t current_inode = FILESYSTEM_ROOT_INODE_NUMBER;
+    for (const auto & i : vec_path)
+    {
+        if (!lookup(current_inode, i, current_inode))
+        {
+            return false;
+        }
+    }
+
+    inode_id = current_inode;
+    return true;
+}
+
+inode_id_t snapshot_view_t::get_inode_id_by_path(std::string_view pathname) const
+{
+    inode_id_t inode_id = 0;
+    if (!try_get_inode_id_by_path(pathname, inode_id))
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
+    }
+
+    return inode_id;
+}
+
+void snapshot_view_t::readdir(inode_id_t inode_id,
+                              const std::function < void (const char *, inode_id_t) > & func) const
+{
+    readdir(inode_id, 0, [&](const char * name, inode_id_t child, uint64_t)
+    {
+        func(name, child);
+        return true;
+    });
+}
+
+void snapshot_view_t::readdir(inode_id_t inode_id, uint64_t after_cookie,
+                              const std::function < bool (const char *, inode_id_t, uint64_t) > & func) const
+{
+    // cookie of a dentry is its position in directory plus one, views never change
+    if (is_sealed_view)
+    {
+        auto & inode = sealed.inodes[sealed_index(inode_id)];
+        if (!inode.is_dentry)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+        }
+
+        for (uint64_t i = after_cookie; i < inode.dentry_count; i++)
+        {
+            auto & dentry = sealed.dentries[inode.dentry_begin + i];
+            if (!func(&sealed.names[dentry.name_offset], sealed.inodes[dentry.child].inode_id, i + 1))
+            {
+                return;
+            }
+        }
+
+        return;
+    }
+
+    auto & inode = get_inode(inode_id);
+    if (!inode.is_dentry)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    for (uint64_t i = after_cookie; i < inode.dentries.size(); i++)
+    {
+        if (!func(inode.dentries[i].pathname.c_str(), inode.dentries[i].inode_id, i + 1))
+        {
+            return;
+        }
+    }
+}
+
+htmpfs_size_t snapshot_view_t::read(inode_id_t inode_id,
+                                    char * buffer,
+                                    htmpfs_size_t length,
+                                    htmpfs_size_t offset) const
+{
+    const buffer_result_t * blocks;
+    htmpfs_size_t size;
+
+    if (is_sealed_view)
+    {
+        auto & inode = sealed.inodes[sealed_index(inode_id)];
+        blocks = sealed.blocks.data() + inode.block_begin;
+        size = inode.data_size;
+    }
+    else
+    {
+        auto & inode = get_inode(inode_id);
+        blocks = inode.blocks.data();
+        size = inode.data_size;
+    }
+
+    if (!length || offset >= size)
+    {
+        return 0;
+    }
+
+    htmpfs_size_t read_size = std::min(length, size - offset);
+    htmpfs_size_t done = 0;
+
+    while (done < read_size)
+    {
+        htmpfs_size_t cur_offset = offset + done;
+        htmpfs_size_t offset_in_block = cur_offset % block_size;
+        htmpfs_size_t read_in_block = std::min(block_size - offset_in_block, read_size - done);
+
+        VERIFY_DATA_OPS_LEN(blocks[cur_offset / block_size].data->read(
+                buffer + done,
+                read_in_block,
+                offset_in_block
+        ), read_in_block);
+
+        done += read_in_block;
+    }
+
+    return read_size;
+}
+
+void snapshot_view_t::for_each_block(const std::function < void (const buffer_result_t &) > & func) const
+{
+    if (is_sealed_view)
+    {
+        for (const auto & i : sealed.blocks)
+        {
+            func(i);
+        }
+
+        return;
+    }
+
+    for (const auto & i : inodes)
+    {
+        for (const auto & block : i.second.blocks)
+        {
+            func(block);
+        }
+    }
+}
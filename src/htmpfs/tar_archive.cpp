@@ -0,0 +1,950 @@
+/** @file
+ *
+ * This file implements tar archive import into and export from a filesystem
+ */
+
+#include <htmpfs/tar_archive.h>
+#include <htmpfs/directory_resolver.h>
+#include <htmpfs/tree_walker.h>
+#include <htmpfs_error.h>
+#include <uni_utils.h>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+
+/// tar block size
+#define TAR_BLOCK_SIZE 512
+
+/// largest value of a 12-byte octal field
+#define TAR_OCTAL_SIZE_MAX 077777777777ULL
+
+/// ustar header block
+struct tar_header_t
+{
+    char name       [100];
+    char mode       [8];
+    char uid        [8];
+    char gid        [8];
+    char size       [12];
+    char mtime      [12];
+    char checksum   [8];
+    char typeflag;
+    char linkname   [100];
+    char magic      [6];
+    char version    [2];
+    char uname      [32];
+    char gname      [32];
+    char devmajor   [8];
+    char devminor   [8];
+    char prefix     [155];
+    char padding    [12];
+};
+
+static_assert(sizeof(tar_header_t) == TAR_BLOCK_SIZE);
+
+/// header checksum, checksum field counted as spaces
+static uint64_t header_checksum(const tar_header_t & header)
+{
+    auto * bytes = reinterpret_cast < const unsigned char * > (&header);
+    uint64_t sum = 0;
+    for (htmpfs_size_t i = 0; i < TAR_BLOCK_SIZE; i++)
+    {
+        bool in_checksum = i >= offsetof(tar_header_t, checksum)
+                           && i < offsetof(tar_header_t, checksum) + sizeof(header.checksum);
+        sum += in_checksum ? ' ' : bytes[i];
+    }
+
+    return sum;
+}
+
+/// parse a numeric field, octal or GNU base-256
+static uint64_t parse_number(const char * field, htmpfs_size_t length)
+{
+    uint64_t value = 0;
+
+    // base-256, used for values that do not fit in octal
+    if (field[0] & 0x80)
+    {
+        value = field[0] & 0x3F;
+        for (htmpfs_size_t i = 1; i < length; i++)
+        {
+            value = (value << 8) | (unsigned char)field[i];
+        }
+
+        return value;
+    }
+
+    htmpfs_size_t i = 0;
+    while (i < length && field[i] == ' ')
+    {
+        i++;
+    }
+
+    for (; i < length && field[i] >= '0' && field[i] <= '7'; i++)
+    {
+        value = (value << 3) | (field[i] - '0');
+    }
+
+    return value;
+}
+
+/// string of a null-padded field
+static std::string field_string(const char * field, htmpfs_size_t length)
+{
+    return { field, strnlen(field, length) };
+}
+
+/// padding after data of size bytes
+static htmpfs_size_t padding_of(htmpfs_size_t size)
+{
+    return (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
+
+/// read exactly length bytes, a short read is a truncated archive
+static void read_exact(std::istream & input, char * buffer, htmpfs_size_t length)
+{
+    input.read(buffer, (std::streamsize)length);
+    if ((htmpfs_size_t)input.gcount() != length)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_MALFORMED_ARCHIVE);
+    }
+}
+
+/// skip data of an entry with its padding
+static void skip_data(std::istream & input, htmpfs_size_t size)
+{
+    htmpfs_size_t length = size + padding_of(size);
+    input.ignore((std::streamsize)length);
+    if ((htmpfs_size_t)input.gcount() != length)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_MALFORMED_ARCHIVE);
+    }
+}
+
+/// read data of an entry, padding is skipped
+static std::string read_data(std::istream & input, htmpfs_size_t size)
+{
+    std::string data(size, 0);
+    read_exact(input, data.data(), size);
+    input.ignore((std::streamsize)padding_of(size));
+    return data;
+}
+
+/// header fields overridden by pax extended headers and GNU long names
+struct tar_override_t
+{
+    std::string path;
+    std::string linkpath;
+    bool has_path = false;
+    bool has_linkpath = false;
+    bool has_size = false;
+    bool has_mtime = false;
+    bool has_uid = false;
+    bool has_gid = false;
+    uint64_t size = 0;
+    uint64_t mtime = 0;
+    uint64_t uid = 0;
+    uint64_t gid = 0;
+};
+
+/// parse pax records, "<length> <key>=<value>\n"
+static void parse_pax_records(const std::string & records, tar_override_t & override)
+{
+    htmpfs_size_t offset = 0;
+    while (offset < records.length())
+    {
+        auto space = records.find(' ', offset);
+        if (space == std::string::npos)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_MALFORMED_ARCHIVE);
+        }
+
+        htmpfs_size_t length = strtoull(records.c_str() + offset, nullptr, 10);
+        auto equal = records.find('=', space);
+        if (length == 0 || offset + length > records.length() || equal == std::string::npos
+            || equal >= offset + length)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_MALFORMED_ARCHIVE);
+        }
+
+        std::string key = records.substr(space + 1, equal - space - 1);
+        std::string value = records.substr(equal + 1, offset + length - equal - 2);
+
+        if (key == "path")
+        {
+            override.path = value;
+            override.has_path = true;
+        }
+        else if (key == "linkpath")
+        {
+            override.linkpath = value;
+            override.has_linkpath = true;
+        }
+        else if (key == "size")
+        {
+            override.size = strtoull(value.c_str(), nullptr, 10);
+            override.has_size = true;
+        }
+        else if (key == "mtime")
+        {
+            // fractional seconds are dropped
+            override.mtime = strtoull(value.c_str(), nullptr, 10);
+            override.has_mtime = true;
+        }
+        else if (key == "uid")
+        {
+            override.uid = strtoull(value.c_str(), nullptr, 10);
+            override.has_uid = true;
+        }
+        else if (key == "gid")
+        {
+            override.gid = strtoull(value.c_str(), nullptr, 10);
+            override.has_gid = true;
+        }
+
+        offset += length;
+    }
+}
+
+/*
+ * Tar Importer
+ *
+ * importer queues dentries of an archive into a namespace batch. directories are tracked by their path
+ * relative to the target directory, as an inode id once made, or as the index of their mkdir
+ * in the pending batch. the batch is applied once it holds enough operations or file data,
+ * or when an entry depends on a dentry of the batch being made first.
+ *
+ * importing a mapped base image, file data is left in place: blocks of a file read it from the mapping.
+ *
+ * */
+
+class tar_importer_t
+{
+private:
+    /// operations kept by a batch before it is applied
+    static constexpr htmpfs_size_t max_batch_operations = 4096;
+
+    /// file data kept by a batch before it is applied
+    static constexpr htmpfs_size_t max_batch_data = 64 * 1024 * 1024;
+
+    /// larger files are written block by block as they are read, without being held by a batch
+    static constexpr htmpfs_size_t max_held_file = 1024 * 1024;
+
+    /// a directory, made or pending in batch
+    struct directory_ref_t
+    {
+        bool in_batch;
+        uint64_t value;     /* inode id, or operation index in batch */
+    };
+
+    inode_smi_t & filesystem;
+
+    /// directories by path relative to target directory, target directory is ""
+    std::unordered_map < std::string, directory_ref_t > directories;
+
+    std::vector < namespace_op_t > batch;
+
+    /// paths of directories made by batch
+    std::vector < std::string > batch_directories;
+
+    /// paths of regular files and symbolic links made by batch -> operation index
+    std::unordered_map < std::string, htmpfs_size_t > batch_entries;
+
+    /// (operation index, data) of regular files made by batch
+    std::vector < std::pair < htmpfs_size_t, std::string > > batch_data;
+    htmpfs_size_t batch_data_size = 0;
+
+    /// mapped archive being imported, nullptr if archive is read from a stream
+    const char * mapped_archive;
+
+    /// (operation index, data in mapped archive) of regular files made by batch
+    std::vector < std::pair < htmpfs_size_t, std::string_view > > batch_shared;
+
+    /// held while filesystem is accessed, nullptr if filesystem is not shared
+    std::mutex * filesystem_lock;
+
+    /// unlock filesystem before input is read
+    static void unlock_filesystem(std::unique_lock < std::mutex > & guard)
+    {
+        if (guard.owns_lock())
+        {
+            guard.unlock();
+        }
+    }
+
+    /// lock filesystem again after input is read
+    static void relock_filesystem(std::unique_lock < std::mutex > & guard)
+    {
+        if (guard.mutex() && !guard.owns_lock())
+        {
+            guard.lock();
+        }
+    }
+
+    /// look up name in a directory of version 0
+    bool lookup(inode_id_t parent_inode_id, const std::string & name, inode_id_t & inode_id)
+    {
+        directory_resolver_t resolver(filesystem.get_inode_by_id(parent_inode_id), FILESYSTEM_CUR_MODIFIABLE_VER);
+        return resolver.lookup(name, inode_id);
+    }
+
+    /// make a batch operation under a directory
+    htmpfs_size_t queue(namespace_op_t::operation_t operation, const directory_ref_t & parent,
+                        const std::string & name, const inode_stat_t & attributes,
+                        const std::string & symlink_target = "")
+    {
+        namespace_op_t op {
+                .operation = operation,
+                .name = name,
+                .symlink_target = symlink_target,
+                .attributes = attributes
+        };
+
+        if (parent.in_batch)
+        {
+            op.parent_index = parent.value;
+        }
+        else
+        {
+            op.parent_inode_id = parent.value;
+        }
+
+        batch.emplace_back(std::move(op));
+        return batch.size() - 1;
+    }
+
+    /// get a directory, missing directories are made with default attributes
+    directory_ref_t directory(const std::string & path)
+    {
+        auto it = directories.find(path);
+        if (it != directories.end())
+        {
+            return it->second;
+        }
+
+        auto separator = path.rfind('/');
+        std::string parent_path = separator == std::string::npos ? "" : path.substr(0, separator);
+        std::string name = separator == std::string::npos ? path : path.substr(separator + 1);
+        auto parent = directory(parent_path);
+
+        if (!parent.in_batch)
+        {
+            inode_id_t inode_id;
+            if (lookup(parent.value, name, inode_id))
+            {
+                if (!filesystem.get_inode_by_id(inode_id)->__is_dentry())
+                {
+                    THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+                }
+
+                return directories[path] = directory_ref_t { .in_batch = false, .value = inode_id };
+            }
+        }
+
+        if (batch_entries.contains(path))
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+        }
+
+        inode_stat_t attributes;
+        attributes.st_mode = 0755;
+        attributes.st_uid = getuid();
+        attributes.st_gid = getgid();
+        attributes.st_atim = attributes.st_mtim = attributes.st_ctim = get_current_time();
+
+        batch_directories.emplace_back(path);
+        return directories[path] = directory_ref_t {
+            .in_batch = true,
+            .value = queue(namespace_op_t::NAMESPACE_MKDIR, parent, name, attributes)
+        };
+    }
+
+public:
+    tar_statistics_t statistics;
+
+    /// lock filesystem, if it is shared
+    std::unique_lock < std::mutex > lock_filesystem()
+    {
+        return filesystem_lock ? std::unique_lock < std::mutex > (*filesystem_lock) : std::unique_lock < std::mutex > ();
+    }
+
+    tar_importer_t(inode_smi_t & _filesystem, inode_id_t target_inode_id, const char * _mapped_archive,
+                   std::mutex * _filesystem_lock)
+    : filesystem(_filesystem), mapped_archive(_mapped_archive), filesystem_lock(_filesystem_lock)
+    {
+        directories.emplace("", directory_ref_t { .in_batch = false, .value = target_inode_id });
+    }
+
+    /// apply pending batch, then write data held by it, filesystem must be locked by caller
+    /// @return inode id made or changed by every operation of batch
+    std::vector < inode_id_t > flush()
+    {
+        if (batch.empty())
+        {
+            return { };
+        }
+
+        auto result = filesystem.apply_namespace_batch(batch);
+
+        for (const auto & i : batch_directories)
+        {
+            auto & ref = directories.at(i);
+            ref = directory_ref_t { .in_batch = false, .value = result[ref.value] };
+        }
+
+        for (const auto & i : batch_data)
+        {
+            filesystem.get_inode_by_id(result[i.first])->write(i.second.c_str(), i.second.length(), 0);
+        }
+
+        for (const auto & i : batch_shared)
+        {
+            filesystem.share_mapped_data(result[i.first], i.second.data(), i.second.length());
+        }
+
+        batch.clear();
+        batch_directories.clear();
+        batch_entries.clear();
+        batch_data.clear();
+        batch_data_size = 0;
+        batch_shared.clear();
+        return result;
+    }
+
+    /// import one entry, its data is read from input while filesystem is unlocked
+    void add(char typeflag, const std::string & pathname, const std::string & linkname,
+             const inode_stat_t & attributes, htmpfs_size_t size, std::istream & input)
+    {
+        // normalize pathname relative to target directory
+        std::vector < std::string > components;
+        bool escaping = false;
+        for (auto i : path_view_t(pathname))
+        {
+            if (i.empty() || i == ".")
+            {
+                continue;
+            }
+
+            escaping |= i == "..";
+            components.emplace_back(i);
+        }
+
+        bool is_dir = typeflag == '5';
+        bool is_symlink = typeflag == '2';
+        bool is_file = typeflag == '0' || typeflag == '\0' || typeflag == '7';
+        bool is_special = typeflag == '3' || typeflag == '4' || typeflag == '6';
+
+        // target directory itself keeps its attributes
+        if (components.empty())
+        {
+            skip_data(input, size);
+            return;
+        }
+
+        if (escaping || !(is_dir || is_symlink || is_file || is_special))
+        {
+            statistics.skipped++;
+            skip_data(input, size);
+            return;
+        }
+
+        std::string parent_path, path;
+        for (htmpfs_size_t i = 0; i < components.size(); i++)
+        {
+            if (i + 1 < components.size())
+            {
+                parent_path += (i ? "/" : "") + components[i];
+            }
+        }
+
+        const auto & name = components.back();
+        path = parent_path.empty() ? name : parent_path + "/" + name;
+
+        // data is read before filesystem is locked, input can be a pipe fed slowly
+        std::string data;
+        std::string_view shared_data;
+        bool is_large_file = false;
+        if (is_file && mapped_archive)
+        {
+            // stream position is offset in mapped archive
+            auto offset = (htmpfs_size_t)input.tellg();
+            skip_data(input, size);
+            shared_data = std::string_view(mapped_archive + offset, size);
+        }
+        else if (is_file && size > max_held_file)
+        {
+            // written block by block as it is read
+            is_large_file = true;
+        }
+        else if (is_file)
+        {
+            data = read_data(input, size);
+        }
+        else
+        {
+            skip_data(input, size);
+        }
+
+        auto guard = lock_filesystem();
+
+        // a regular file or symbolic link listed twice in one batch is replaced after the batch is made
+        if (batch_entries.contains(path))
+        {
+            flush();
+        }
+
+        auto parent = directory(parent_path);
+        auto existing = directories.find(path);
+        inode_id_t existing_id = 0;
+        bool exists = existing != directories.end()
+                      || (!parent.in_batch && lookup(parent.value, name, existing_id));
+
+        if (is_dir)
+        {
+            statistics.directories++;
+
+            if (exists && existing != directories.end())
+            {
+                queue(namespace_op_t::NAMESPACE_SETATTR, parent, name, attributes);
+                return;
+            }
+
+            if (exists && filesystem.get_inode_by_id(existing_id)->__is_dentry())
+            {
+                directories[path] = directory_ref_t { .in_batch = false, .value = existing_id };
+                queue(namespace_op_t::NAMESPACE_SETATTR, parent, name, attributes);
+                return;
+            }
+
+            // a regular file or symbolic link is replaced by the directory
+            if (exists)
+            {
+                filesystem.remove_child_dentry_under_parent(parent.value, name);
+            }
+
+            batch_directories.emplace_back(path);
+            directories[path] = directory_ref_t {
+                .in_batch = true,
+                .value = queue(namespace_op_t::NAMESPACE_MKDIR, parent, name, attributes)
+            };
+            return;
+        }
+
+        if (exists)
+        {
+            if (existing != directories.end() || filesystem.get_inode_by_id(existing_id)->__is_dentry())
+            {
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_IS_A_DIRECTORY);
+            }
+
+            filesystem.remove_child_dentry_under_parent(parent.value, name);
+        }
+
+        if (is_symlink)
+        {
+            statistics.symlinks++;
+            batch_entries[path] = queue(namespace_op_t::NAMESPACE_SYMLINK, parent, name, attributes, linkname);
+        }
+        else if (is_special)
+        {
+            statistics.specials++;
+
+            auto special_attributes = attributes;
+            special_attributes.st_mode |= typeflag == '3' ? S_IFCHR : (typeflag == '4' ? S_IFBLK : S_IFIFO);
+            batch_entries[path] = queue(namespace_op_t::NAMESPACE_MKNOD, parent, name, special_attributes);
+        }
+        else
+        {
+            statistics.files++;
+            statistics.bytes += size;
+            auto index = queue(namespace_op_t::NAMESPACE_CREATE, parent, name, attributes);
+            batch_entries[path] = index;
+
+            if (mapped_archive)
+            {
+                batch_shared.emplace_back(index, shared_data);
+            }
+            else if (!is_large_file)
+            {
+                batch_data.emplace_back(index, std::move(data));
+                batch_data_size += size;
+            }
+            else
+            {
+                // large file, make it now and write its data as it is read.
+                // inode is looked up again after every unlocked read, a stale id is not reused
+                auto inode_id = flush()[index];
+                const htmpfs_size_t chunk_size = std::max < htmpfs_size_t > (
+                        filesystem.get_block_size(), max_held_file / filesystem.get_block_size() * filesystem.get_block_size());
+                std::vector < char > chunk(chunk_size);
+
+                for (htmpfs_size_t offset = 0; offset < size; offset += chunk_size)
+                {
+                    htmpfs_size_t length = std::min(chunk_size, size - offset);
+                    unlock_filesystem(guard);
+                    read_exact(input, chunk.data(), length);
+                    relock_filesystem(guard);
+                    filesystem.get_inode_by_id(inode_id)->write(chunk.data(), length, offset);
+                }
+
+                unlock_filesystem(guard);
+                input.ignore((std::streamsize)padding_of(size));
+                return;
+            }
+        }
+
+        if (batch.size() >= max_batch_operations || batch_data_size >= max_batch_data)
+        {
+            flush();
+        }
+    }
+};
+
+/// read-only stream buffer over a mapped archive, stream positions are offsets in it
+class mapped_streambuf_t : public std::streambuf
+{
+public:
+    explicit mapped_streambuf_t(std::string_view bytes)
+    {
+        auto * begin = const_cast < char * > (bytes.data());
+        setg(begin, begin, begin + bytes.length());
+    }
+
+protected:
+    /// only current position is reported, for tellg()
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode) override
+    {
+        if (offset != 0 || direction != std::ios_base::cur)
+        {
+            return { off_type(-1) };
+        }
+
+        return { off_type(gptr() - eback()) };
+    }
+};
+
+/// import an archive read from input
+/// @param mapped_archive archive input reads from if it is mapped, data of files is shared with it
+/// @param filesystem_lock held while filesystem is accessed, nullptr if filesystem is not shared
+static tar_statistics_t import_archive(inode_smi_t & filesystem, std::istream & input,
+                                       inode_id_t target_inode_id, const char * mapped_archive,
+                                       std::mutex * filesystem_lock)
+{
+    tar_importer_t importer(filesystem, target_inode_id, mapped_archive, filesystem_lock);
+    {
+        auto guard = importer.lock_filesystem();
+        if (!filesystem.get_inode_by_id(target_inode_id)->__is_dentry())
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+        }
+    }
+
+    tar_override_t override;
+    tar_header_t header { };
+
+    while (true)
+    {
+        // end of stream without end-of-archive marker is accepted, as tar does
+        input.read(reinterpret_cast < char * > (&header), TAR_BLOCK_SIZE);
+        if (input.gcount() == 0)
+        {
+            break;
+        }
+
+        if (input.gcount() != TAR_BLOCK_SIZE)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_MALFORMED_ARCHIVE);
+        }
+
+        // end-of-archive marker, the second zero block is not required
+        auto * bytes = reinterpret_cast < const char * > (&header);
+        if (std::all_of(bytes, bytes + TAR_BLOCK_SIZE, [](char i) { return i == 0; }))
+        {
+            break;
+        }
+
+        if (parse_number(header.checksum, sizeof(header.checksum)) != header_checksum(header))
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_MALFORMED_ARCHIVE);
+        }
+
+        htmpfs_size_t size = override.has_size ? override.size : parse_number(header.size, sizeof(header.size));
+
+        switch (header.typeflag)
+        {
+            case 'x': // pax extended header of next entry
+                parse_pax_records(read_data(input, size), override);
+                continue;
+
+            case 'g': // pax global header
+                skip_data(input, size);
+                continue;
+
+            case 'L': // GNU long name of next entry
+            {
+                auto name = read_data(input, size);
+                override.path = std::string(name.c_str());
+                override.has_path = true;
+                continue;
+            }
+
+            case 'K': // GNU long link name of next entry
+            {
+                auto name = read_data(input, size);
+                override.linkpath = std::string(name.c_str());
+                override.has_linkpath = true;
+                continue;
+            }
+
+            default:
+                break;
+        }
+
+        std::string pathname = field_string(header.name, sizeof(header.name));
+        if (!memcmp(header.magic, "ustar", 5) && header.prefix[0])
+        {
+            pathname = field_string(header.prefix, sizeof(header.prefix)) + "/" + pathname;
+        }
+
+        inode_stat_t attributes;
+        attributes.st_mode = parse_number(header.mode, sizeof(header.mode)) & 07777;
+        attributes.st_uid = override.has_uid ? override.uid : parse_number(header.uid, sizeof(header.uid));
+        attributes.st_gid = override.has_gid ? override.gid : parse_number(header.gid, sizeof(header.gid));
+        attributes.st_mtim.tv_sec = (time_t)(override.has_mtime ? override.mtime
+                                                                : parse_number(header.mtime, sizeof(header.mtime)));
+        attributes.st_atim = attributes.st_ctim = attributes.st_mtim;
+        if (header.typeflag == '3' || header.typeflag == '4')
+        {
+            attributes.st_dev = makedev(parse_number(header.devmajor, sizeof(header.devmajor)),
+                                        parse_number(header.devminor, sizeof(header.devminor)));
+        }
+
+        importer.add(header.typeflag,
+                     override.has_path ? override.path : pathname,
+                     override.has_linkpath ? override.linkpath : field_string(header.linkname, sizeof(header.linkname)),
+                     attributes, size, input);
+
+        override = tar_override_t { };
+    }
+
+    auto guard = importer.lock_filesystem();
+    importer.flush();
+    return importer.statistics;
+}
+
+tar_statistics_t tar_import(inode_smi_t & filesystem, std::istream & input, inode_id_t target_inode_id,
+                            std::mutex * filesystem_lock)
+{
+    return import_archive(filesystem, input, target_inode_id, nullptr, filesystem_lock);
+}
+
+tar_statistics_t tar_load_image(inode_smi_t & filesystem, const std::string & image, inode_id_t target_inode_id)
+{
+    auto bytes = filesystem.map_host_file(image);
+    mapped_streambuf_t buffer(bytes);
+    std::istream input(&buffer);
+    return import_archive(filesystem, input, target_inode_id, bytes.data(), nullptr);
+}
+
+/*
+ * Tar Writer
+ *
+ * writer emits ustar headers, preceded by a pax extended header when a name, a link name
+ * or a size does not fit in ustar fields.
+ *
+ * */
+
+class tar_writer_t
+{
+private:
+    std::ostream & output;
+
+    /// write a numeric field in octal, null-terminated
+    static void put_octal(char * field, htmpfs_size_t length, uint64_t value)
+    {
+        snprintf(field, length, "%0*llo", (int)(length - 1), (unsigned long long)value);
+    }
+
+    /// one pax record, length prefix counts itself
+    static std::string pax_record(const std::string & key, const std::string & value)
+    {
+        htmpfs_size_t length = key.length() + value.length() + 3; /* ' ', '=', '\n' */
+        htmpfs_size_t total = length + std::to_string(length).length();
+        if (std::to_string(total).length() != std::to_string(length).length())
+        {
+            total++;
+        }
+
+        return std::to_string(total) + " " + key + "=" + value + "\n";
+    }
+
+    void write_header(const std::string & pathname, const struct stat & stat, char typeflag,
+                      const std::string & linkname, htmpfs_size_t size)
+    {
+        tar_header_t header { };
+        memcpy(header.name, pathname.c_str(), std::min(pathname.length(), sizeof(header.name)));
+        memcpy(header.linkname, linkname.c_str(), std::min(linkname.length(), sizeof(header.linkname)));
+        put_octal(header.mode, sizeof(header.mode), stat.st_mode & 07777);
+        put_octal(header.uid, sizeof(header.uid), stat.st_uid);
+        put_octal(header.gid, sizeof(header.gid), stat.st_gid);
+        put_octal(header.size, sizeof(header.size), size <= TAR_OCTAL_SIZE_MAX ? size : 0);
+        put_octal(header.mtime, sizeof(header.mtime), stat.st_mtim.tv_sec > 0 ? stat.st_mtim.tv_sec : 0);
+        header.typeflag = typeflag;
+        if (typeflag == '3' || typeflag == '4')
+        {
+            // device number is kept in st_dev, as mknod() saves it
+            put_octal(header.devmajor, sizeof(header.devmajor), major(stat.st_dev));
+            put_octal(header.devminor, sizeof(header.devminor), minor(stat.st_dev));
+        }
+
+        memcpy(header.magic, "ustar", 6);
+        memcpy(header.version, "00", 2);
+        put_octal(header.checksum, sizeof(header.checksum) - 1, header_checksum(header));
+        header.checksum[sizeof(header.checksum) - 1] = ' ';
+
+        output.write(reinterpret_cast < const char * > (&header), TAR_BLOCK_SIZE);
+    }
+
+    void write_padding(htmpfs_size_t size)
+    {
+        static const char zero [TAR_BLOCK_SIZE] { };
+        output.write(zero, (std::streamsize)padding_of(size));
+    }
+
+public:
+    explicit tar_writer_t(std::ostream & _output) : output(_output) { }
+
+    /// write header of an entry, data of size bytes is expected to follow
+    void write_entry(const std::string & pathname, const struct stat & stat, char typeflag,
+                     const std::string & linkname = "", htmpfs_size_t size = 0)
+    {
+        std::string records;
+        if (pathname.length() > sizeof(tar_header_t::name))
+        {
+            records += pax_record("path", pathname);
+        }
+
+        if (linkname.length() > sizeof(tar_header_t::linkname))
+        {
+            records += pax_record("linkpath", linkname);
+        }
+
+        if (size > TAR_OCTAL_SIZE_MAX)
+        {
+            records += pax_record("size", std::to_string(size));
+        }
+
+        if (!records.empty())
+        {
+            write_header("PaxHeader/" + pathname.substr(0, 80), stat, 'x', "", records.length());
+            output.write(records.c_str(), (std::streamsize)records.length());
+            write_padding(records.length());
+        }
+
+        write_header(pathname, stat, typeflag, linkname, size);
+    }
+
+    /// write data of current entry
+    void write_data(const char * buffer, htmpfs_size_t length)
+    {
+        output.write(buffer, (std::streamsize)length);
+    }
+
+    /// end data of current entry
+    void end_data(htmpfs_size_t size)
+    {
+        write_padding(size);
+    }
+
+    /// write end-of-archive marker
+    void finish()
+    {
+        static const char zero [TAR_BLOCK_SIZE * 2] { };
+        output.write(zero, sizeof(zero));
+    }
+};
+
+tar_statistics_t tar_export(inode_smi_t & filesystem, const snapshot_ver_t & version, std::ostream & output)
+{
+    // version 0 is read from inodes, snapshot volumes from their pinned view
+    std::function < htmpfs_size_t (inode_id_t, char *, htmpfs_size_t, htmpfs_size_t) > read;
+    std::unique_ptr < snapshot_reader_t > view;
+    std::unique_ptr < tree_cursor_t > cursor;
+
+    if (version == FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        cursor = std::make_unique < tree_cursor_t > (filesystem, version);
+        read = [&](inode_id_t inode_id, char * buffer, htmpfs_size_t length, htmpfs_size_t offset)
+        {
+            return filesystem.get_inode_by_id(inode_id)->read(FILESYSTEM_CUR_MODIFIABLE_VER, buffer, length, offset);
+        };
+    }
+    else
+    {
+        view = std::make_unique < snapshot_reader_t > (filesystem.pin_snapshot_volume(version));
+        cursor = std::make_unique < tree_cursor_t > (**view);
+        read = [&](inode_id_t inode_id, char * buffer, htmpfs_size_t length, htmpfs_size_t offset)
+        {
+            return (*view)->read(inode_id, buffer, length, offset);
+        };
+    }
+
+    tar_statistics_t statistics;
+    tar_writer_t writer(output);
+    const htmpfs_size_t chunk_size = std::max < htmpfs_size_t > (filesystem.get_block_size(), 1024 * 1024);
+    std::vector < char > chunk(chunk_size);
+
+    // pre-order, archive pathnames are relative to root
+    tree_entry_t entry { };
+    while (cursor->next(entry))
+    {
+        std::string pathname(entry.pathname.substr(1));
+        const auto & stat = entry.attributes;
+        auto size = (htmpfs_size_t)stat.st_size;
+
+        if (entry.is_dentry)
+        {
+            writer.write_entry(pathname + "/", stat, '5');
+            statistics.directories++;
+        }
+        else if (S_ISLNK(stat.st_mode))
+        {
+            std::string target(size, 0);
+            read(entry.inode_id, target.data(), size, 0);
+            writer.write_entry(pathname, stat, '2', target);
+            statistics.symlinks++;
+        }
+        else if (S_ISFIFO(stat.st_mode) || S_ISCHR(stat.st_mode) || S_ISBLK(stat.st_mode))
+        {
+            writer.write_entry(pathname, stat, S_ISFIFO(stat.st_mode) ? '6' : (S_ISCHR(stat.st_mode) ? '3' : '4'));
+            statistics.specials++;
+        }
+        else if (S_ISSOCK(stat.st_mode))
+        {
+            // no tar entry type for sockets
+            statistics.skipped++;
+        }
+        else
+        {
+            writer.write_entry(pathname, stat, '0', "", size);
+            for (htmpfs_size_t offset = 0; offset < size; offset += chunk_size)
+            {
+                htmpfs_size_t length = std::min(chunk_size, size - offset);
+                memset(chunk.data(), 0, length);
+                read(entry.inode_id, chunk.data(), length, offset);
+                writer.write_data(chunk.data(), length);
+            }
+
+            writer.end_data(size);
+            statistics.files++;
+            statistics.bytes += size;
+        }
+    }
+
+    writer.finish();
+    return statistics;
+}
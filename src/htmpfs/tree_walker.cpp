@@ -0,0 +1,271 @@
+/** @file
+ *
+ * This file implements full-tree traversal of a version
+ */
+
+#include <htmpfs/tree_walker.h>
+#include <htmpfs/directory_resolver.h>
+#include <htmpfs_error.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+tree_cursor_t::tree_cursor_t(inode_smi_t & _filesystem, const snapshot_ver_t & version,
+                             inode_id_t root, std::string root_pathname)
+: filesystem(&_filesystem), pathname(std::move(root_pathname))
+{
+    if (version != FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        pinned = std::make_unique < snapshot_reader_t > (_filesystem.pin_snapshot_volume(version));
+        view = &**pinned;
+    }
+
+    bool is_dentry = view ? view->is_dentry(root) : filesystem->get_inode_by_id(root)->__is_dentry();
+    if (!is_dentry)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    levels.emplace_back(level_t { .directory = root, .cookie = 0, .pathname_length = pathname.length() });
+}
+
+tree_cursor_t::tree_cursor_t(const snapshot_view_t & _view, inode_id_t root, std::string root_pathname)
+: view(&_view), pathname(std::move(root_pathname))
+{
+    if (!view->is_dentry(root))
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    levels.emplace_back(level_t { .directory = root, .cookie = 0, .pathname_length = pathname.length() });
+}
+
+bool tree_cursor_t::next_dentry(level_t & level, std::string & name, inode_id_t & inode_id)
+{
+    bool found = false;
+    auto take = [&](const char * dentry_name, inode_id_t dentry_inode_id, uint64_t cookie)->bool
+    {
+        name = dentry_name;
+        inode_id = dentry_inode_id;
+        level.cookie = cookie;
+        found = true;
+        return false;
+    };
+
+    if (view)
+    {
+        view->readdir(level.directory, level.cookie, take);
+    }
+    else
+    {
+        // parsed directory is cached by inode, resolver is cheap to make again
+        directory_resolver_t resolver(filesystem->get_inode_by_id(level.directory), FILESYSTEM_CUR_MODIFIABLE_VER);
+        resolver.readdir(level.cookie, take);
+    }
+
+    return found;
+}
+
+void tree_cursor_t::fill(tree_entry_t & entry, inode_id_t inode_id)
+{
+    entry.inode_id = inode_id;
+    if (view)
+    {
+        entry.attributes = view->get_stat(inode_id);
+        entry.is_dentry = view->is_dentry(inode_id);
+        return;
+    }
+
+    auto * inode = filesystem->get_inode_by_id(inode_id);
+    entry.attributes = inode->fs_stat.to_stat();
+    entry.attributes.st_ino = inode_id;
+    entry.attributes.st_size = (off_t)inode->current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER);
+    entry.is_dentry = inode->__is_dentry();
+}
+
+bool tree_cursor_t::next(tree_entry_t & entry)
+{
+    if (descend)
+    {
+        levels.emplace_back(level_t { .directory = last_inode_id, .cookie = 0, .pathname_length = pathname.length() });
+        descend = false;
+    }
+
+    std::string name;
+    inode_id_t inode_id;
+    while (!levels.empty())
+    {
+        auto & level = levels.back();
+        if (!next_dentry(level, name, inode_id))
+        {
+            levels.pop_back();
+            continue;
+        }
+
+        pathname.resize(level.pathname_length);
+        pathname += '/';
+        pathname += name;
+
+        fill(entry, inode_id);
+        entry.pathname = pathname;
+        entry.depth = levels.size();
+
+        descend = entry.is_dentry;
+        last_inode_id = inode_id;
+        return true;
+    }
+
+    return false;
+}
+
+void walk_tree(inode_smi_t & filesystem, const snapshot_ver_t & version,
+               const std::function < tree_walk_action_t (const tree_entry_t &) > & func,
+               inode_id_t root)
+{
+    tree_cursor_t cursor(filesystem, version, root);
+    tree_entry_t entry { };
+    while (cursor.next(entry))
+    {
+        auto action = func(entry);
+        if (action == TREE_WALK_STOP)
+        {
+            return;
+        }
+
+        if (action == TREE_WALK_SKIP_SUBTREE)
+        {
+            cursor.skip_subtree();
+        }
+    }
+}
+
+void walk_tree_parallel(inode_smi_t & filesystem, const snapshot_ver_t & version, unsigned int threads,
+                        const std::function < tree_walk_action_t (const tree_entry_t &) > & func,
+                        inode_id_t root)
+{
+    if (version == FILESYSTEM_CUR_MODIFIABLE_VER || threads <= 1)
+    {
+        walk_tree(filesystem, version, func, root);
+        return;
+    }
+
+    /// a subtree handed out, its root is already visited
+    struct subtree_t
+    {
+        inode_id_t inode_id;
+        std::string pathname;
+        htmpfs_size_t depth;
+    };
+
+    auto view = filesystem.pin_snapshot_volume(version);
+    if (!view->is_dentry(root))
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NOT_A_DIRECTORY);
+    }
+
+    std::mutex lock;
+    std::condition_variable queue_changed;
+    std::deque < subtree_t > queue { subtree_t { .inode_id = root, .pathname = "", .depth = 0 } };
+    unsigned int busy = 0;
+    std::exception_ptr error;
+
+    // read without lock on every dentry, only to decide whether a subtree is given away
+    std::atomic < unsigned int > idle { 0 };
+    std::atomic < bool > stopped { false };
+
+    auto worker = [&]()
+    {
+        while (true)
+        {
+            subtree_t subtree;
+            {
+                std::unique_lock < std::mutex > guard(lock);
+                idle++;
+                queue_changed.wait(guard, [&] { return !queue.empty() || busy == 0 || stopped; });
+                idle--;
+
+                // walk is done once no one is left to hand a subtree out
+                if (queue.empty() || stopped)
+                {
+                    queue_changed.notify_all();
+                    return;
+                }
+
+                subtree = std::move(queue.back());
+                queue.pop_back();
+                busy++;
+            }
+
+            try
+            {
+                tree_cursor_t cursor(*view, subtree.inode_id, subtree.pathname);
+                tree_entry_t entry { };
+                while (!stopped && cursor.next(entry))
+                {
+                    entry.depth += subtree.depth;
+                    auto action = func(entry);
+                    if (action == TREE_WALK_STOP)
+                    {
+                        stopped = true;
+                        break;
+                    }
+
+                    if (action == TREE_WALK_SKIP_SUBTREE || !entry.is_dentry || idle == 0)
+                    {
+                        if (action == TREE_WALK_SKIP_SUBTREE)
+                        {
+                            cursor.skip_subtree();
+                        }
+
+                        continue;
+                    }
+
+                    // another worker is waiting, give it this subdirectory
+                    cursor.skip_subtree();
+                    std::lock_guard < std::mutex > guard(lock);
+                    queue.emplace_back(subtree_t {
+                        .inode_id = entry.inode_id, .pathname = std::string(entry.pathname), .depth = entry.depth });
+                    queue_changed.notify_one();
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard < std::mutex > guard(lock);
+                if (!error)
+                {
+                    error = std::current_exception();
+                }
+
+                stopped = true;
+            }
+
+            std::lock_guard < std::mutex > guard(lock);
+            busy--;
+            if (busy == 0 || stopped)
+            {
+                queue_changed.notify_all();
+            }
+        }
+    };
+
+    std::vector < std::thread > workers;
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        workers.emplace_back(worker);
+    }
+
+    // calling thread is a worker too
+    worker();
+
+    for (auto & i : workers)
+    {
+        i.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
@@ -19,6 +19,12 @@
 
 extern SmartPtr < inode_smi_t > filesystem_inode_smi;
 
+/// background COW break bandwidth, in bytes per second. 0 disables background COW break
+extern htmpfs_size_t cow_break_bandwidth;
+
+/// background block reclamation rate, in blocks per second. 0 unlinks blocks inline
+extern htmpfs_size_t reclaim_rate;
+
 int do_getattr  (const char * path, struct stat *stbuf);
 int do_readlink (const char * path, char *, size_t);
 int do_mknod    (const char * path, mode_t mode, dev_t device);
@@ -16,10 +16,22 @@ class buffer_t
 private:
     data_t data;
 
+    /// bytes owned by someone else, i.e., a mapped base image, used instead of data until first change
+    const char * shared = nullptr;
+    htmpfs_size_t shared_length = 0;
+
+    /// copy shared bytes into data, before buffer changes
+    void unshare();
+
 public:
     buffer_t() = default;
     buffer_t(const char *, htmpfs_size_t);
 
+    /// make a buffer reading bytes in place, without copying them
+    /// @param bytes bytes outliving the buffer, they are never written
+    /// @param length length of bytes
+    static buffer_t share(const char * bytes, htmpfs_size_t length);
+
 //    /// clear buffer
 //    void clear() { data.clear(); }
 
@@ -27,7 +39,7 @@ public:
     /// @param buffer buffer output storage
     /// @param length read length
     /// @param offset read offset
-    htmpfs_size_t read(char * buffer, htmpfs_size_t length, htmpfs_size_t offset);
+    htmpfs_size_t read(char * buffer, htmpfs_size_t length, htmpfs_size_t offset) const;
 
     /// write(buffer, length, offset, resize)
     /// @param buffer write buffer
@@ -41,13 +53,13 @@ public:
     std::string to_string();
 
     /// check if buffer is empty
-    [[nodiscard]] bool empty() const { return data.empty(); }
+    [[nodiscard]] bool empty() const { return size() == 0; }
 
     /// get a hash value for current buffer bank
     uint64_t hash64();
 
     /// return size of current buffer bank
-    [[nodiscard]] htmpfs_size_t size() const { return data.size(); }
+    [[nodiscard]] htmpfs_size_t size() const { return shared ? shared_length : data.size(); }
 
     /// change size of current buffer
     void truncate(htmpfs_size_t length);
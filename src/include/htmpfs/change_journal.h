@@ -0,0 +1,87 @@
+#ifndef HTMPFS_CHANGE_JOURNAL_H
+#define HTMPFS_CHANGE_JOURNAL_H
+
+/** @file
+ *  this file defines a bounded in-memory change journal
+ */
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <htmpfs/htmpfs_types.h>
+
+/*
+ * Change Journal
+ *
+ * every change made to version 0 is appended to the journal with a monotonic sequence number.
+ * journal keeps the latest `capacity` entries only, older entries are dropped.
+ *
+ * consumers remember the sequence number of the last entry they have processed (cursor),
+ * and read all entries after it. if entries after the cursor have already been dropped,
+ * the consumer has fallen behind and must rescan.
+ *
+ * */
+
+class change_journal_t
+{
+public:
+    /// change type
+    enum operation_t : uint8_t
+    {
+        JOURNAL_CREATE,
+        JOURNAL_UNLINK,
+        JOURNAL_RENAME,
+        JOURNAL_WRITE,
+        JOURNAL_TRUNCATE,
+        JOURNAL_SETATTR,
+    };
+
+    /// parent of an entry when the change does not involve a dentry
+    static constexpr inode_id_t no_parent = UINT64_MAX;
+
+    struct entry_t
+    {
+        uint64_t        sequence;
+        operation_t     operation;
+        inode_id_t      inode_id;
+        inode_id_t      parent_inode_id;        /* new parent for rename, no_parent for data/attr changes */
+        inode_id_t      source_parent_inode_id; /* old parent for rename, same as parent otherwise */
+        htmpfs_size_t   offset;                 /* written range, or new size for truncate */
+        htmpfs_size_t   length;
+    };
+
+private:
+    htmpfs_size_t capacity;
+    std::deque < entry_t > entries;
+
+    /// sequence number of the latest entry, 0 if nothing is recorded yet
+    uint64_t last_sequence = 0;
+
+public:
+    explicit change_journal_t(htmpfs_size_t _capacity) : capacity(_capacity) { }
+
+    /// append an entry to journal
+    /// @return sequence number of the entry
+    uint64_t record(operation_t operation,
+                    inode_id_t inode_id,
+                    inode_id_t parent_inode_id,
+                    inode_id_t source_parent_inode_id,
+                    htmpfs_size_t offset = 0,
+                    htmpfs_size_t length = 0);
+
+    /// read entries after cursor
+    /// @param cursor sequence number of the last processed entry, 0 to start from the beginning
+    /// @param max_entries maximum entries returned
+    /// @return entries in sequence order, throw HTMPFS_JOURNAL_CURSOR_EXPIRED if entries after
+    ///         cursor are no longer available
+    [[nodiscard]] std::vector < entry_t > read(uint64_t cursor,
+                                               htmpfs_size_t max_entries = UINT64_MAX) const;
+
+    /// sequence number of the latest entry
+    [[nodiscard]] uint64_t get_last_sequence() const { return last_sequence; }
+
+    /// operation name
+    static const char * operation_name(operation_t operation);
+};
+
+#endif //HTMPFS_CHANGE_JOURNAL_H
@@ -0,0 +1,134 @@
+#ifndef HTMPFS_DENTRY_CACHE_H
+#define HTMPFS_DENTRY_CACHE_H
+
+/** @file
+ *  this file defines the dentry cache used by pathname resolution
+ */
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <htmpfs/htmpfs_types.h>
+
+/*
+ * Dentry Cache
+ *
+ * dentry cache maps (parent inode, name, version) to the child inode, so that resolving
+ * a pathname costs one hash lookup per component instead of one directory parse.
+ * names known to be absent are cached as negative entries.
+ *
+ * entries are grouped by directory, (parent inode, version), so that a single name,
+ * a whole directory or a whole version can be dropped without scanning the cache.
+ * the cache holds at most `capacity` entries, least recently used ones are evicted first.
+ * lookups take views of version and name, and make no allocation.
+ *
+ * */
+
+class dentry_cache_t
+{
+public:
+    enum lookup_result_t : uint8_t
+    {
+        DENTRY_CACHE_MISS,
+        DENTRY_CACHE_HIT,
+        DENTRY_CACHE_NEGATIVE,
+    };
+
+private:
+    struct directory_key_t
+    {
+        inode_id_t parent_inode_id;
+        snapshot_ver_t version;
+    };
+
+    /// directory key referring to a version it does not own, used by lookups
+    struct directory_key_view_t
+    {
+        inode_id_t parent_inode_id;
+        std::string_view version;
+    };
+
+    struct directory_key_hash_t
+    {
+        using is_transparent = void;
+
+        template < typename Key >
+        std::size_t operator()(const Key & key) const
+        {
+            return std::hash < inode_id_t > ()(key.parent_inode_id) ^ string_hash_t()(key.version);
+        }
+    };
+
+    struct directory_key_equal_t
+    {
+        using is_transparent = void;
+
+        template < typename Key, typename Other >
+        bool operator()(const Key & key, const Other & other) const
+        {
+            return key.parent_inode_id == other.parent_inode_id
+                && std::string_view(key.version) == std::string_view(other.version);
+        }
+    };
+
+    struct entry_t
+    {
+        directory_key_t directory;
+        std::string     name;
+        inode_id_t      inode_id;
+        bool            negative;
+    };
+
+    typedef std::list < entry_t >::iterator entry_iterator_t;
+
+    htmpfs_size_t capacity;
+
+    /// entries, most recently used first
+    std::list < entry_t > lru;
+
+    /// directory -> name -> entry
+    std::unordered_map < directory_key_t,
+            std::unordered_map < std::string, entry_iterator_t, string_hash_t, std::equal_to < > >,
+            directory_key_hash_t,
+            directory_key_equal_t
+    > directories;
+
+    /// add or replace an entry
+    void emplace(inode_id_t parent_inode_id, std::string_view version,
+                 std::string_view name, inode_id_t inode_id, bool negative);
+
+    /// remove an entry from both lru list and its directory
+    void erase(entry_iterator_t entry);
+
+public:
+    explicit dentry_cache_t(htmpfs_size_t _capacity) : capacity(_capacity) { }
+
+    /// lookup name under parent
+    /// @param inode_id child inode id, set on DENTRY_CACHE_HIT
+    /// @return DENTRY_CACHE_HIT, DENTRY_CACHE_NEGATIVE if name is known to be absent, or DENTRY_CACHE_MISS
+    lookup_result_t lookup(inode_id_t parent_inode_id, std::string_view version,
+                           std::string_view name, inode_id_t & inode_id);
+
+    /// cache an existing dentry
+    void insert(inode_id_t parent_inode_id, std::string_view version,
+                std::string_view name, inode_id_t inode_id);
+
+    /// cache an absent name
+    void insert_negative(inode_id_t parent_inode_id, std::string_view version,
+                         std::string_view name);
+
+    /// drop entry of a name
+    void invalidate(inode_id_t parent_inode_id, std::string_view version, std::string_view name);
+
+    /// drop all entries under a directory
+    void invalidate_directory(inode_id_t parent_inode_id, std::string_view version);
+
+    /// drop all entries of a snapshot version
+    void invalidate_version(std::string_view version);
+
+    /// cached entries
+    [[nodiscard]] htmpfs_size_t size() const { return lru.size(); }
+};
+
+#endif //HTMPFS_DENTRY_CACHE_H
@@ -7,11 +7,58 @@
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <memory>
+#include <functional>
 #include <htmpfs/buffer_t.h>
 #include <htmpfs/htmpfs_types.h>
+#include <htmpfs/name_table.h>
 
 class inode_t;
 
+/// maximum length of a dentry name
+#define DENTRY_NAME_MAX 255
+
+/*
+ * Directory Resolver
+ *
+ * directory resolver parses dentries of a directory inode, and keeps them in insertion order.
+ * every dentry is indexed by name in a hash table, lookup, insertion and removal
+ * cost O(1) expected regardless of directory size.
+ *
+ * removed dentries are left as tombstones to keep the order of other dentries and their
+ * positions in the index stable. tombstones are compacted once they outnumber live dentries.
+ *
+ * on inode, a directory is a record count followed by variable-length records, tombstones included.
+ * a record stores a flag byte, the length of the name prefix shared with the previous record,
+ * the length of the remaining suffix, the inode id as a varint, then the suffix itself.
+ *
+ *      [flags:1][shared:1][suffix length:1][inode id:1-10][suffix]
+ *
+ * tombstones keep their name, so that the prefix chain stays decodable.
+ *
+ * save_current() only writes what changed since the last refresh or save: a removed dentry
+ * sets the tombstone flag of its record, new dentries are appended, then the record count is updated.
+ * the whole directory is rewritten only when tombstones get compacted.
+ *
+ * parsing a directory is done once: the parsed directory of version 0 is cached in the inode and
+ * shared by every resolver created afterwards, which keeps it up to date while saving.
+ * a resolver destroyed with unsaved changes drops the cache, so the next one parses the inode again.
+ * snapshot versions are parsed on every construction, they are served by snapshot views instead.
+ *
+ * every dentry gets a readdir cookie, increasing in dentry order and kept by compaction,
+ * so that a listing can be resumed after any dentry, even if dentries were added or removed in between.
+ * cookies are renumbered only when the directory is parsed again.
+ *
+ * every dentry added or removed is dropped from the dentry cache of the filesystem,
+ * so that pathname resolution never sees a stale or a stale negative entry.
+ *
+ * parsed dentries do not own their names, names are interned in the name table of the filesystem
+ * and dentries keep name ids, tombstones included. the index is keyed by name id, so a lookup
+ * interns nothing: a name unknown to the name table is absent from every directory.
+ *
+ * */
+
 class directory_resolver_t
 {
 public:
@@ -21,15 +68,64 @@ public:
         uint64_t inode_id;
     };
 
-    struct flat_path_pack_t
+    /// fixed part of an on-inode dentry record
+    struct dentry_record_head_t
     {
-        char pathname[128] {};
-        uint64_t inode_id {};
+        uint8_t flags;
+        uint8_t shared_length;
+        uint8_t suffix_length;
     };
 
+    /// dentry record flag: record is a tombstone
+    static constexpr uint8_t record_removed = 0x01;
+
 private:
 
-    std::vector < path_pack_t > path;
+    /// dentry slot, removed dentries are kept as tombstones until compaction
+    struct dentry_slot_t
+    {
+        uint64_t inode_id = 0;
+        uint64_t cookie = 0;                /* readdir cookie, increasing in dentry order */
+        htmpfs_size_t record_offset = 0;    /* offset of record on inode */
+        name_id_t name = 0;                 /* one reference held on name table */
+        bool removed = false;
+    };
+
+    /// parsed directory, shared by all resolvers of version 0 of the same inode
+    struct parsed_directory_t
+    {
+        name_table_t * names;
+        std::vector < dentry_slot_t > path;
+
+        /// name id -> position in path
+        std::unordered_map < name_id_t, htmpfs_size_t > path_index;
+        htmpfs_size_t tombstone_count = 0;
+
+        /// records stored on inode as of last refresh or save
+        htmpfs_size_t persisted_count = 0;
+
+        /// length of directory on inode as of last refresh or save
+        htmpfs_size_t persisted_length = 0;
+
+        /// stored records removed since last refresh or save
+        std::vector < htmpfs_size_t > pending_removals;
+
+        /// cookie of the latest dentry
+        uint64_t last_cookie = 0;
+
+        explicit parsed_directory_t(name_table_t * _names) : names(_names) { }
+        parsed_directory_t(const parsed_directory_t &) = delete;
+        parsed_directory_t & operator=(const parsed_directory_t &) = delete;
+
+        /// release names held by dentries
+        ~parsed_directory_t();
+    };
+
+    std::shared_ptr < parsed_directory_t > directory;
+
+    /// changes not saved to inode yet
+    bool is_dirty = false;
+
     inode_t * associated_inode;
     snapshot_ver_t access_version;
 
@@ -45,21 +141,65 @@ private:
         friend inode_t;
     };
 
+    /// drop tombstones, rebuild index
+    void compact();
+
+    /// rewrite all records on inode
+    void save_all();
+
+    /// drop dentry cache entry of pathname, or of the whole directory if pathname is empty
+    void invalidate_dentry_cache(const std::string & pathname = "");
+
+    /// encode records of path[begin, end) starting at offset, record offsets are updated
+    std::string encode_records(htmpfs_size_t begin, htmpfs_size_t end, htmpfs_size_t offset);
+
 public:
+    /// iterator over live dentries, in insertion order, dentries are copied out on dereference
+    class iterator
+    {
+    private:
+        std::vector < dentry_slot_t >::iterator current;
+        std::vector < dentry_slot_t >::iterator last;
+        const name_table_t * names;
+
+        void skip_removed() { while (current != last && current->removed) { current++; } }
+
+    public:
+        iterator(std::vector < dentry_slot_t >::iterator _current,
+                 std::vector < dentry_slot_t >::iterator _last,
+                 const name_table_t * _names)
+        : current(_current), last(_last), names(_names) { skip_removed(); }
+
+        path_pack_t operator*() const
+        {
+            return { .pathname = std::string(names->get(current->name)), .inode_id = current->inode_id };
+        }
+
+        iterator & operator++() { current++; skip_removed(); return *this; }
+        bool operator==(const iterator & other) const { return current == other.current; }
+        bool operator!=(const iterator & other) const { return current != other.current; }
+    };
+
     /// C++ 11 APIs
-    std::vector < path_pack_t >::iterator begin() { return path.begin(); }
-    std::vector < path_pack_t >::iterator end() { return path.end(); }
+    iterator begin() { return { directory->path.begin(), directory->path.end(), directory->names }; }
+    iterator end() { return { directory->path.end(), directory->path.end(), directory->names }; }
 
     /// create a directory resolver
     /// @param _associated_inode associated inode
     /// @param ver snapshot version
     explicit directory_resolver_t(inode_t * _associated_inode, snapshot_ver_t ver);
 
-    /// refresh from inode
+    directory_resolver_t(const directory_resolver_t &) = delete;
+    directory_resolver_t & operator=(const directory_resolver_t &) = delete;
+
+    /// drop cached directory if changes are left unsaved
+    ~directory_resolver_t();
+
+    /// refresh from inode, discarding unsaved changes
     void refresh();
 
     /// return current target count in current cache
-    [[nodiscard]] htmpfs_size_t target_count () const { return path.size(); }
+    [[nodiscard]] htmpfs_size_t target_count () const { return directory->path_index.size(); }
 
     /// make a vector by path
     /// @return current dentry vector
@@ -75,19 +215,31 @@ public:
     /// @param inode_id inode id
     void remove_path(const std::string & pathname);
 
-    /// save curren dentry string
+    /// save changes since last refresh or save to inode
     void save_current();
 
+    /// list live dentries, starting after a cookie
+    /// @param after_cookie cookie of the last dentry already listed, 0 to start from the beginning
+    /// @param func invoked with (null-terminated name, inode id, cookie) in dentry order,
+    ///             listing stops when it returns false
+    void readdir(uint64_t after_cookie, const std::function < bool (const char *, uint64_t, uint64_t) > & func);
+
     /// get inode id by name
     /// @param pathname dentry entry
     /// @return inode id
-    uint64_t namei(const std::string & pathname);
+    uint64_t namei(std::string_view pathname);
+
+    /// get inode id by name, without throwing if name does not exist
+    /// @param pathname dentry entry
+    /// @param inode_id inode id, set if pathname exists
+    /// @return false if pathname does not exist
+    bool lookup(std::string_view pathname, uint64_t & inode_id);
 
     /// check if pathname is available
     /// @param pathname pathname pending for checking
     /// @return availability status. true means pathname is available,
     ///         false means pathname is occupied
-    bool check_availability(const std::string & pathname);
+    bool check_availability(std::string_view pathname);
 
     friend inode_t;
 };
@@ -11,10 +11,30 @@
 #include <htmpfs/buffer_t.h>
 #include <uni_utils.h>
 #include <map>
+#include <list>
+#include <deque>
+#include <unordered_map>
 #include <string>
 #include <htmpfs/path_t.h>
 #include <htmpfs/directory_resolver.h>
 #include <htmpfs/htmpfs_types.h>
+#include <htmpfs/snapshot_view.h>
+#include <htmpfs/change_journal.h>
+#include <htmpfs/dentry_cache.h>
+#include <htmpfs/slot_map.h>
+#include <htmpfs/name_table.h>
+#include <htmpfs/membership_set.h>
+#include <htmpfs/lower_layer.h>
+#include <memory>
+#include <cstdio>
+
+#ifndef RENAME_NOREPLACE
+# define RENAME_NOREPLACE   (1 << 0)
+#endif // RENAME_NOREPLACE
+
+#ifndef RENAME_EXCHANGE
+# define RENAME_EXCHANGE    (1 << 1)
+#endif // RENAME_EXCHANGE
 
 /*
  * Index node
@@ -27,16 +47,39 @@
 class inode_t
 {
 private:
-    htmpfs_size_t block_size;
+    typedef std::vector < buffer_result_t > block_list_t;
+    typedef std::map < snapshot_ver_t /* snapshot version */, block_list_t /* block map */ > snapshot_block_map_t;
+
     inode_id_t    inode_id;
-    inode_smi_t * filesystem;
+    inode_smi_t * filesystem; /* block size is taken from filesystem, not stored per inode */
 
     bool is_dentry = false;
 
-    /// only make sense for root inode
-    std::map < snapshot_ver_t /* snapshot version */,
-            std::vector < buffer_result_t > /* block map */
-    > buffer_map;
+    /// directory not listed from lower layer yet, or data still read from lower layer
+    bool lower_pending = false;
+
+    /// increased every time the block list or data size of version 0 changes
+    uint64_t content_generation = 0;
+
+    /// block map of version 0
+    block_list_t current_blocks;
+
+    /// block maps of snapshot volumes, allocated on first snapshot volume of this inode
+    std::unique_ptr < snapshot_block_map_t > snapshot_blocks;
+
+    /// parsed directory of version 0, shared by directory resolvers
+    std::shared_ptr < directory_resolver_t::parsed_directory_t > parsed_directory;
+
+    /// get block map by version
+    /// @return nullptr if version does not exist in this inode
+    block_list_t * find_block_list(const snapshot_ver_t & version);
+
+    /// change size of current inode buffer, without journaling
+    void resize_data(htmpfs_size_t size);
+
+    /// replace a snapshot-frozen buffer of version 0 by a private copy
+    /// @param index buffer index in version 0
+    void unfreeze_block(htmpfs_size_t index);
 
 public:
     /// public accessible dentry flag
@@ -50,11 +93,10 @@ public:
 
     /// file attributes. NOTE: this attribute is not maintained by any member of inode_t
     /// if you wish to use this attribute, you have to update the information manually
-    struct stat fs_stat { };
+    inode_stat_t fs_stat { };
 
     /// initialize block
-    explicit inode_t(htmpfs_size_t _block_size,
-                     inode_id_t    _inode_id,
+    explicit inode_t(inode_id_t    _inode_id,
                      inode_smi_t * _filesystem,
                      bool _is_dentry = false);
 
@@ -99,12 +141,19 @@ public:
     /// @param volume_version volume version, provided by user
     void delete_volume(const snapshot_ver_t& volume_version);
 
+    /// copy snapshot-frozen blocks of version 0 into private blocks ahead of writes
+    /// @param byte_budget maximum bytes copied, nothing is copied if it is below one block
+    /// @param done set to true if no frozen block remains
+    /// @return bytes copied
+    htmpfs_size_t break_frozen_blocks(htmpfs_size_t byte_budget, bool & done);
+
 //    htmpfs_size_t block_count(const snapshot_ver_t& version);
 
     /// change size of current inode buffer
     void truncate(htmpfs_size_t size);
 
     friend class inode_smi_t;
+    friend class directory_resolver_t;
 };
 
 /*
@@ -155,18 +204,117 @@ private:
     /// root inode
     inode_t * filesystem_root;
 
-    /// block pool, auto deconstruction enabled
-    std::map < buffer_id_t, buffer_pack_t > buffer_pool;
+    /// dentry names interned for all directories, outlives inode pool
+    name_table_t name_table;
+
+    /// block pool, auto deconstruction enabled, buffer id is slot id
+    slot_map_t < buffer_pack_t > buffer_pool;
+
+    /// inode pool, inode id is slot id
+    slot_map_t < inode_pack_t > inode_pool;
+
+    /// snapshot version list, inodes of every version as slot indices of inode pool
+    /// snapshot volumes share membership chunks with version 0 until version 0 changes
+    std::map < snapshot_ver_t, membership_set_t > snapshot_version_list;
+
+    /// get inode in a slot of inode pool, slot must be live
+    inode_result_t inode_in_slot(uint64_t slot_index);
+
+    /// per-inode version history index, distinct contents in snapshot creation order
+    std::map < inode_id_t, std::vector < version_history_entry_t > > version_history;
+
+    /// record snapshot version in version history of an inode
+    void record_version_history(inode_t * inode, const snapshot_ver_t & version);
+
+    /// drop snapshot version from version history of an inode
+    void forget_version_history(inode_id_t inode_id, const snapshot_ver_t & version);
+
+    /// change journal of version 0
+    change_journal_t change_journal;
+
+    /// regular inodes of version 0 in write recency order, most recent first
+    std::list < inode_id_t > write_recency;
+    std::unordered_map < inode_id_t, std::list < inode_id_t >::iterator > write_recency_index;
+
+    /// maximum inodes tracked by write recency list
+    static constexpr htmpfs_size_t write_recency_capacity = 4096;
+
+    /// inodes pending for background COW break, most recently written first
+    std::deque < inode_id_t > cow_break_queue;
+
+    /// block lists dropped from version 0, pending for reclamation, oldest first
+    std::deque < inode_t::block_list_t > reclaim_queue;
+
+    /// blocks of the front list in reclaim queue already unlinked
+    htmpfs_size_t reclaim_cursor = 0;
+
+    /// blocks pending in reclaim queue
+    htmpfs_size_t reclaim_pending_blocks = 0;
+
+    /// blocks unlinked by reclaim_step() so far
+    htmpfs_size_t reclaimed_block_count = 0;
+
+    /// leave blocks dropped by unlink and truncate to reclaim_step()
+    bool deferred_reclaim = false;
+
+    /// hand blocks dropped from version 0 over to reclamation
+    /// blocks are unlinked at once unless reclamation is deferred
+    void reclaim_blocks(inode_t::block_list_t && blocks);
 
-    /// inode pool
-    std::map < inode_id_t, inode_pack_t > inode_pool;
+    /// move inode to the front of write recency list
+    void touch_write_recency(inode_id_t inode_id);
 
-    /// snapshot version list
-    std::map < snapshot_ver_t, std::vector < inode_result_t > > snapshot_version_list;
+    /// drop inode from write recency list and COW break queue
+    void forget_write_recency(inode_id_t inode_id);
 
-    /// get a free id
-    template<class Typename>
-    uint64_t get_free_id(Typename & pool);
+    /// maximum entries kept by dentry cache
+    static constexpr htmpfs_size_t dentry_cache_capacity = 65536;
+
+    /// (parent inode, name, version) -> child inode, used by get_inode_id_by_path()
+    dentry_cache_t dentry_cache;
+
+    /// epoch domain protecting published snapshot views
+    epoch_domain_t snapshot_epoch;
+
+    /// published snapshot views, readable without locks
+    std::atomic < const snapshot_view_map_t * > published_snapshot_views;
+
+    /// build an immutable view of snapshot volume and publish it
+    void publish_snapshot_view(const snapshot_ver_t & version);
+
+    /// unpublish view of snapshot volume, view is reclaimed once no reader holds it
+    void unpublish_snapshot_view(const snapshot_ver_t & version);
+
+    /// retire an unpublished view, its buffers are unlinked on reclamation
+    void retire_snapshot_view(const snapshot_view_t * view);
+
+    /// drop an inode from version 0 once its dentry is removed, inode is freed with its last link
+    /// @param parent_inode_id parent the dentry was removed from
+    /// @param target_id inode of removed dentry
+    void drop_current_link(inode_id_t parent_inode_id, inode_id_t target_id);
+
+    /// free an inode whose last link is gone, with its blocks of version 0
+    void release_inode(inode_id_t inode_id);
+
+    /// check if a directory of version 0 is empty, false for regular inodes
+    bool is_empty_directory(inode_id_t inode_id);
+
+    /// host directory version 0 is lazily populated from, nullptr if none is attached
+    std::unique_ptr < lower_layer_t > lower_layer;
+
+    /// host files mapped by map_host_file(), (address, length), unmapped with filesystem
+    std::vector < std::pair < void *, htmpfs_size_t > > host_mappings;
+
+    /// make dentries of a directory still on lower layer, invoked by directory_resolver_t
+    /// names already in the directory shadow their host counterparts
+    void populate_lower_directory(inode_t * directory);
+
+    /// copy data of a file still on lower layer into blocks of version 0
+    /// @param length bytes copied, data beyond is dropped
+    void copy_up_lower_file(inode_t * inode, htmpfs_size_t length = UINT64_MAX);
+
+    /// replace data of a regular file by frozen blocks reading mapped bytes in place
+    void share_mapped_blocks(inode_t * inode, const char * bytes, htmpfs_size_t length);
 
 #ifdef CMAKE_BUILD_DEBUG
     public:
@@ -208,14 +356,30 @@ public:
     /// get current block size
     [[nodiscard]] htmpfs_size_t get_block_size () const { return block_size; }
 
+    /// get dentry names interned by directories
+    [[nodiscard]] const name_table_t & get_name_table() const { return name_table; }
+
+    /// fixed memory taken by one inode in inode pool, blocks and dentries excluded
+    static constexpr htmpfs_size_t bytes_per_inode() { return slot_map_t < inode_pack_t >::slot_bytes; }
+
     /// public accessible snapshot version list
-    const std::map < snapshot_ver_t, std::vector < inode_result_t > > &
+    const std::map < snapshot_ver_t, membership_set_t > &
             _snapshot_version_list = snapshot_version_list;
 
-    explicit inode_smi_t(htmpfs_size_t _block_size);
+    /// @param _block_size block size
+    /// @param _journal_capacity entries kept by change journal
+    explicit inode_smi_t(htmpfs_size_t _block_size, htmpfs_size_t _journal_capacity = 65536);
+    inode_smi_t(const inode_smi_t &) = delete;
+    inode_smi_t & operator=(const inode_smi_t &) = delete;
+    ~inode_smi_t();
 
     /// get inode pointer by path
-    inode_id_t get_inode_id_by_path(const std::string&);
+    /// path is parsed in place, lookups served by dentry cache make no allocation
+    inode_id_t get_inode_id_by_path(std::string_view path);
+
+    /// get inode pointer by path, without throwing for absent names
+    /// @return false if any component of path does not exist
+    bool try_get_inode_id_by_path(std::string_view path, inode_id_t & inode_id);
 
     /// get inode pointer by id
     inode_t * get_inode_by_id(inode_id_t inode_id);
@@ -233,6 +397,33 @@ public:
     void remove_child_dentry_under_parent(inode_id_t parent_inode_id,
                                           const std::string & name);
 
+    /// rename a dentry, only for version 0
+    /// both directories are updated in one step, a failed rename changes nothing.
+    /// a directory must not be moved into its own subtree, which is checked by VFS
+    /// @param source_parent_inode_id parent of the dentry
+    /// @param source_name name of the dentry
+    /// @param target_parent_inode_id new parent, can be the same as source parent
+    /// @param target_name new name
+    /// @param flags 0, RENAME_NOREPLACE (fail if target exists) or RENAME_EXCHANGE (swap source and target)
+    void rename(inode_id_t source_parent_inode_id, const std::string & source_name,
+                inode_id_t target_parent_inode_id, const std::string & target_name,
+                unsigned int flags = 0);
+
+    /// remove a dentry with its whole subtree, only for version 0
+    /// the subtree is detached from parent by one directory update, then its inodes are dropped
+    /// from version 0 without resolving their paths or rewriting their directories.
+    /// inodes still linked by snapshot volumes are kept for them
+    /// @param parent_inode_id parent of the dentry
+    /// @param name name of the dentry, can be a regular file
+    void remove_tree(inode_id_t parent_inode_id, const std::string & name);
+
+    /// apply a batch of namespace operations, only for version 0
+    /// operations are grouped by parent directory, every directory is saved once for the whole batch.
+    /// everything is checked before the first change, so that a failed batch changes nothing
+    /// @param operations operations in order, a parent made by the batch is referred to by parent_index
+    /// @return inode id made or changed by every operation, in order
+    std::vector < inode_id_t > apply_namespace_batch(const std::vector < namespace_op_t > & operations);
+
     /// remove an inode by path, for debug purpose only
     void remove_inode_by_path(const std::string & pathname);
 
@@ -244,29 +435,123 @@ public:
     /// @param version snapshot version
     void delete_snapshot_volume(const snapshot_ver_t& version);
 
+    /// pin immutable view of a snapshot volume
+    /// the view can be read without any lock, even while version 0 is being modified
+    /// or the snapshot volume is being deleted
+    /// @param version snapshot version
+    /// @return pinned view, valid until destruction
+    snapshot_reader_t pin_snapshot_volume(std::string_view version);
+
+    /// break COW of recently written inodes ahead of writes after a snapshot
+    /// frozen blocks of inodes queued by create_snapshot_volume() are copied into private blocks,
+    /// so that foreground writes find them already private
+    /// @param byte_budget maximum bytes copied by this step, nothing is copied if it is below one block
+    /// @return bytes copied
+    htmpfs_size_t break_cow_step(htmpfs_size_t byte_budget);
+
+    /// rate-limited break_cow_step(), invoked periodically by background COW break.
+    /// a budget below one block is carried over until it covers one, so that any bandwidth is honoured
+    /// @param byte_credit bytes allowed and not spent yet, kept by caller between invocations.
+    ///                    bytes copied are taken from it, it is dropped once nothing is pending,
+    ///                    so that idle time does not allow a burst later
+    /// @return bytes copied
+    htmpfs_size_t break_cow_with_credit(htmpfs_size_t & byte_credit);
+
+    /// check if any inode is pending for background COW break
+    [[nodiscard]] bool cow_break_pending() const { return !cow_break_queue.empty(); }
+
+    /// defer unlinking of blocks dropped by unlink and truncate to reclaim_step(),
+    /// so that freeing a large file costs no more than freeing an empty one.
+    /// pending blocks are unlinked at once when deferral is turned off
+    void set_deferred_reclaim(bool deferred);
+
+    /// unlink blocks pending for reclamation, oldest first
+    /// @param block_budget maximum blocks unlinked by this step
+    /// @return blocks unlinked
+    htmpfs_size_t reclaim_step(htmpfs_size_t block_budget);
+
+    /// blocks pending for reclamation
+    [[nodiscard]] htmpfs_size_t reclaim_pending() const { return reclaim_pending_blocks; }
+
+    /// blocks unlinked by reclaim_step() so far
+    [[nodiscard]] htmpfs_size_t reclaimed_blocks() const { return reclaimed_block_count; }
+
+    /// reclaim views of deleted and sealed snapshot volumes, and frozen blocks only they link,
+    /// once no reader pins them anymore. views still pinned when unpublished are otherwise
+    /// left until next snapshot operation
+    void collect_retired();
+
+    /// retired snapshot views and view maps waiting for readers to leave
+    [[nodiscard]] htmpfs_size_t retired_pending() { return snapshot_epoch.pending(); }
+
+    /// blocks allocated, a block shared by versions is counted once
+    [[nodiscard]] htmpfs_size_t block_count() const { return buffer_pool.size(); }
+
+    /// attach a host directory as lower layer of root, only for version 0
+    /// dentries and data are read from host on first access, and copied up only when changed
+    /// @param host_directory host directory, expected to stay unchanged while filesystem exists
+    void attach_lower_layer(const std::string & host_directory);
+
+    /// freeze everything left on lower layer, invoked by create_snapshot_volume().
+    /// directories left are listed, regular files left are mapped by map_host_file() and read from page cache
+    /// through frozen blocks, so that their data is neither copied nor held by filesystem.
+    /// symbolic links, and files once host refuses to map more, are copied up
+    void materialize_lower_layer();
+
+    /// map a host file read-only until filesystem is destroyed, i.e., a base image.
+    /// its pages are held once by page cache, for every filesystem and every process mapping it
+    /// @param pathname host pathname, expected to stay unchanged while mapped
+    /// @return mapped bytes
+    std::string_view map_host_file(const std::string & pathname);
+
+    /// make data of a regular file of version 0 out of bytes mapped by map_host_file(), without copying them.
+    /// blocks are frozen, so that writes copy them into private blocks, as they do after a snapshot
+    /// @param inode_id regular file, its data is replaced
+    /// @param bytes mapped bytes
+    /// @param length length of bytes
+    void share_mapped_data(inode_id_t inode_id, const char * bytes, htmpfs_size_t length);
+
+    /// inodes of version 0 still on lower layer
+    [[nodiscard]] htmpfs_size_t lower_layer_pending() const { return lower_layer ? lower_layer->size() : 0; }
+
+    /// compile view of a snapshot volume into its compact read-optimized layout
+    /// readers pinned on the old view keep it until they leave, sealing twice is a no-op
+    /// @param version snapshot version
+    void seal_snapshot_volume(const snapshot_ver_t & version);
+
     /// export current filesystem layout as filesystem map
-    /// @retuen filesystem layout
+    /// @return pathname of every dentry, in pre-order
     std::vector < std::string > export_as_filesystem_map(snapshot_ver_t version);
 
     htmpfs_size_t count_link_for_inode(inode_id_t inode_id);
 
+    /// get distinct historical versions of a file
+    /// @param pathname pathname, can be prefixed by /.snapshot/$(version)
+    /// @return one entry per distinct content, oldest first. version 0 is listed
+    ///         as FILESYSTEM_CUR_MODIFIABLE_VER at the end of the last entry
+    ///         if its content is unchanged since the latest snapshot, or in an entry of its own
+    std::vector < version_history_entry_t > get_version_history(const std::string & pathname);
+
+    /// record a change that is not made through inode_smi_t or inode_t, i.e., rename and setattr
+    /// @return sequence number of the change
+    uint64_t record_change(change_journal_t::operation_t operation,
+                           inode_id_t inode_id,
+                           inode_id_t parent_inode_id = change_journal_t::no_parent,
+                           inode_id_t source_parent_inode_id = change_journal_t::no_parent);
+
+    /// read change journal after cursor
+    /// @param cursor sequence number of the last processed change, 0 to start from the beginning
+    /// @param max_entries maximum entries returned
+    /// @return changes in sequence order
+    std::vector < change_journal_t::entry_t > read_change_journal(uint64_t cursor,
+                                                                  htmpfs_size_t max_entries = UINT64_MAX);
+
+    /// sequence number of the latest change
+    [[nodiscard]] uint64_t get_journal_sequence() const { return change_journal.get_last_sequence(); }
+
     friend class inode_t;
     friend class bitmap_t;
+    friend class directory_resolver_t;
 };
 
-template<class Typename>
-uint64_t inode_smi_t::get_free_id(Typename & pool)
-{
-    if (pool.size() == pool.max_size()) {
-        THROW_HTMPFS_ERROR_STDERR(HTMPFS_BUFFER_ID_DEPLETED);
-    }
-
-    uint64_t id = pool.size();
-    while (pool.find(id) != pool.end()) {
-        id++;
-    }
-
-    return id;
-}
-
 #endif //HTMPFS_HTMPFS_H
@@ -5,8 +5,11 @@
  *  this file defines frequently used types
  */
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <sys/stat.h>
 
 #define LEFT_SHIFT64(val, bit_count)  ((uint64_t)((uint64_t)(val) << (uint64_t)bit_count))
 #define RIGHT_SHIFT64(val, bit_count) ((uint64_t)((uint64_t)(val) >> (uint64_t)bit_count))
@@ -44,6 +47,83 @@ struct inode_result_t
     inode_t * inode;
 };
 
+/// one distinct content of an inode, shared by every version listed in `versions`
+struct version_history_entry_t
+{
+    uint64_t content_generation;
+    uint64_t data_size;
+    std::vector < snapshot_ver_t > versions; /* oldest first */
+};
+
+/// file attributes of an inode, a compact subset of struct stat with the same field names.
+/// fields read on every getattr/read/write come first, so they share one cache line.
+/// st_ino and st_blksize are not stored, they are derived from inode id and filesystem.
+struct inode_stat_t
+{
+    /* hot */
+    uint32_t        st_mode = 0;
+    uint32_t        st_nlink = 0;
+    off_t           st_size = 0;
+    struct timespec st_mtim { };
+
+    /* cold */
+    uint32_t        st_uid = 0;
+    uint32_t        st_gid = 0;
+    struct timespec st_atim { };
+    struct timespec st_ctim { };
+    dev_t           st_dev = 0;
+
+    /// expand into struct stat, st_ino is left 0
+    [[nodiscard]] struct stat to_stat() const
+    {
+        struct stat ret { };
+        ret.st_mode = st_mode;
+        ret.st_nlink = st_nlink;
+        ret.st_size = st_size;
+        ret.st_mtim = st_mtim;
+        ret.st_uid = st_uid;
+        ret.st_gid = st_gid;
+        ret.st_atim = st_atim;
+        ret.st_ctim = st_ctim;
+        ret.st_dev = st_dev;
+        return ret;
+    }
+};
+
+/// one operation of a namespace batch, see inode_smi_t::apply_namespace_batch()
+struct namespace_op_t
+{
+    enum operation_t : uint8_t
+    {
+        NAMESPACE_CREATE,
+        NAMESPACE_MKDIR,
+        NAMESPACE_SYMLINK,
+        NAMESPACE_MKNOD,                        /* fifo, socket or device node, see attributes */
+        NAMESPACE_SETATTR,
+    };
+
+    /// parent_index of an operation whose parent is given by inode id
+    static constexpr uint64_t no_index = UINT64_MAX;
+
+    operation_t     operation = NAMESPACE_CREATE;
+    inode_id_t      parent_inode_id = 0;        /* ignored if parent_index is set */
+    uint64_t        parent_index = no_index;    /* index of an earlier NAMESPACE_MKDIR of the same batch */
+    std::string     name;
+    std::string     symlink_target;             /* NAMESPACE_SYMLINK only */
+
+    /// st_mode permission bits, st_uid, st_gid, st_atim, st_mtim and st_ctim given to new inode,
+    /// or set by NAMESPACE_SETATTR. file type bits of st_mode come from operation,
+    /// except for NAMESPACE_MKNOD, which takes them and device number st_dev from here
+    inode_stat_t    attributes;
+};
+
+/// transparent string hash, hash tables keyed by std::string can be searched by std::string_view
+struct string_hash_t
+{
+    using is_transparent = void;
+    std::size_t operator()(std::string_view str) const { return std::hash < std::string_view > ()(str); }
+};
+
 /// universal buffer type
 typedef std::vector <char> data_t;
 typedef uint64_t htmpfs_size_t;
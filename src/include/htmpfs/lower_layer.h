@@ -0,0 +1,111 @@
+#ifndef HTMPFS_LOWER_LAYER_H
+#define HTMPFS_LOWER_LAYER_H
+
+/** @file
+ *  this file defines the read-only host directory a filesystem is lazily populated from
+ */
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <sys/stat.h>
+#include <htmpfs/htmpfs_types.h>
+
+/*
+ * Lower Layer
+ *
+ * lower layer is a host directory, i.e., a read-only toolchain, shown inside of version 0
+ * without being copied up front. attaching it costs one stat of the host directory.
+ *
+ * an inode made from lower layer is tracked here with the host pathname it comes from,
+ * until it is materialized:
+ *      a directory is listed on host the first time it is resolved, then holds ordinary dentries.
+ *      a regular file or a symbolic link is read from host until it is first changed,
+ *      then its content is copied up into blocks.
+ * memory holds only directories that were resolved and files that were changed.
+ *
+ * a snapshot volume cannot read from a tracked inode, so taking the first snapshot lists every directory
+ * left and maps every regular file left: its blocks read the mapping in place, through page cache,
+ * and are frozen like blocks of a base image. file data is still not held by the filesystem.
+ *
+ * host pathnames are kept per inode, so a tracked inode can be renamed freely.
+ * descriptors of recently read host files are kept open.
+ * lower layer is expected to stay unchanged while the filesystem exists.
+ *
+ * */
+
+class lower_layer_t
+{
+public:
+    /// one dentry of a host directory
+    struct host_entry_t
+    {
+        std::string name;
+        struct stat attributes;
+    };
+
+private:
+    /// inode not materialized yet
+    struct tracked_inode_t
+    {
+        std::string host_path;
+        htmpfs_size_t size = 0;
+        bool is_symlink = false;
+        int fd = -1;                /* open host file, -1 if not opened yet */
+    };
+
+    /// maximum host files kept open
+    static constexpr htmpfs_size_t open_file_capacity = 64;
+
+    std::unordered_map < inode_id_t, tracked_inode_t > tracked_inodes;
+
+    /// inodes holding an open host file, oldest first
+    std::deque < inode_id_t > open_files;
+
+    /// get tracked inode, throw if inode is not tracked
+    tracked_inode_t & at(inode_id_t inode_id);
+
+    /// get open descriptor of a tracked host file, older descriptors are closed beyond capacity
+    int open_file(inode_id_t inode_id, tracked_inode_t & tracked);
+
+public:
+    lower_layer_t() = default;
+    lower_layer_t(const lower_layer_t &) = delete;
+    lower_layer_t & operator=(const lower_layer_t &) = delete;
+
+    /// close every open host file
+    ~lower_layer_t();
+
+    /// start tracking an inode made from host
+    /// @param inode_id inode id
+    /// @param host_path absolute host pathname
+    /// @param attributes host attributes, taken by lstat
+    void track(inode_id_t inode_id, std::string host_path, const struct stat & attributes);
+
+    /// stop tracking an inode, once it is materialized or removed
+    void forget(inode_id_t inode_id);
+
+    /// host pathname of a tracked inode
+    const std::string & host_path(inode_id_t inode_id) { return at(inode_id).host_path; }
+
+    /// data size of a tracked regular file or symbolic link
+    htmpfs_size_t data_size(inode_id_t inode_id) { return at(inode_id).size; }
+
+    /// list a host directory, "." and ".." excluded
+    /// @param host_path absolute host pathname
+    /// @return dentries with their attributes, in host order
+    static std::vector < host_entry_t > list(const std::string & host_path);
+
+    /// read data of a tracked regular file, or target of a tracked symbolic link
+    /// @return length of data read, never beyond size taken when inode was tracked
+    htmpfs_size_t read(inode_id_t inode_id, char * buffer, htmpfs_size_t length, htmpfs_size_t offset);
+
+    /// inodes still tracked
+    [[nodiscard]] std::vector < inode_id_t > tracked() const;
+
+    /// count of inodes still tracked
+    [[nodiscard]] htmpfs_size_t size() const { return tracked_inodes.size(); }
+};
+
+#endif //HTMPFS_LOWER_LAYER_H
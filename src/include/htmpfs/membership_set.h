@@ -0,0 +1,76 @@
+#ifndef HTMPFS_MEMBERSHIP_SET_H
+#define HTMPFS_MEMBERSHIP_SET_H
+
+/** @file
+ *  this file defines the copy-on-write bitset used for per-version inode membership
+ */
+
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <vector>
+#include <htmpfs/htmpfs_types.h>
+
+/*
+ * Membership Set
+ *
+ * membership set is a dense bitset over slot indices, insertion, removal and lookup cost O(1).
+ * bits are stored in fixed-size chunks shared between copies, so that copying a set,
+ * i.e., taking a snapshot of version 0, only copies chunk pointers. a chunk is cloned the first time
+ * a shared copy of it is modified. chunks without any bit set are not allocated.
+ *
+ * copies are not thread-safe with respect to each other, all of them must be modified under the same lock.
+ *
+ * */
+
+class membership_set_t
+{
+private:
+    static constexpr uint64_t chunk_bits = 12;
+    static constexpr uint64_t chunk_size = 1ULL << chunk_bits;   /* bits per chunk */
+    typedef std::array < uint64_t, chunk_size / 64 > chunk_t;
+
+    std::vector < std::shared_ptr < chunk_t > > chunks;
+    htmpfs_size_t member_count = 0;
+
+    /// get a chunk only owned by this set, allocate it if absent
+    chunk_t & writable_chunk(uint64_t chunk_index);
+
+public:
+    /// add index to set
+    /// @return false if index is already a member
+    bool insert(uint64_t index);
+
+    /// remove index from set
+    /// @return false if index is not a member
+    bool erase(uint64_t index);
+
+    /// check if index is a member
+    [[nodiscard]] bool contains(uint64_t index) const;
+
+    /// member count
+    [[nodiscard]] htmpfs_size_t size() const { return member_count; }
+
+    /// apply func to every member, in ascending order
+    template < typename Func >
+    void for_each(Func && func) const
+    {
+        for (uint64_t i = 0; i < chunks.size(); i++)
+        {
+            if (!chunks[i])
+            {
+                continue;
+            }
+
+            for (uint64_t word = 0; word < chunks[i]->size(); word++)
+            {
+                for (uint64_t bits = (*chunks[i])[word]; bits; bits &= bits - 1)
+                {
+                    func((i << chunk_bits) + word * 64 + __builtin_ctzll(bits));
+                }
+            }
+        }
+    }
+};
+
+#endif //HTMPFS_MEMBERSHIP_SET_H
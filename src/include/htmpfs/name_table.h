@@ -0,0 +1,86 @@
+#ifndef HTMPFS_NAME_TABLE_H
+#define HTMPFS_NAME_TABLE_H
+
+/** @file
+ *  this file defines the interned dentry name table
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <htmpfs/htmpfs_types.h>
+
+typedef uint32_t name_id_t;
+
+/*
+ * Name Table
+ *
+ * name table interns dentry names: every distinct name is stored once per filesystem,
+ * and referred to by a compact name id. directories store name ids instead of names,
+ * so that a name shared by many directories (Makefile, index.js, ...) costs one copy,
+ * and comparing two names is comparing two integers.
+ *
+ * names are reference counted, a name is dropped once its last reference is released,
+ * and its id is reused by the next new name. the hash of a name is computed once, when it is interned.
+ * stored names are null-terminated and never move, views returned by get() stay valid
+ * as long as a reference is held.
+ *
+ * */
+
+class name_table_t
+{
+public:
+    /// find() result for a name that is not interned
+    static constexpr name_id_t no_name = UINT32_MAX;
+
+private:
+    struct entry_t
+    {
+        std::unique_ptr < char [] > name;   /* null-terminated */
+        uint32_t length = 0;
+        uint32_t ref_count = 0;
+    };
+
+    std::vector < entry_t > entries;
+
+    /// ids of dropped names
+    std::vector < name_id_t > free_ids;
+
+    /// name -> id, keys refer to names owned by entries
+    std::unordered_map < std::string_view, name_id_t, string_hash_t > index;
+
+public:
+    name_table_t() = default;
+    name_table_t(const name_table_t &) = delete;
+    name_table_t & operator=(const name_table_t &) = delete;
+
+    /// intern a name, taking a reference
+    /// @return name id
+    name_id_t intern(std::string_view name);
+
+    /// find an interned name, no reference is taken
+    /// @return name id, no_name if name is not interned
+    [[nodiscard]] name_id_t find(std::string_view name) const;
+
+    /// take another reference of an interned name
+    void link(name_id_t name_id) { entries[name_id].ref_count++; }
+
+    /// release a reference, name is dropped with its last reference
+    void unlink(name_id_t name_id);
+
+    /// get name by id
+    [[nodiscard]] std::string_view get(name_id_t name_id) const
+    {
+        return { entries[name_id].name.get(), entries[name_id].length };
+    }
+
+    /// get null-terminated name by id
+    [[nodiscard]] const char * c_str(name_id_t name_id) const { return entries[name_id].name.get(); }
+
+    /// distinct names interned
+    [[nodiscard]] htmpfs_size_t size() const { return index.size(); }
+};
+
+#endif //HTMPFS_NAME_TABLE_H
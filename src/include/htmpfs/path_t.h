@@ -6,6 +6,7 @@
  */
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <htmpfs/buffer_t.h>
 
@@ -33,4 +34,57 @@ public:
     std::string to_string();
 };
 
+/*
+ * Pathname View
+ *
+ * path_view_t iterates over components of a pathname without copying them,
+ * components are views into the given pathname, which must outlive the iteration.
+ * unlike path_t, root is not listed as an empty component, repeated '/' are skipped.
+ *
+ * */
+
+class path_view_t
+{
+private:
+    std::string_view pathname;
+
+public:
+    class iterator
+    {
+    private:
+        std::string_view remaining;
+        std::string_view current;
+
+        void next()
+        {
+            auto begin = remaining.find_first_not_of('/');
+            if (begin == std::string_view::npos)
+            {
+                remaining = current = { };
+                return;
+            }
+
+            remaining.remove_prefix(begin);
+            current = remaining.substr(0, remaining.find('/'));
+            remaining.remove_prefix(current.length());
+        }
+
+    public:
+        explicit iterator(std::string_view _remaining) : remaining(_remaining) { next(); }
+
+        std::string_view operator*() const { return current; }
+        iterator & operator++() { next(); return *this; }
+        bool operator==(const iterator & other) const { return current.data() == other.current.data(); }
+        bool operator!=(const iterator & other) const { return !(*this == other); }
+    };
+
+    explicit path_view_t(std::string_view _pathname) : pathname(_pathname) { }
+
+    [[nodiscard]] iterator begin() const { return iterator(pathname); }
+    [[nodiscard]] iterator end() const { return iterator({ }); }
+
+    /// check if pathname has no component, i.e., is root
+    [[nodiscard]] bool empty() const { return begin() == end(); }
+};
+
 #endif //HTMPFS_PATH_T_H
@@ -0,0 +1,203 @@
+#ifndef HTMPFS_SLOT_MAP_H
+#define HTMPFS_SLOT_MAP_H
+
+/** @file
+ *  this file defines a generational slot map used by inode and buffer pools
+ */
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <htmpfs_error.h>
+
+/*
+ * Slot Map
+ *
+ * slot map stores objects in fixed-size chunks of slots, so that an object never moves once created,
+ * and pointers to it stay valid until it is erased.
+ * free slots are chained in a free list, allocation, erase and lookup all cost O(1).
+ *
+ * an id is the slot index in the lower 32 bits and the slot generation in the upper 32 bits.
+ * generation of a slot is increased every time its object is erased, so an id of an erased object
+ * never matches the object created in the same slot later on.
+ * a slot whose generation is exhausted is retired, it is never handed out again.
+ *
+ * the first object created in an empty slot map gets id 0.
+ *
+ * */
+
+template < typename Type >
+class slot_map_t
+{
+public:
+    typedef uint64_t slot_id_t;
+
+private:
+    static constexpr uint64_t chunk_bits = 10;
+    static constexpr uint64_t chunk_size = 1ULL << chunk_bits;
+    static constexpr uint64_t max_slots = 1ULL << 32;
+    static constexpr uint64_t no_slot = UINT64_MAX;
+
+    struct slot_t
+    {
+        alignas(Type) unsigned char storage [sizeof(Type)];
+        uint32_t generation = 0;
+        bool occupied = false;
+        uint64_t next_free = no_slot;
+
+        Type * get() { return std::launder(reinterpret_cast < Type * > (storage)); }
+    };
+
+    std::vector < std::unique_ptr < slot_t [] > > chunks;
+
+    /// slots handed out so far, free or not
+    uint64_t slot_count = 0;
+
+    /// head of free slot list
+    uint64_t free_head = no_slot;
+
+    /// live objects
+    uint64_t live_count = 0;
+
+    slot_t & slot_at(uint64_t index) { return chunks[index >> chunk_bits][index & (chunk_size - 1)]; }
+    const slot_t & slot_at(uint64_t index) const { return chunks[index >> chunk_bits][index & (chunk_size - 1)]; }
+
+    static slot_id_t make_id(uint64_t index, uint32_t generation) { return ((uint64_t)generation << 32) | index; }
+    static uint64_t index_of(slot_id_t id) { return id & (max_slots - 1); }
+    static uint32_t generation_of(slot_id_t id) { return (uint32_t)(id >> 32); }
+
+    /// slot of a live object, nullptr if id is unknown or stale
+    slot_t * live_slot(slot_id_t id)
+    {
+        auto index = index_of(id);
+        if (index >= slot_count)
+        {
+            return nullptr;
+        }
+
+        auto & slot = slot_at(index);
+        return (slot.occupied && slot.generation == generation_of(id)) ? &slot : nullptr;
+    }
+
+public:
+    /// memory taken by one slot, live or free
+    static constexpr uint64_t slot_bytes = sizeof(slot_t);
+
+    slot_map_t() = default;
+    slot_map_t(const slot_map_t &) = delete;
+    slot_map_t & operator=(const slot_map_t &) = delete;
+
+    ~slot_map_t()
+    {
+        for (uint64_t i = 0; i < slot_count; i++)
+        {
+            auto & slot = slot_at(i);
+            if (slot.occupied)
+            {
+                slot.get()->~Type();
+            }
+        }
+    }
+
+    /// id of the object created by the next emplace()
+    [[nodiscard]] slot_id_t next_id() const
+    {
+        if (free_head != no_slot)
+        {
+            return make_id(free_head, slot_at(free_head).generation);
+        }
+
+        if (slot_count == max_slots)
+        {
+            THROW_HTMPFS_ERROR_STDERR(HTMPFS_BUFFER_ID_DEPLETED);
+        }
+
+        return make_id(slot_count, 0);
+    }
+
+    /// create an object
+    /// @return id of the new object, same as next_id() before the call
+    template < typename... Args >
+    slot_id_t emplace(Args &&... args)
+    {
+        auto id = next_id();
+        auto index = index_of(id);
+
+        if (index == slot_count)
+        {
+            if (index % chunk_size == 0)
+            {
+                chunks.emplace_back(std::make_unique < slot_t [] > (chunk_size));
+            }
+
+            new (slot_at(index).storage) Type(std::forward < Args > (args)...);
+            slot_count++;
+        }
+        else
+        {
+            new (slot_at(index).storage) Type(std::forward < Args > (args)...);
+            free_head = slot_at(index).next_free;
+        }
+
+        slot_at(index).occupied = true;
+        live_count++;
+        return id;
+    }
+
+    /// get object by id
+    /// @return pointer to object, nullptr if id is unknown or stale
+    Type * find(slot_id_t id)
+    {
+        auto * slot = live_slot(id);
+        return slot ? slot->get() : nullptr;
+    }
+
+    /// get object by id, throw std::out_of_range if id is unknown or stale
+    Type & at(slot_id_t id)
+    {
+        auto * object = find(id);
+        if (!object)
+        {
+            throw std::out_of_range("slot_map_t::at");
+        }
+
+        return *object;
+    }
+
+    /// destroy object, its id becomes stale
+    void erase(slot_id_t id)
+    {
+        auto * slot = live_slot(id);
+        if (!slot)
+        {
+            return;
+        }
+
+        slot->get()->~Type();
+        slot->occupied = false;
+        live_count--;
+
+        // retire slot once generation is exhausted
+        if (++slot->generation == UINT32_MAX)
+        {
+            return;
+        }
+
+        slot->next_free = free_head;
+        free_head = index_of(id);
+    }
+
+    /// live objects
+    [[nodiscard]] uint64_t size() const { return live_count; }
+
+    /// slot index of an id, dense and below 2^32
+    static uint64_t slot_index(slot_id_t id) { return index_of(id); }
+
+    /// id of the live object in a slot
+    [[nodiscard]] slot_id_t id_at(uint64_t index) const { return make_id(index, slot_at(index).generation); }
+};
+
+#endif //HTMPFS_SLOT_MAP_H
@@ -0,0 +1,257 @@
+#ifndef HTMPFS_SNAPSHOT_VIEW_H
+#define HTMPFS_SNAPSHOT_VIEW_H
+
+/** @file
+ *  this file defines immutable snapshot views and the epoch based reclamation
+ *  that lets them be read without locks
+ */
+
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <map>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <htmpfs/htmpfs_types.h>
+#include <htmpfs/buffer_t.h>
+#include <htmpfs/directory_resolver.h>
+
+/*
+ * Epoch based reclamation
+ *
+ * readers pin the domain before dereferencing a published pointer, and unpin when done.
+ * writers unpublish an object first, then retire it. retired objects are reclaimed only
+ * after every reader pinned at (or before) the retirement epoch has left.
+ *
+ * readers never block and never take a lock. writers are expected to be serialized by caller.
+ *
+ * */
+
+class epoch_domain_t
+{
+public:
+    /// maximum readers pinned at the same time
+    static constexpr htmpfs_size_t max_readers = 256;
+
+private:
+    struct alignas(64) reader_slot_t
+    {
+        std::atomic < bool > in_use { false };
+        std::atomic < uint64_t > epoch { 0 };
+    };
+
+    struct retired_t
+    {
+        uint64_t epoch;
+        std::function < void () > reclaim;
+    };
+
+    std::atomic < uint64_t > global_epoch { 1 };
+    reader_slot_t reader_slots [max_readers];
+
+    std::mutex retired_lock;
+    std::vector < retired_t > retired;
+
+public:
+    /// pinned epoch, released on destruction
+    class guard_t
+    {
+    private:
+        reader_slot_t * slot;
+        explicit guard_t(reader_slot_t * _slot) : slot(_slot) { }
+
+    public:
+        guard_t(const guard_t &) = delete;
+        guard_t & operator=(const guard_t &) = delete;
+        guard_t(guard_t && other) noexcept : slot(other.slot) { other.slot = nullptr; }
+        ~guard_t();
+
+        friend epoch_domain_t;
+    };
+
+    /// pin current epoch
+    /// @return guard, objects published at pin time stay valid until guard is destroyed
+    guard_t pin();
+
+    /// retire an unpublished object
+    /// @param reclaim reclaim function, invoked by collect() once no reader can reach the object
+    void retire(std::function < void () > reclaim);
+
+    /// reclaim retired objects no reader can reach anymore
+    /// @param force reclaim everything, only valid when no reader exists
+    void collect(bool force = false);
+
+    /// retired objects pending for reclamation
+    htmpfs_size_t pending();
+};
+
+/*
+ * Snapshot View
+ *
+ * a snapshot view is an immutable copy of all metadata of one snapshot volume:
+ * attributes, data size, frozen block list and parsed dentries of every inode.
+ * block data is not copied, frozen buffers are never modified (COW), the view only keeps them linked.
+ *
+ * a view can be sealed, i.e., compiled into a compact read-optimized layout:
+ * inodes live in one contiguous array sorted by inode id, block lists, dentries and names
+ * are flattened into shared arrays, and every directory gets a perfect hash table.
+ * lookups and readdir on a sealed view only index into these arrays.
+ *
+ * */
+
+class snapshot_view_t
+{
+public:
+    /// inode information used to build a view
+    struct inode_view_t
+    {
+        inode_stat_t fs_stat { };
+        htmpfs_size_t data_size = 0;
+        bool is_dentry = false;
+        std::vector < buffer_result_t > blocks;
+        std::vector < directory_resolver_t::path_pack_t > dentries;
+        std::unordered_map < std::string, inode_id_t, string_hash_t, std::equal_to < > > dentry_index;
+    };
+
+    /// compact layout of a sealed view
+    struct sealed_layout_t
+    {
+        struct sealed_inode_t
+        {
+            inode_id_t      inode_id;
+            inode_stat_t    fs_stat;
+            htmpfs_size_t   data_size;
+            uint64_t        block_begin;
+            uint64_t        block_count;
+            uint64_t        dentry_begin;
+            uint64_t        dentry_count;
+            uint64_t        bucket_begin;   /* perfect hash displacement seeds */
+            uint64_t        bucket_count;
+            uint64_t        slot_begin;     /* perfect hash slots */
+            uint64_t        slot_count;
+            bool            is_dentry;
+        };
+
+        struct sealed_dentry_t
+        {
+            uint64_t name_offset;   /* null-terminated name in names */
+            uint32_t name_length;
+            uint32_t child;         /* index of child in inodes */
+        };
+
+        std::vector < sealed_inode_t > inodes;
+        std::vector < buffer_result_t > blocks;
+        std::vector < sealed_dentry_t > dentries;
+        std::vector < uint32_t > buckets;
+        std::vector < uint32_t > slots;
+        std::vector < char > names;
+    };
+
+private:
+    snapshot_ver_t version;
+    htmpfs_size_t block_size;
+    std::unordered_map < inode_id_t, inode_view_t > inodes;
+    sealed_layout_t sealed;
+    bool is_sealed_view = false;
+
+    /// get inode view by id, unsealed view only
+    [[nodiscard]] const inode_view_t & get_inode(inode_id_t inode_id) const;
+
+    /// get index of inode in sealed layout
+    [[nodiscard]] uint64_t sealed_index(inode_id_t inode_id) const;
+
+    /// sealed_namei() result for a name that does not exist
+    static constexpr uint64_t no_index = UINT64_MAX;
+
+    /// lookup name in directory of sealed layout
+    /// @return index of child in sealed layout, no_index if name does not exist
+    [[nodiscard]] uint64_t sealed_namei(uint64_t parent_index, std::string_view name) const;
+
+    /// lookup name in directory, unsealed view only
+    /// @return false if name does not exist
+    bool lookup(inode_id_t parent_inode_id, std::string_view name, inode_id_t & inode_id) const;
+
+public:
+    snapshot_view_t(snapshot_ver_t _version, htmpfs_size_t _block_size)
+    : version(std::move(_version)), block_size(_block_size) { }
+
+    /// add an inode to view, only available before view is published
+    void add_inode(inode_id_t inode_id, inode_view_t inode_view);
+
+    /// compile an unsealed view into a sealed one
+    /// @param view unsealed view
+    /// @return new sealed view, owned by caller
+    static snapshot_view_t * seal(const snapshot_view_t & view);
+
+    /// check if view is sealed
+    [[nodiscard]] bool is_sealed() const { return is_sealed_view; }
+
+    /// snapshot version of current view
+    [[nodiscard]] const snapshot_ver_t & get_version() const { return version; }
+
+    /// get attributes of inode, st_size and st_ino are filled
+    [[nodiscard]] struct stat get_stat(inode_id_t inode_id) const;
+
+    /// get data size of inode
+    [[nodiscard]] htmpfs_size_t data_size(inode_id_t inode_id) const;
+
+    /// check if inode is a dentry inode
+    [[nodiscard]] bool is_dentry(inode_id_t inode_id) const;
+
+    /// get inode id by name under parent
+    /// @param parent_inode_id parent inode id
+    /// @param name dentry name
+    /// @return inode id
+    [[nodiscard]] inode_id_t namei(inode_id_t parent_inode_id, std::string_view name) const;
+
+    /// get inode id by path inside of the snapshot volume, i.e., without /.snapshot/$(version)
+    [[nodiscard]] inode_id_t get_inode_id_by_path(std::string_view pathname) const;
+
+    /// get inode id by path inside of the snapshot volume, without throwing for absent names
+    /// @return false if any component of pathname does not exist
+    bool try_get_inode_id_by_path(std::string_view pathname, inode_id_t & inode_id) const;
+
+    /// list all dentries under a directory
+    /// @param inode_id directory inode id
+    /// @param func invoked with (null-terminated name, inode id) for every dentry
+    void readdir(inode_id_t inode_id, const std::function < void (const char *, inode_id_t) > & func) const;
+
+    /// list dentries under a directory, starting after a cookie
+    /// @param inode_id directory inode id
+    /// @param after_cookie cookie of the last dentry already listed, 0 to start from the beginning
+    /// @param func invoked with (null-terminated name, inode id, cookie) for every dentry,
+    ///             listing stops when it returns false
+    void readdir(inode_id_t inode_id, uint64_t after_cookie,
+                 const std::function < bool (const char *, inode_id_t, uint64_t) > & func) const;
+
+    /// read(inode_id, buffer, length, offset)
+    /// @return length of buffer read
+    htmpfs_size_t read(inode_id_t inode_id, char * buffer,
+                       htmpfs_size_t length, htmpfs_size_t offset) const;
+
+    /// apply func to every block referenced by view
+    void for_each_block(const std::function < void (const buffer_result_t &) > & func) const;
+};
+
+/// published snapshot views, replaced as a whole (read-copy-update)
+typedef std::map < snapshot_ver_t, const snapshot_view_t *, std::less < > > snapshot_view_map_t;
+
+/// a pinned snapshot view, readable without locks until destruction
+class snapshot_reader_t
+{
+private:
+    epoch_domain_t::guard_t guard;
+    const snapshot_view_t * view;
+
+public:
+    snapshot_reader_t(epoch_domain_t::guard_t _guard, const snapshot_view_t * _view)
+    : guard(std::move(_guard)), view(_view) { }
+
+    const snapshot_view_t * operator->() const { return view; }
+    const snapshot_view_t & operator*() const { return *view; }
+};
+
+#endif //HTMPFS_SNAPSHOT_VIEW_H
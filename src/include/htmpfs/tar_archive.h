@@ -0,0 +1,84 @@
+#ifndef HTMPFS_TAR_ARCHIVE_H
+#define HTMPFS_TAR_ARCHIVE_H
+
+/** @file
+ *  this file defines tar archive import into and export from a filesystem
+ */
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <mutex>
+#include <htmpfs/htmpfs.h>
+
+/*
+ * Tar Archive
+ *
+ * a tar archive is streamed straight into a filesystem, or a version of a filesystem is streamed
+ * out as tar archive, without going through FUSE.
+ * POSIX ustar and pax archives are read and written, GNU long names and long link names are read as well.
+ * compression is left to external tools piped in and out, e.g., `zstd -dc seed.tar.zst`,
+ * which decompress in a process of their own.
+ *
+ * import queues dentries into namespace batches, so that every directory is saved once per batch
+ * instead of once per dentry. data of small files is held with the batch until it is applied,
+ * large files are written block by block as they are read.
+ * a filesystem shared with other threads is locked only while it is accessed, never while the archive is read,
+ * so an archive fed by a pipe does not hold up other users of the filesystem.
+ * directories, regular files, symbolic links, fifos and device nodes are imported,
+ * other entry types, i.e., hard links, are skipped.
+ * an existing directory is merged, an existing regular file or symbolic link is replaced.
+ * entries escaping the target directory by ".." are skipped.
+ *
+ * an uncompressed archive can also be loaded as base image: it is mapped read-only, and files read
+ * their data from the mapping instead of holding a copy. many filesystems, in one process or in many,
+ * loading the same image share its data through page cache. blocks made from the image are frozen,
+ * a write copies them into private blocks as it does after a snapshot, so a filesystem holds only
+ * the data it changed. dentries and attributes are still made by every filesystem.
+ *
+ * export lists a version in pre-order, directories before their dentries.
+ * sockets cannot be stored in tar archives, and are skipped.
+ * names and link names longer than ustar allows are stored in pax headers.
+ *
+ * */
+
+/// what an import or an export has processed
+struct tar_statistics_t
+{
+    htmpfs_size_t directories = 0;
+    htmpfs_size_t files = 0;
+    htmpfs_size_t symlinks = 0;
+    htmpfs_size_t specials = 0;     /* fifos and device nodes */
+    htmpfs_size_t skipped = 0;      /* entries of unsupported type, i.e., sockets, or escaping the target directory */
+    htmpfs_size_t bytes = 0;        /* file data */
+};
+
+/// import a tar archive under a directory of version 0
+/// @param filesystem filesystem
+/// @param input archive, read up to its end-of-archive marker
+/// @param target_inode_id directory archive is extracted into
+/// @param filesystem_lock held while filesystem is accessed, nullptr if filesystem is not shared.
+///                        an import fails if its target tree is removed meanwhile
+/// @return entries imported
+tar_statistics_t tar_import(inode_smi_t & filesystem, std::istream & input,
+                            inode_id_t target_inode_id = FILESYSTEM_ROOT_INODE_NUMBER,
+                            std::mutex * filesystem_lock = nullptr);
+
+/// load an uncompressed tar archive as base image under a directory of version 0
+/// archive stays mapped until filesystem is destroyed, and must not be modified meanwhile
+/// @param filesystem filesystem
+/// @param image host pathname of archive
+/// @param target_inode_id directory archive is loaded into
+/// @return entries loaded
+tar_statistics_t tar_load_image(inode_smi_t & filesystem, const std::string & image,
+                                inode_id_t target_inode_id = FILESYSTEM_ROOT_INODE_NUMBER);
+
+/// export a version as tar archive
+/// version 0 must not be modified during export, a snapshot volume is read through a pinned view
+/// @param filesystem filesystem
+/// @param version snapshot version, FILESYSTEM_CUR_MODIFIABLE_VER for version 0
+/// @param output archive, end-of-archive marker included
+/// @return entries exported
+tar_statistics_t tar_export(inode_smi_t & filesystem, const snapshot_ver_t & version, std::ostream & output);
+
+#endif //HTMPFS_TAR_ARCHIVE_H
@@ -0,0 +1,129 @@
+#ifndef HTMPFS_TREE_WALKER_H
+#define HTMPFS_TREE_WALKER_H
+
+/** @file
+ *  this file defines full-tree traversal of a version
+ */
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <sys/stat.h>
+#include <htmpfs/htmpfs.h>
+
+/*
+ * Tree Walker
+ *
+ * a walk lists every dentry under a directory in pre-order, a directory before its dentries,
+ * dentries of a directory in directory order. directories are followed by inode id,
+ * no pathname is resolved from root, and pathnames are built in one buffer as the walk goes.
+ *
+ * a cursor keeps one (directory, readdir cookie) pair per level instead of a stack of pending dentries,
+ * so its memory is bound by depth, not by width of directories, and a walk can be suspended between
+ * two dentries. version 0 must not be changed while walked, a snapshot volume is walked
+ * through a pinned view.
+ *
+ * parallel walk hands subtrees out to worker threads: a worker walking a subtree gives
+ * a subdirectory away instead of descending into it whenever another worker is idle.
+ * every subtree is listed in pre-order by one worker, order across workers is not kept.
+ * directories of version 0 are parsed and cached on access, which is not safe across threads,
+ * so version 0 is always walked on calling thread.
+ *
+ * */
+
+/// one dentry met by a walk
+struct tree_entry_t
+{
+    std::string_view pathname;      /* i.e., "/usr/bin", valid until the walk moves on */
+    inode_id_t inode_id;
+    struct stat attributes;         /* st_ino and st_size filled */
+    htmpfs_size_t depth;            /* 1 for dentries of the directory walked */
+    bool is_dentry;
+};
+
+/// what a walk does after visiting a dentry
+enum tree_walk_action_t : uint8_t
+{
+    TREE_WALK_CONTINUE,
+    TREE_WALK_SKIP_SUBTREE,         /* dentries under a directory are not listed */
+    TREE_WALK_STOP,
+};
+
+class tree_cursor_t
+{
+private:
+    /// a directory being listed
+    struct level_t
+    {
+        inode_id_t directory;
+        uint64_t cookie;                /* cookie of last dentry listed, 0 for none */
+        htmpfs_size_t pathname_length;  /* length of pathname of directory */
+    };
+
+    inode_smi_t * filesystem = nullptr;
+
+    /// view walked, nullptr for version 0
+    const snapshot_view_t * view = nullptr;
+
+    /// pinned by cursor itself, if constructed by version
+    std::unique_ptr < snapshot_reader_t > pinned;
+
+    std::vector < level_t > levels;
+    std::string pathname;
+
+    /// directory returned last, descended into by next() unless skipped
+    bool descend = false;
+    inode_id_t last_inode_id = 0;
+
+    /// get first dentry after cookie
+    /// @return false if directory has no more dentry
+    bool next_dentry(level_t & level, std::string & name, inode_id_t & inode_id);
+
+    /// fill entry by inode
+    void fill(tree_entry_t & entry, inode_id_t inode_id);
+
+public:
+    /// walk a version
+    /// @param _filesystem filesystem
+    /// @param version snapshot version, FILESYSTEM_CUR_MODIFIABLE_VER for version 0
+    /// @param root directory walked
+    /// @param root_pathname pathname of root, prefixed to every pathname listed
+    tree_cursor_t(inode_smi_t & _filesystem, const snapshot_ver_t & version,
+                  inode_id_t root = FILESYSTEM_ROOT_INODE_NUMBER, std::string root_pathname = "");
+
+    /// walk a pinned view, view must stay pinned while cursor is in use
+    explicit tree_cursor_t(const snapshot_view_t & _view,
+                           inode_id_t root = FILESYSTEM_ROOT_INODE_NUMBER, std::string root_pathname = "");
+
+    /// move to next dentry in pre-order
+    /// @param entry set to next dentry, valid until next call
+    /// @return false if walk is done
+    bool next(tree_entry_t & entry);
+
+    /// do not descend into directory returned last
+    void skip_subtree() { descend = false; }
+};
+
+/// walk a version on calling thread
+/// @param filesystem filesystem
+/// @param version snapshot version, FILESYSTEM_CUR_MODIFIABLE_VER for version 0
+/// @param func invoked with every dentry in pre-order
+/// @param root directory walked
+void walk_tree(inode_smi_t & filesystem, const snapshot_ver_t & version,
+               const std::function < tree_walk_action_t (const tree_entry_t &) > & func,
+               inode_id_t root = FILESYSTEM_ROOT_INODE_NUMBER);
+
+/// walk a version with worker threads
+/// @param filesystem filesystem
+/// @param version snapshot version, version 0 is walked on calling thread
+/// @param threads worker threads
+/// @param func invoked with every dentry, concurrently from workers, pre-order is kept inside of subtrees.
+///             an exception thrown by func stops the walk and is thrown again once workers are done
+/// @param root directory walked
+void walk_tree_parallel(inode_smi_t & filesystem, const snapshot_ver_t & version, unsigned int threads,
+                        const std::function < tree_walk_action_t (const tree_entry_t &) > & func,
+                        inode_id_t root = FILESYSTEM_ROOT_INODE_NUMBER);
+
+#endif //HTMPFS_TREE_WALKER_H
@@ -43,6 +43,14 @@ _ADD_ERROR_INFORMATION_(HTMPFS_CANNOT_OPEN_DEVICE,      0xA0000017,     "Cannot
 _ADD_ERROR_INFORMATION_(HTMPFS_CANNOT_LSEEK_DEVICE,     0xA0000018,     "Cannot lseek device",          1)
 _ADD_ERROR_INFORMATION_(HTMPFS_MEET_DEVICE_BOUNDARY,    0xA0000019,     "Meet device boundary",         1)
 _ADD_ERROR_INFORMATION_(HTMPFS_BLOCK_SHORT_OPS,         0xA000001A,     "Block short I/O operation",    1)
+_ADD_ERROR_INFORMATION_(HTMPFS_JOURNAL_CURSOR_EXPIRED,  0xA000001B,     "Journal cursor expired",       ESTALE)
+_ADD_ERROR_INFORMATION_(HTMPFS_NAME_TOO_LONG,           0xA000001C,     "Dentry name too long",         ENAMETOOLONG)
+_ADD_ERROR_INFORMATION_(HTMPFS_IS_A_DIRECTORY,          0xA000001D,     "Inode is a directory",         EISDIR)
+_ADD_ERROR_INFORMATION_(HTMPFS_INVALID_RENAME_FLAGS,    0xA000001E,     "Invalid rename flags",         EINVAL)
+_ADD_ERROR_INFORMATION_(HTMPFS_INVALID_BATCH_OPERATION, 0xA000001F,     "Invalid batch operation",      EINVAL)
+_ADD_ERROR_INFORMATION_(HTMPFS_MALFORMED_ARCHIVE,       0xA0000020,     "Malformed archive",            EINVAL)
+_ADD_ERROR_INFORMATION_(HTMPFS_LOWER_LAYER_ERROR,       0xA0000021,     "Lower layer I/O error",        EIO)
+_ADD_ERROR_INFORMATION_(HTMPFS_CANNOT_MAP_FILE,         0xA0000022,     "Cannot map host file",         EIO)
 
 /// Filesystem Error Type
 class HTMPFS_error_t : public std::exception
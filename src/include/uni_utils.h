@@ -11,6 +11,7 @@
 #include <ctime>
 #include <htmpfs/htmpfs_types.h>
 #include <string>
+#include <string_view>
 
 /// get current time
 timespec get_current_time();
@@ -18,4 +19,11 @@ std::string make_path_with_version(const std::string& path, const snapshot_ver_t
 // check is given path starts with /.snapshot/$(version)/
 snapshot_ver_t if_snapshot(const std::string & path, std::string & output);
 
+/// check if given path starts with /.snapshot/$(version), without any allocation
+/// @param path pathname
+/// @param version snapshot version, view into path, set only for snapshot paths
+/// @param output pathname inside of snapshot volume, view into path. path itself for non-snapshot paths
+/// @return true if path is inside of a snapshot volume, throw HTMPFS_INVALID_DENTRY_NAME if no version is given
+bool parse_snapshot_prefix(std::string_view path, std::string_view & version, std::string_view & output);
+
 #endif //HTMPFS_UNI_UTILS_H
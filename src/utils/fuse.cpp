@@ -8,10 +8,56 @@
 #include <unistd.h>
 #include <sys/param.h>
 #include <uni_utils.h>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <htmpfs/tar_archive.h>
 
 #define SNAPSHOT_ENTRY ".snapshot"
+
+/// readdir offsets, dentry cookies are shifted past the fixed entries
+#define READDIR_COOKIE_DOT          1
+#define READDIR_COOKIE_DOTDOT       2
+#define READDIR_COOKIE_SNAPSHOT     3
+#define READDIR_COOKIE_DENTRY_BASE  3
+
+#define CONTROL_ENTRY ".control"
+#define CONTROL_JOURNAL_ENTRY "journal"
+#define CONTROL_REMOVE_TREE_ENTRY "remove_tree"
+#define CONTROL_RECLAIM_ENTRY "reclaim"
+#define CONTROL_IMPORT_ENTRY "import"
+#define CONTROL_EXPORT_ENTRY "export"
+
+/// maximum change journal entries returned by one journal control file
+#define CONTROL_JOURNAL_MAX_ENTRIES 4096
 SmartPtr < inode_smi_t > filesystem_inode_smi;
 
+/// serializes operations on version 0, snapshot volumes are read through pinned views without it
+std::mutex filesystem_lock;
+
+#define LOCK_FILESYSTEM std::lock_guard < std::mutex > __filesystem_guard(filesystem_lock)
+
+/// background COW break bandwidth, in bytes per second. 0 disables background COW break
+htmpfs_size_t cow_break_bandwidth = 0;
+
+/// background COW break interval
+#define COW_BREAK_INTERVAL_MS 10
+
+static std::thread cow_break_thread;
+static std::atomic < bool > cow_break_stop { false };
+
+/// background block reclamation rate, in blocks per second. 0 unlinks blocks inline
+htmpfs_size_t reclaim_rate = 0;
+
+/// background block reclamation interval
+#define RECLAIM_INTERVAL_MS 10
+
+static std::thread reclaim_thread;
+static std::atomic < bool > reclaim_stop { false };
+
 #define CATCH_TAIL                                                                              \
 catch (HTMPFS_error_t & error)                                                                  \
 {                                                                                               \
@@ -26,18 +72,424 @@ catch (std::exception & error)
 
 #define CHECK_RDONLY_FS(path)                                           \
 {                                                                       \
-    std::string parsed_path;                                            \
-    snapshot_ver_t version = if_snapshot(path, parsed_path);            \
-    if (version != FILESYSTEM_CUR_MODIFIABLE_VER)                       \
+    std::string_view version, parsed_path;                              \
+    if (parse_snapshot_prefix(path, version, parsed_path))              \
     {                                                                   \
         return -EROFS;                                                  \
     }                                                                   \
 } __asm__("nop")
 
+/*
+ * Control directory
+ *
+ * /.control is a hidden virtual directory exposing filesystem internals.
+ * it is not listed in filesystem root.
+ *
+ *  /.control/journal/<cursor>      change journal entries after <cursor>, one per line:
+ *                                  <sequence> <operation> <inode> <parent> <source parent> <offset> <length>
+ *                                  parents without a dentry change are shown as "-".
+ *                                  consumers resume from the last sequence number read.
+ *                                  reading an expired cursor fails with ESTALE.
+ *
+ *  /.control/remove_tree           write-only. writing a pathname, e.g. `echo /workspace > /.control/remove_tree`,
+ *                                  removes it with everything under it, like `rm -rf`, in one request.
+ *                                  one pathname per write, a trailing newline is ignored.
+ *
+ *  /.control/import                write-only. writing a host archive pathname, optionally followed by a line
+ *                                  with a directory, e.g. `printf '/srv/seed.tar\n/opt' > /.control/import`,
+ *                                  extracts the tar archive into the directory, root by default.
+ *                                  compressed archives are to be decompressed first, e.g. by a pipe into a fifo.
+ *
+ *  /.control/export                write-only. writing a host archive pathname, optionally followed by a line
+ *                                  with a snapshot version, writes the version as tar archive, version 0 by default.
+ *                                  version 0 is written from a temporary snapshot volume `.export.<n>`,
+ *                                  seen under /.snapshot until export is done.
+ *                                  import and export read and write host files as mount owner,
+ *                                  so that only mount owner and root may use them. neither holds the filesystem
+ *                                  while host files are read or written, so the archive can be a fifo
+ *                                  fed or drained through the same mount.
+ *
+ *  /.control/reclaim               blocks of unlinked and truncated files waiting for background reclamation,
+ *                                  and blocks reclaimed so far, as "pending <n>" and "reclaimed <n>" lines.
+ *                                  both stay 0 unless mounted with -o reclaim=BLOCKS.
+ *                                  "retired <n>" counts snapshot views deleted or sealed while still read,
+ *                                  held with their frozen blocks until readers leave, whatever -o reclaim is.
+ *
+ * */
+
+/// check if path is under control directory
+/// @param path pathname
+/// @param control_path pathname inside control directory, i.e., "/" for /.control
+static bool if_control(const char * path, std::string & control_path)
+{
+    const char * prefix = "/" CONTROL_ENTRY;
+    const htmpfs_size_t prefix_length = strlen(prefix);
+
+    if (strncmp(path, prefix, prefix_length) != 0
+        || (path[prefix_length] != '/' && path[prefix_length] != 0))
+    {
+        return false;
+    }
+
+    control_path = path[prefix_length] == 0 ? "/" : path + prefix_length;
+    return true;
+}
+
+/// parse journal cursor from control path
+/// @return true if control path is a journal control file
+static bool if_control_journal(const std::string & control_path, uint64_t & cursor)
+{
+    path_t vpath(control_path);
+    if (vpath.size() != 3 || *(vpath.begin() + 1) != CONTROL_JOURNAL_ENTRY)
+    {
+        return false;
+    }
+
+    const auto & cursor_text = *vpath.last();
+    if (cursor_text.empty() || cursor_text.find_first_not_of("0123456789") != std::string::npos)
+    {
+        THROW_HTMPFS_ERROR_STDERR(HTMPFS_NO_SUCH_FILE_OR_DIR);
+    }
+
+    cursor = std::stoull(cursor_text);
+    return true;
+}
+
+/// render change journal after cursor
+static std::string render_change_journal(uint64_t cursor)
+{
+    std::stringstream output;
+    auto parent_to_string = [](inode_id_t parent)->std::string
+    {
+        return parent == change_journal_t::no_parent ? "-" : std::to_string(parent);
+    };
+
+    for (const auto & i : filesystem_inode_smi->read_change_journal(cursor, CONTROL_JOURNAL_MAX_ENTRIES))
+    {
+        output  << i.sequence << " "
+                << change_journal_t::operation_name(i.operation) << " "
+                << i.inode_id << " "
+                << parent_to_string(i.parent_inode_id) << " "
+                << parent_to_string(i.source_parent_inode_id) << " "
+                << i.offset << " "
+                << i.length << "\n";
+    }
+
+    return output.str();
+}
+
+/// check if control file accepts writes
+static bool if_control_writable(const std::string & control_path)
+{
+    return control_path == "/" CONTROL_REMOVE_TREE_ENTRY
+           || control_path == "/" CONTROL_IMPORT_ENTRY
+           || control_path == "/" CONTROL_EXPORT_ENTRY;
+}
+
+static int control_getattr(const std::string & control_path, struct stat *stbuf)
+{
+    uint64_t cursor;
+    *stbuf = { };
+    stbuf->st_ctim  = get_current_time();
+    stbuf->st_atim  = get_current_time();
+    stbuf->st_mtim  = get_current_time();
+    stbuf->st_gid   = getgid();
+    stbuf->st_uid   = getuid();
+    stbuf->st_nlink = 1;
+
+    if (control_path == "/" || control_path == "/" CONTROL_JOURNAL_ENTRY)
+    {
+        stbuf->st_mode  = S_IFDIR | 0555;
+        return 0;
+    }
+
+    if (if_control_journal(control_path, cursor))
+    {
+        // size is unknown until read, control files are opened with direct_io
+        stbuf->st_mode  = S_IFREG | 0444;
+        stbuf->st_size  = 0;
+        return 0;
+    }
+
+    if (if_control_writable(control_path))
+    {
+        stbuf->st_mode  = S_IFREG | 0200;
+        stbuf->st_size  = 0;
+        return 0;
+    }
+
+    if (control_path == "/" CONTROL_RECLAIM_ENTRY)
+    {
+        stbuf->st_mode  = S_IFREG | 0444;
+        stbuf->st_size  = 0;
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+static int control_readdir(const std::string & control_path, void *buffer, fuse_fill_dir_t filler)
+{
+    if (control_path == "/")
+    {
+        filler(buffer, CONTROL_JOURNAL_ENTRY, nullptr, 0);
+        filler(buffer, CONTROL_REMOVE_TREE_ENTRY, nullptr, 0);
+        filler(buffer, CONTROL_RECLAIM_ENTRY, nullptr, 0);
+        filler(buffer, CONTROL_IMPORT_ENTRY, nullptr, 0);
+        filler(buffer, CONTROL_EXPORT_ENTRY, nullptr, 0);
+        return 0;
+    }
+
+    // journal cursors are not listed
+    if (control_path == "/" CONTROL_JOURNAL_ENTRY)
+    {
+        return 0;
+    }
+
+    return -ENOTDIR;
+}
+
+static int control_read(const std::string & control_path, char *buffer, size_t size, off_t offset)
+{
+    uint64_t cursor;
+    std::string content;
+    if (control_path == "/" CONTROL_RECLAIM_ENTRY)
+    {
+        LOCK_FILESYSTEM;
+        content = "pending " + std::to_string(filesystem_inode_smi->reclaim_pending()) + "\n"
+                + "reclaimed " + std::to_string(filesystem_inode_smi->reclaimed_blocks()) + "\n"
+                + "retired " + std::to_string(filesystem_inode_smi->retired_pending()) + "\n";
+    }
+    else if (if_control_journal(control_path, cursor))
+    {
+        LOCK_FILESYSTEM;
+        content = render_change_journal(cursor);
+    }
+    else
+    {
+        return -EISDIR;
+    }
+
+    if ((htmpfs_size_t)offset >= content.length())
+    {
+        return 0;
+    }
+
+    size_t read_size = MIN(size, content.length() - offset);
+    memcpy(buffer, content.c_str() + offset, read_size);
+    return (int)read_size;
+}
+
+/// check if pathname is under a snapshot volume or the control directory, which cannot be modified
+static bool if_read_only_pathname(const std::string & pathname)
+{
+    std::string control_prefix = "/" CONTROL_ENTRY;
+    std::string_view version, parsed_path;
+    return parse_snapshot_prefix(pathname, version, parsed_path)
+           || pathname == control_prefix || !pathname.compare(0, control_prefix.length() + 1, control_prefix + "/");
+}
+
+/// check if caller may have host files read or written on its behalf, i.e., is mount owner or root
+static bool if_host_access_allowed()
+{
+    auto uid = fuse_get_context()->uid;
+    return uid == getuid() || uid == 0;
+}
+
+/// split control request into lines, trailing '/' and empty lines are dropped
+static std::vector < std::string > control_request_lines(const char * buffer, size_t size)
+{
+    std::vector < std::string > lines;
+    std::istringstream request(std::string(buffer, size));
+    std::string line;
+    while (std::getline(request, line))
+    {
+        while (line.length() > 1 && line.back() == '/')
+        {
+            line.pop_back();
+        }
+
+        if (!line.empty())
+        {
+            lines.emplace_back(line);
+        }
+    }
+
+    return lines;
+}
+
+/// remove_tree request: "<pathname>"
+static int control_remove_tree(const std::vector < std::string > & request)
+{
+    if (request.size() != 1 || request[0].front() != '/' || request[0] == "/")
+    {
+        return -EINVAL;
+    }
+
+    if (if_read_only_pathname(request[0]))
+    {
+        return -EROFS;
+    }
+
+    path_t vpath(request[0]);
+    auto target_name = vpath.pop_end();
+
+    LOCK_FILESYSTEM;
+    auto parent_id = filesystem_inode_smi->get_inode_id_by_path(vpath.to_string());
+    filesystem_inode_smi->remove_tree(parent_id, target_name);
+    return 0;
+}
+
+/// import request: "<host archive>[\n<directory>]", directory defaults to root
+static int control_import(const std::vector < std::string > & request)
+{
+    if (request.empty() || request.size() > 2 || request[0].front() != '/'
+        || (request.size() == 2 && request[1].front() != '/'))
+    {
+        return -EINVAL;
+    }
+
+    std::string target = request.size() == 2 ? request[1] : "/";
+    if (if_read_only_pathname(target))
+    {
+        return -EROFS;
+    }
+
+    if (!if_host_access_allowed())
+    {
+        return -EACCES;
+    }
+
+    std::ifstream archive(request[0], std::ios::binary);
+    if (!archive)
+    {
+        return errno ? -errno : -ENOENT;
+    }
+
+    inode_id_t target_id;
+    {
+        LOCK_FILESYSTEM;
+        target_id = filesystem_inode_smi->get_inode_id_by_path(target);
+    }
+
+    // archive can be a fifo fed through this filesystem, it is read without holding the lock
+    tar_import(*filesystem_inode_smi, archive, target_id, &filesystem_lock);
+    return 0;
+}
+
+/// make a temporary snapshot volume of version 0, named after a counter
+/// @return snapshot version
+static snapshot_ver_t make_export_snapshot()
+{
+    static uint64_t export_snapshot_count = 0;
+
+    LOCK_FILESYSTEM;
+    while (true)
+    {
+        snapshot_ver_t version = ".export." + std::to_string(export_snapshot_count++);
+        try
+        {
+            filesystem_inode_smi->create_snapshot_volume(version);
+            return version;
+        }
+        catch (HTMPFS_error_t & error)
+        {
+            // name taken by a snapshot volume of user
+            if (error.my_errcode() != HTMPFS_DOUBLE_SNAPSHOT)
+            {
+                throw;
+            }
+        }
+    }
+}
+
+/// export request: "<host archive>[\n<snapshot version>]", version defaults to version 0
+static int control_export(const std::vector < std::string > & request)
+{
+    if (request.empty() || request.size() > 2 || request[0].front() != '/')
+    {
+        return -EINVAL;
+    }
+
+    if (!if_host_access_allowed())
+    {
+        return -EACCES;
+    }
+
+    std::ofstream archive(request[0], std::ios::binary | std::ios::trunc);
+    if (!archive)
+    {
+        return errno ? -errno : -EACCES;
+    }
+
+    // snapshot volumes are exported through a pinned view, without blocking version 0
+    if (request.size() == 2 && request[1] != FILESYSTEM_CUR_MODIFIABLE_VER)
+    {
+        tar_export(*filesystem_inode_smi, request[1], archive);
+    }
+    else
+    {
+        // version 0 is frozen by a temporary snapshot volume, so that archive is written without the lock.
+        // archive can be a fifo drained through this filesystem
+        auto version = make_export_snapshot();
+        auto delete_snapshot = [&]()
+        {
+            LOCK_FILESYSTEM;
+            filesystem_inode_smi->delete_snapshot_volume(version);
+        };
+
+        try
+        {
+            tar_export(*filesystem_inode_smi, version, archive);
+        }
+        catch (...)
+        {
+            delete_snapshot();
+            throw;
+        }
+
+        delete_snapshot();
+    }
+
+    archive.flush();
+    return archive ? 0 : -EIO;
+}
+
+static int control_write(const std::string & control_path, const char * buffer, size_t size)
+{
+    if (!if_control_writable(control_path))
+    {
+        return -EACCES;
+    }
+
+    auto request = control_request_lines(buffer, size);
+    int ret;
+    if (control_path == "/" CONTROL_IMPORT_ENTRY)
+    {
+        ret = control_import(request);
+    }
+    else if (control_path == "/" CONTROL_EXPORT_ENTRY)
+    {
+        ret = control_export(request);
+    }
+    else
+    {
+        ret = control_remove_tree(request);
+    }
+
+    return ret < 0 ? ret : (int)size;
+}
+
 int do_getattr (const char *path, struct stat *stbuf)
 {
     try
     {
+        std::string control_path;
+        if (if_control(path, control_path))
+        {
+            return control_getattr(control_path, stbuf);
+        }
+
         if (!strcmp("/" SNAPSHOT_ENTRY , path)) // non-existing directory
         {
             stbuf->st_ctim  = get_current_time();
@@ -52,13 +504,31 @@ int do_getattr (const char *path, struct stat *stbuf)
             return 0;
         }
 
-        std::string parsed_path;
-        snapshot_ver_t version = if_snapshot(path, parsed_path);
-        auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
+        std::string_view version, parsed_path;
+        if (parse_snapshot_prefix(path, version, parsed_path))
+        {
+            inode_id_t inode_id;
+            auto view = filesystem_inode_smi->pin_snapshot_volume(version);
+            if (!view->try_get_inode_id_by_path(parsed_path, inode_id))
+            {
+                return -ENOENT;
+            }
+
+            *stbuf = view->get_stat(inode_id);
+            return 0;
+        }
+
+        LOCK_FILESYSTEM;
+        inode_id_t inode_id;
+        if (!filesystem_inode_smi->try_get_inode_id_by_path(path, inode_id))
+        {
+            return -ENOENT;
+        }
+
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
 
-        *stbuf = inode->fs_stat;
-        stbuf->st_size = (off_t)inode->current_data_size(version);
+        *stbuf = inode->fs_stat.to_stat();
+        stbuf->st_size = (off_t)inode->current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER);
         stbuf->st_nlink = filesystem_inode_smi->count_link_for_inode(inode_id);
         stbuf->st_ino = inode_id;
         return 0;
@@ -69,21 +539,25 @@ int do_getattr (const char *path, struct stat *stbuf)
 int do_readdir (const char *path,
                 void *buffer,
                 fuse_fill_dir_t filler,
-                off_t,
+                off_t offset,
                 struct fuse_file_info *)
 {
     try
     {
-        filler(buffer, ".", nullptr, 0);  // Current Directory
-        filler(buffer, "..", nullptr, 0); // Parent Directory
-
-        if (!strcmp("/", path))
+        std::string control_path;
+        if (if_control(path, control_path))
         {
-            filler(buffer, SNAPSHOT_ENTRY, nullptr, 0); // .snapshot volume
+            filler(buffer, ".", nullptr, 0);  // Current Directory
+            filler(buffer, "..", nullptr, 0); // Parent Directory
+            return control_readdir(control_path, buffer, filler);
         }
 
         if (!strcmp("/" SNAPSHOT_ENTRY, path)) // non-existing directory
         {
+            filler(buffer, ".", nullptr, 0);  // Current Directory
+            filler(buffer, "..", nullptr, 0); // Parent Directory
+
+            LOCK_FILESYSTEM;
             for (const auto& i : filesystem_inode_smi->_snapshot_version_list)
             {
                 filler(buffer, i.first.c_str(), nullptr, 0);
@@ -92,17 +566,48 @@ int do_readdir (const char *path,
             return 0;
         }
 
-        std::string parsed_path;
-        snapshot_ver_t version = if_snapshot(path, parsed_path);
+        // offset of every entry is the cookie of the next one, listing stops once buffer is full
+        // dentries follow ".", ".." and ".snapshot" in root
+        auto fill = [&](const char * name, uint64_t cookie)->bool
+        {
+            return (uint64_t)offset >= cookie || filler(buffer, name, nullptr, (off_t)cookie) == 0;
+        };
+
+        if (!fill(".", READDIR_COOKIE_DOT) || !fill("..", READDIR_COOKIE_DOTDOT))
+        {
+            return 0;
+        }
+
+        if (!strcmp("/", path) && !fill(SNAPSHOT_ENTRY, READDIR_COOKIE_SNAPSHOT))
+        {
+            return 0;
+        }
+
+        uint64_t after_cookie = (uint64_t)offset > READDIR_COOKIE_DENTRY_BASE
+                                ? (uint64_t)offset - READDIR_COOKIE_DENTRY_BASE : 0;
+
+        std::string_view version, parsed_path;
+        if (parse_snapshot_prefix(path, version, parsed_path))
+        {
+            auto view = filesystem_inode_smi->pin_snapshot_volume(version);
+            view->readdir(view->get_inode_id_by_path(parsed_path), after_cookie,
+                          [&](const char * name, inode_id_t, uint64_t cookie)
+            {
+                return fill(name, READDIR_COOKIE_DENTRY_BASE + cookie);
+            });
+
+            return 0;
+        }
+
+        LOCK_FILESYSTEM;
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
-        directory_resolver_t directoryResolver(inode, version);
+        directory_resolver_t directoryResolver(inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
-        auto dentry_list = directoryResolver.to_vector();
-        for (const auto &i: dentry_list)
+        directoryResolver.readdir(after_cookie, [&](const char * name, uint64_t, uint64_t cookie)
         {
-            filler(buffer, i.pathname.c_str(), nullptr, 0);
-        }
+            return fill(name, READDIR_COOKIE_DENTRY_BASE + cookie);
+        });
 
         return 0;
     }
@@ -121,6 +626,8 @@ int do_mkdir (const char * path, mode_t mode)
             THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
         }
 
+        LOCK_FILESYSTEM;
+
         // now, determine if creating snapshot volume or normal directory
         if (vpath.size() == 2 /* {"", ".snapshot"} */ &&
             vpath.last()->length() == strlen(SNAPSHOT_ENTRY) &&
@@ -130,6 +637,9 @@ int do_mkdir (const char * path, mode_t mode)
         {
             // it's a snapshot creation
             filesystem_inode_smi->create_snapshot_volume(target_name);
+
+            // snapshot volumes are never modified, serve them from the compact layout
+            filesystem_inode_smi->seal_snapshot_volume(target_name);
         }
         else
         {
@@ -143,7 +653,6 @@ int do_mkdir (const char * path, mode_t mode)
             child_inode->fs_stat.st_ctim = get_current_time();
             child_inode->fs_stat.st_atim = get_current_time();
             child_inode->fs_stat.st_mtim = get_current_time();
-            child_inode->fs_stat.st_ino = FILESYSTEM_ROOT_INODE_NUMBER;
             child_inode->fs_stat.st_mode = mode | S_IFDIR;
             child_inode->fs_stat.st_nlink = 1;
             child_inode->fs_stat.st_size = 0;
@@ -159,11 +668,13 @@ int do_chmod (const char * path, mode_t mode)
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
         inode->fs_stat.st_mode = mode;
         inode->fs_stat.st_ctim = get_current_time();
+        filesystem_inode_smi->record_change(change_journal_t::JOURNAL_SETATTR, inode_id);
 
         return 0;
     }
@@ -175,12 +686,14 @@ int do_chown (const char * path, uid_t uid, gid_t gid)
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
         inode->fs_stat.st_uid = uid;
         inode->fs_stat.st_gid = gid;
         inode->fs_stat.st_ctim = get_current_time();
+        filesystem_inode_smi->record_change(change_journal_t::JOURNAL_SETATTR, inode_id);
 
         return 0;
     }
@@ -192,6 +705,7 @@ int do_create (const char * path, mode_t mode, struct fuse_file_info *)
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         path_t vpath(path);
         auto target_name = vpath.pop_end();
@@ -239,8 +753,44 @@ int do_access (const char * path, int mode)
             return 0;
         }
 
-        auto inode = filesystem_inode_smi->get_inode_by_id(
-                filesystem_inode_smi->get_inode_id_by_path(path));
+        std::string control_path;
+        if (if_control(path, control_path))
+        {
+            struct stat stbuf { };
+            int ret = control_getattr(control_path, &stbuf);
+            if (ret != 0)
+            {
+                return ret;
+            }
+
+            // write-only control files take no read access, and the others take no write access
+            bool writable = if_control_writable(control_path);
+            return ((mode & W_OK) && !writable) || ((mode & (R_OK | X_OK)) && writable) ? -EACCES : 0;
+        }
+
+        mode_t st_mode;
+        inode_id_t inode_id;
+        std::string_view version, parsed_path;
+        if (parse_snapshot_prefix(path, version, parsed_path))
+        {
+            auto view = filesystem_inode_smi->pin_snapshot_volume(version);
+            if (!view->try_get_inode_id_by_path(parsed_path, inode_id))
+            {
+                return -ENOENT;
+            }
+
+            st_mode = view->get_stat(inode_id).st_mode;
+        }
+        else
+        {
+            LOCK_FILESYSTEM;
+            if (!filesystem_inode_smi->try_get_inode_id_by_path(path, inode_id))
+            {
+                return -ENOENT;
+            }
+
+            st_mode = filesystem_inode_smi->get_inode_by_id(inode_id)->fs_stat.st_mode;
+        }
 
         if (mode == F_OK)
         {
@@ -250,7 +800,7 @@ int do_access (const char * path, int mode)
         mode <<= 6;
         mode &= 0x01C0;
 
-        return -!(mode & inode->fs_stat.st_mode);
+        return -!(mode & st_mode);
     }
     CATCH_TAIL;
 }
@@ -264,8 +814,32 @@ int do_open (const char * path, struct fuse_file_info * info)
             return 0;
         }
 
-        filesystem_inode_smi->get_inode_id_by_path(path);
-        return 0;
+        std::string control_path;
+        if (if_control(path, control_path))
+        {
+            struct stat stbuf { };
+            int ret = control_getattr(control_path, &stbuf);
+            if (ret == 0 && ((info->flags & O_ACCMODE) == O_WRONLY) != if_control_writable(control_path))
+            {
+                return -EACCES;
+            }
+
+            // content is generated on every read
+            info->direct_io = 1;
+            return ret;
+        }
+
+        std::string_view version, parsed_path;
+        if (parse_snapshot_prefix(path, version, parsed_path))
+        {
+            inode_id_t inode_id;
+            auto view = filesystem_inode_smi->pin_snapshot_volume(version);
+            return view->try_get_inode_id_by_path(parsed_path, inode_id) ? 0 : -ENOENT;
+        }
+
+        LOCK_FILESYSTEM;
+        inode_id_t inode_id;
+        return filesystem_inode_smi->try_get_inode_id_by_path(path, inode_id) ? 0 : -ENOENT;
     }
     CATCH_TAIL;
 }
@@ -275,12 +849,24 @@ int do_read (const char *path, char *buffer, size_t size, off_t offset,
 {
     try
     {
-        std::string parsed_path;
-        snapshot_ver_t version = if_snapshot(path, parsed_path);
+        std::string control_path;
+        if (if_control(path, control_path))
+        {
+            return control_read(control_path, buffer, size, offset);
+        }
+
+        std::string_view version, parsed_path;
+        if (parse_snapshot_prefix(path, version, parsed_path))
+        {
+            auto view = filesystem_inode_smi->pin_snapshot_volume(version);
+            return (int)view->read(view->get_inode_id_by_path(parsed_path), buffer, size, offset);
+        }
+
+        LOCK_FILESYSTEM;
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
         inode->fs_stat.st_atim = get_current_time();
-        return (int)inode->read(version, buffer, size, offset);
+        return (int)inode->read(FILESYSTEM_CUR_MODIFIABLE_VER, buffer, size, offset);
     }
     CATCH_TAIL;
 }
@@ -290,7 +876,14 @@ int do_write (const char * path, const char * buffer, size_t size, off_t offset,
 {
     try
     {
+        std::string control_path;
+        if (if_control(path, control_path))
+        {
+            return control_write(control_path, buffer, size);
+        }
+
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
@@ -312,12 +905,14 @@ int do_utimens (const char * path, const struct timespec tv[2])
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
 
         inode->fs_stat.st_atim = tv[0];
         inode->fs_stat.st_mtim = tv[1];
+        filesystem_inode_smi->record_change(change_journal_t::JOURNAL_SETATTR, inode_id);
 
         return 0;
     }
@@ -329,6 +924,7 @@ int do_unlink (const char * path)
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         filesystem_inode_smi->remove_inode_by_path(path);
 
@@ -354,6 +950,8 @@ int do_rmdir (const char * path)
             return -EROFS;
         }
 
+        LOCK_FILESYSTEM;
+
         // now, determine if creating snapshot volume or normal directory
         if (vpath.size() == 2 /* {"", ".snapshot"} */ &&
             vpath.last()->length() == strlen(SNAPSHOT_ENTRY) &&
@@ -394,7 +992,15 @@ int do_truncate (const char * path, off_t size)
 {
     try
     {
+        // control files hold no data, truncation by O_TRUNC is accepted
+        std::string control_path;
+        if (if_control(path, control_path))
+        {
+            return if_control_writable(control_path) ? 0 : -EACCES;
+        }
+
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         inode_t * inode;
 
@@ -453,6 +1059,7 @@ int do_symlink  (const char * path, const char * target)
     {
         CHECK_RDONLY_FS(path);
         CHECK_RDONLY_FS(target);
+        LOCK_FILESYSTEM;
 
         path_t vpath(target);
         auto target_name = vpath.pop_end();
@@ -489,67 +1096,29 @@ int do_rename (const char * path, const char * name)
     {
         CHECK_RDONLY_FS(path);
         CHECK_RDONLY_FS(name);
+        LOCK_FILESYSTEM;
 
-        auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
-
-        // get target name/path
+        // get original name/path
         path_t original(path);
         auto original_name = original.pop_end();
         if (original.size() == 0) {
             THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
         }
 
-        // get original name/path
+        // get target name/path
         path_t target(name);
         auto target_name = target.pop_end();
         if (target.size() == 0) {
             THROW_HTMPFS_ERROR_STDERR(HTMPFS_INVALID_DENTRY_NAME);
         }
 
-        // first, create new dentry in new inode parent
-        auto target_parent_inode_id = filesystem_inode_smi->get_inode_id_by_path(target.to_string());
-        auto target_parent_inode = filesystem_inode_smi->get_inode_by_id(target_parent_inode_id);
-        directory_resolver_t tag_directoryResolver(target_parent_inode,
-                                                   FILESYSTEM_CUR_MODIFIABLE_VER);
-        try {
-#ifdef CMAKE_BUILD_DEBUG
-            __disable_output = true;
-#endif // CMAKE_BUILD_DEBUG
-            tag_directoryResolver.add_path(target_name, inode_id);
-            tag_directoryResolver.save_current();
-        } catch (HTMPFS_error_t & error) {
-#ifdef CMAKE_BUILD_DEBUG
-            __disable_output = false;
-#endif // CMAKE_BUILD_DEBUG
-            // allow re-link inode in filesystem
-
-            // if other error occurred, throw
-            if (error.my_errcode() != HTMPFS_DOUBLE_MKPATHNAME) {
-                throw;
-            }
-
-            // if dentry, remove current dentry
-            filesystem_inode_smi->remove_child_dentry_under_parent(target_parent_inode_id,
-                                                                   target_name);
-            // reload dentry list
-            tag_directoryResolver.refresh();
-            tag_directoryResolver.add_path(target_name, inode_id);
-            tag_directoryResolver.save_current();
-        }
-
-#ifdef CMAKE_BUILD_DEBUG
-        __disable_output = false;
-#endif // CMAKE_BUILD_DEBUG
-
-        // second, remove dentry in parent inode
         auto parent_inode_id = filesystem_inode_smi->get_inode_id_by_path(original.to_string());
-        auto parent_inode = filesystem_inode_smi->get_inode_by_id(parent_inode_id);
-        directory_resolver_t ori_directoryResolver(parent_inode, FILESYSTEM_CUR_MODIFIABLE_VER);
-        ori_directoryResolver.remove_path(original_name);
-        ori_directoryResolver.save_current();
+        auto target_parent_inode_id = filesystem_inode_smi->get_inode_id_by_path(target.to_string());
 
+        // FUSE 2 passes no rename flags
+        filesystem_inode_smi->rename(parent_inode_id, original_name,
+                                     target_parent_inode_id, target_name);
         return 0;
-
     }
     CATCH_TAIL;
 }
@@ -559,6 +1128,7 @@ int do_fallocate(const char * path, int mode, off_t offset, off_t length, struct
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
@@ -592,12 +1162,25 @@ int do_readlink (const char * path, char * buffer, size_t size)
 {
     try
     {
-        std::string parsed_path;
-        snapshot_ver_t version = if_snapshot(path, parsed_path);
+        std::string_view version, parsed_path;
+        if (parse_snapshot_prefix(path, version, parsed_path))
+        {
+            auto view = filesystem_inode_smi->pin_snapshot_volume(version);
+            auto inode_id = view->get_inode_id_by_path(parsed_path);
+            if (view->get_stat(inode_id).st_mode & S_IFLNK) {
+                view->read(inode_id, buffer, size, 0);
+            } else {
+                return -EINVAL;
+            }
+
+            return 0;
+        }
+
+        LOCK_FILESYSTEM;
         auto inode_id = filesystem_inode_smi->get_inode_id_by_path(path);
         auto inode = filesystem_inode_smi->get_inode_by_id(inode_id);
         if (inode->fs_stat.st_mode & S_IFLNK) {
-            inode->read(version, buffer, size, 0);
+            inode->read(FILESYSTEM_CUR_MODIFIABLE_VER, buffer, size, 0);
         } else {
             return -EINVAL;
         }
@@ -607,14 +1190,117 @@ int do_readlink (const char * path, char * buffer, size_t size)
     CATCH_TAIL;
 }
 
+/// background COW break task, spends at most cow_break_bandwidth per second
+static void cow_break_task()
+{
+    // one interval is usually worth less than a block, budget is carried over until it covers one
+    const htmpfs_size_t budget_per_interval = cow_break_bandwidth * COW_BREAK_INTERVAL_MS / 1000;
+    htmpfs_size_t credit = 0;
+
+    while (!cow_break_stop)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(COW_BREAK_INTERVAL_MS));
+
+        try
+        {
+            LOCK_FILESYSTEM;
+            credit += budget_per_interval;
+            filesystem_inode_smi->break_cow_with_credit(credit);
+        }
+        catch (std::exception & error)
+        {
+            std::cerr << error.what() << std::endl;
+        }
+    }
+}
+
+/// background reclamation task, unlinks at most reclaim_rate blocks per second,
+/// and collects snapshot views retired while pinned once their readers are gone
+static void reclaim_task()
+{
+    // budget is counted in thousandths of a block, so rates below one block per interval
+    // are carried over to later intervals instead of being rounded up
+    htmpfs_size_t credit = 0;
+
+    while (!reclaim_stop)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(RECLAIM_INTERVAL_MS));
+
+        try
+        {
+            // checked without filesystem lock, the retired list has a lock of its own
+            if (filesystem_inode_smi->retired_pending())
+            {
+                LOCK_FILESYSTEM;
+                filesystem_inode_smi->collect_retired();
+            }
+        }
+        catch (std::exception & error)
+        {
+            std::cerr << error.what() << std::endl;
+        }
+
+        if (reclaim_rate == 0)
+        {
+            continue;
+        }
+
+        credit += reclaim_rate * RECLAIM_INTERVAL_MS;
+        const htmpfs_size_t budget = credit / 1000;
+        if (budget == 0)
+        {
+            continue;
+        }
+
+        // unused budget is not saved up, idle time does not allow a burst later
+        credit -= budget * 1000;
+
+        try
+        {
+            LOCK_FILESYSTEM;
+            if (filesystem_inode_smi->reclaim_pending())
+            {
+                filesystem_inode_smi->reclaim_step(budget);
+            }
+        }
+        catch (std::exception & error)
+        {
+            std::cerr << error.what() << std::endl;
+        }
+    }
+}
+
 void do_destroy (void *)
 {
-    __asm__("nop");
+    if (cow_break_thread.joinable())
+    {
+        cow_break_stop = true;
+        cow_break_thread.join();
+    }
+
+    if (reclaim_thread.joinable())
+    {
+        reclaim_stop = true;
+        reclaim_thread.join();
+    }
 }
 
 void* do_init (struct fuse_conn_info *conn)
 {
     conn->capable |= FUSE_CAP_ATOMIC_O_TRUNC;
+
+    if (cow_break_bandwidth != 0)
+    {
+        cow_break_thread = std::thread(cow_break_task);
+    }
+
+    if (reclaim_rate != 0)
+    {
+        filesystem_inode_smi->set_deferred_reclaim(true);
+    }
+
+    reclaim_thread = std::thread(reclaim_task);
+
     return nullptr;
 }
 
@@ -638,6 +1324,7 @@ int do_mknod (const char * path, mode_t mode, dev_t device)
     try
     {
         CHECK_RDONLY_FS(path);
+        LOCK_FILESYSTEM;
 
         path_t vpath(path);
         auto target_name = vpath.pop_end();
@@ -0,0 +1,200 @@
+/** @file
+ *
+ * This file implements htmpfs_tar, which imports tar archives into and exports them from a mounted htmpfs
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/tar_archive.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <csignal>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/// block size of filesystem used by check, same as mount.htmpfs
+#define CHECK_BLOCK_SIZE (512 * 1024)
+
+static void usage(const char * progname)
+{
+    printf(
+            "usage: %s import MOUNTPOINT ARCHIVE [DIRECTORY]\n"
+            "       %s export MOUNTPOINT ARCHIVE [VERSION]\n"
+            "       %s check ARCHIVE\n"
+            "\n"
+            "    import                 Extract ARCHIVE into DIRECTORY of a mounted htmpfs, root by default.\n"
+            "                           DIRECTORY is a pathname inside of the filesystem, e.g., /opt.\n"
+            "    export                 Write VERSION of a mounted htmpfs into ARCHIVE, version 0 by default.\n"
+            "    check                  Extract ARCHIVE into a private filesystem in memory, then report\n"
+            "                           what was extracted and how long it took.\n"
+            "\n"
+            "ARCHIVE is an uncompressed tar archive, \"-\" for standard input or output.\n"
+            "compressed archives are piped in and out, e.g., `zstd -dc seed.tar.zst | %s import /mnt -`.\n"
+            "\n", progname, progname, progname, progname);
+}
+
+/// absolute pathname of a host file, the file itself may not exist yet
+static std::string absolute_path(const std::string & pathname)
+{
+    auto separator = pathname.rfind('/');
+    std::string directory = separator == std::string::npos ? "." : pathname.substr(0, separator + 1);
+    std::string name = separator == std::string::npos ? pathname : pathname.substr(separator + 1);
+
+    char resolved [PATH_MAX];
+    if (!realpath(directory.c_str(), resolved))
+    {
+        throw std::runtime_error("cannot resolve " + pathname + ": " + strerror(errno));
+    }
+
+    return std::string(resolved) + (strcmp(resolved, "/") ? "/" : "") + name;
+}
+
+/// write a request into a control file of a mounted htmpfs, blocks until the request is done
+/// @return 0 on success, errno otherwise
+static int send_request(const std::string & mountpoint, const std::string & entry, const std::string & request)
+{
+    std::string control_file = mountpoint + "/.control/" + entry;
+    int fd = open(control_file.c_str(), O_WRONLY);
+    if (fd < 0)
+    {
+        return errno;
+    }
+
+    int ret = write(fd, request.c_str(), request.length()) < 0 ? errno : 0;
+    close(fd);
+    return ret;
+}
+
+/// copy between two descriptors until end of input
+static void pump(int input, int output)
+{
+    char buffer [64 * 1024];
+    ssize_t length;
+    while ((length = read(input, buffer, sizeof(buffer))) > 0)
+    {
+        for (ssize_t written = 0, ret; written < length; written += ret)
+        {
+            if ((ret = write(output, buffer + written, length - written)) < 0)
+            {
+                return;
+            }
+        }
+    }
+}
+
+/// send an import or export request, "-" is streamed through a fifo the filesystem opens as archive
+static int transfer(const std::string & mountpoint, const std::string & entry,
+                    const std::string & archive, const std::string & argument)
+{
+    if (archive != "-")
+    {
+        return send_request(mountpoint, entry, absolute_path(archive) + (argument.empty() ? "" : "\n" + argument));
+    }
+
+    char directory [] = "/tmp/htmpfs_tar.XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        return errno;
+    }
+
+    std::string fifo = std::string(directory) + "/archive";
+    if (mkfifo(fifo.c_str(), 0600) < 0)
+    {
+        int ret = errno;
+        rmdir(directory);
+        return ret;
+    }
+
+    // opening one end of a fifo blocks until the filesystem opens the other end
+    bool is_import = entry == "import";
+    std::thread pump_thread([&]
+    {
+        int fd = open(fifo.c_str(), is_import ? O_WRONLY : O_RDONLY);
+        if (fd >= 0)
+        {
+            is_import ? pump(STDIN_FILENO, fd) : pump(fd, STDOUT_FILENO);
+            close(fd);
+        }
+    });
+
+    int ret = send_request(mountpoint, entry, fifo + (argument.empty() ? "" : "\n" + argument));
+
+    // request failed before the filesystem opened the fifo, release pump thread
+    int fd = open(fifo.c_str(), (is_import ? O_RDONLY : O_WRONLY) | O_NONBLOCK);
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    pump_thread.join();
+    unlink(fifo.c_str());
+    rmdir(directory);
+    return ret;
+}
+
+static int check(const std::string & archive)
+{
+    inode_smi_t filesystem(CHECK_BLOCK_SIZE);
+    std::ifstream file;
+    if (archive != "-")
+    {
+        file.open(archive, std::ios::binary);
+        if (!file)
+        {
+            return errno;
+        }
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    auto statistics = tar_import(filesystem, archive == "-" ? std::cin : file);
+    std::chrono::duration < double > elapsed = std::chrono::steady_clock::now() - begin;
+
+    printf("directories %lu\nfiles %lu\nsymlinks %lu\nspecials %lu\nskipped %lu\nbytes %lu\nseconds %.3f\n",
+           statistics.directories, statistics.files, statistics.symlinks, statistics.specials,
+           statistics.skipped, statistics.bytes, elapsed.count());
+    return 0;
+}
+
+int main(int argc, char ** argv)
+{
+    // a fifo closed by the filesystem must not kill the pump
+    signal(SIGPIPE, SIG_IGN);
+
+    try
+    {
+        std::string mode = argc > 1 ? argv[1] : "";
+        int ret;
+
+        if ((mode == "import" || mode == "export") && (argc == 4 || argc == 5))
+        {
+            ret = transfer(argv[2], mode, argv[3], argc == 5 ? argv[4] : "");
+        }
+        else if (mode == "check" && argc == 3)
+        {
+            ret = check(argv[2]);
+        }
+        else
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (ret != 0)
+        {
+            std::cerr << mode << " failed: " << strerror(ret) << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+    catch (std::exception & error)
+    {
+        std::cerr << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -8,7 +8,9 @@
 #include <iostream>
 #include <fuse_ops.h>
 #include <htmpfs/htmpfs.h>
+#include <htmpfs/tar_archive.h>
 #include <unistd.h>
+#include <fstream>
 
 static struct fuse_operations fuse_ops =
         {
@@ -43,6 +45,15 @@ static struct fuse_operations fuse_ops =
                 .fallocate  = do_fallocate,
         };
 
+/// tar archive extracted into root before mounting, empty for none
+static std::string import_archive;
+
+/// host directory attached as lower layer of root, empty for none
+static std::string lower_directory;
+
+/// uncompressed tar archive mapped as base image of root, empty for none
+static std::string base_image;
+
 static void usage(const char *progname)
 {
     printf(
@@ -50,6 +61,15 @@ static void usage(const char *progname)
             "\n"
             "general options:\n"
             "    -o opt,[opt...]        Mount options.\n"
+            "    -o cow_break=KIB       Copy snapshot-frozen blocks of recently written files\n"
+            "                           in background, at most KIB KiB per second.\n"
+            "    -o reclaim=BLOCKS      Free blocks of unlinked and truncated files in background,\n"
+            "                           at most BLOCKS blocks per second.\n"
+            "    -o import=ARCHIVE      Extract tar archive into root before mounting.\n"
+            "    -o base=IMAGE          Map uncompressed tar archive IMAGE as base image of root. mounts of\n"
+            "                           the same image share its data, each holds only what it changed.\n"
+            "    -o lower=DIR           Show host directory DIR in root, read from host on first access\n"
+            "                           and copied into memory only when changed.\n"
             "    -h, --help             Print help.\n"
             "    -V, --version          Print version.\n"
             "\n", progname);
@@ -58,6 +78,11 @@ static void usage(const char *progname)
 enum {
     KEY_VERSION,
     KEY_HELP,
+    KEY_COW_BREAK,
+    KEY_RECLAIM,
+    KEY_IMPORT,
+    KEY_LOWER,
+    KEY_BASE,
 };
 
 static struct fuse_opt fs_opts[] = {
@@ -65,10 +90,15 @@ static struct fuse_opt fs_opts[] = {
         FUSE_OPT_KEY("--version",       KEY_VERSION),
         FUSE_OPT_KEY("-h",              KEY_HELP),
         FUSE_OPT_KEY("--help",          KEY_HELP),
+        FUSE_OPT_KEY("cow_break=",      KEY_COW_BREAK),
+        FUSE_OPT_KEY("reclaim=",        KEY_RECLAIM),
+        FUSE_OPT_KEY("import=",         KEY_IMPORT),
+        FUSE_OPT_KEY("lower=",          KEY_LOWER),
+        FUSE_OPT_KEY("base=",           KEY_BASE),
         FUSE_OPT_END,
 };
 
-static int opt_proc(void *, const char *, int key, struct fuse_args *outargs)
+static int opt_proc(void *, const char * arg, int key, struct fuse_args *outargs)
 {
     static struct fuse_operations ss_nullptr { };
 
@@ -88,6 +118,26 @@ static int opt_proc(void *, const char *, int key, struct fuse_args *outargs)
             fuse_opt_free_args(outargs);
             exit(EXIT_SUCCESS);
 
+        case KEY_COW_BREAK:
+            cow_break_bandwidth = strtoull(arg + strlen("cow_break="), nullptr, 10) * 1024;
+            return 0;
+
+        case KEY_RECLAIM:
+            reclaim_rate = strtoull(arg + strlen("reclaim="), nullptr, 10);
+            return 0;
+
+        case KEY_IMPORT:
+            import_archive = arg + strlen("import=");
+            return 0;
+
+        case KEY_LOWER:
+            lower_directory = arg + strlen("lower=");
+            return 0;
+
+        case KEY_BASE:
+            base_image = arg + strlen("base=");
+            return 0;
+
         default:
             return 1;
     }
@@ -105,7 +155,6 @@ int main(int argc, char** argv)
         root_inode->fs_stat.st_ctim = get_current_time();
         root_inode->fs_stat.st_atim = get_current_time();
         root_inode->fs_stat.st_mtim = get_current_time();
-        root_inode->fs_stat.st_ino = FILESYSTEM_ROOT_INODE_NUMBER;
         root_inode->fs_stat.st_mode = 0755 | S_IFDIR;
         root_inode->fs_stat.st_gid = getgid();
         root_inode->fs_stat.st_uid = getuid();
@@ -120,12 +169,38 @@ int main(int argc, char** argv)
             THROW_HTMPFS_ERROR_STDERR(HTMPFS_EXT_LIB_ERR);
         }
 
+        // base image goes first, then lower layer shows what base image does not hold,
+        // then an imported archive is merged over both
+        if (!base_image.empty())
+        {
+            tar_load_image(*filesystem_inode_smi, base_image);
+        }
+
+        if (!lower_directory.empty())
+        {
+            filesystem_inode_smi->attach_lower_layer(lower_directory);
+        }
+
+        // populate root before FUSE starts serving requests
+        if (!import_archive.empty())
+        {
+            std::ifstream archive(import_archive, std::ios::binary);
+            if (!archive)
+            {
+                std::cerr << "Cannot open " << import_archive << ": " << strerror(errno) << std::endl;
+                THROW_HTMPFS_ERROR_STDERR(HTMPFS_EXT_LIB_ERR);
+            }
+
+            tar_import(*filesystem_inode_smi, archive);
+        }
+
         /*
-         * s: run single threaded
          * d: enable debugging
          * f: stay in foreground
+         *
+         * multi-threaded: operations on version 0 are serialized by filesystem_lock,
+         * snapshot volumes are read through lock-free views
          */
-        fuse_opt_add_arg(&args, "-s");
 
 #ifdef CMAKE_BUILD_DEBUG
         fuse_opt_add_arg(&args, "-d");
@@ -216,5 +216,26 @@ int main()
         }
     }
 
+    {
+        /// instance 15: shared bytes are read in place, and copied on first change
+
+        INSTANCE("BUFFER: instance 15: shared bytes");
+        const char hello_world [] = "Hello, world!";
+        auto buffer = buffer_t::share(hello_world, strlen(hello_world));
+        char payload [6] { };
+        VERIFY_DATA_OPS_LEN(buffer.read(payload, 5, 7), 5);
+        if (std::string(payload) != "world" || buffer.size() != strlen(hello_world))
+        {
+            return EXIT_FAILURE;
+        }
+
+        VERIFY_DATA_OPS_LEN(buffer.write("J", 1, 0, false), 1);
+        buffer.truncate(5);
+        if (buffer.to_string() != "Jello" || std::string(hello_world) != "Hello, world!")
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
     return EXIT_SUCCESS;
 }
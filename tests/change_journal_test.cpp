@@ -0,0 +1,94 @@
+/** @file
+ *
+ * This file defines test for change journal
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/change_journal.h>
+#include <iostream>
+#include <string>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+int main()
+{
+    {
+        /// instance 1: journal ring and cursor
+
+        INSTANCE("CHANGE JOURNAL: instance 1: journal ring and cursor");
+        change_journal_t journal(4);
+        VERIFY_DATA(journal.read(0).size(), 0);
+
+        for (uint64_t i = 0; i < 6; i++)
+        {
+            VERIFY_DATA(journal.record(change_journal_t::JOURNAL_WRITE, i,
+                                       change_journal_t::no_parent,
+                                       change_journal_t::no_parent, i, 1), i + 1);
+        }
+
+        // entries 1 and 2 are dropped
+        auto entries = journal.read(2);
+        VERIFY_DATA(entries.size(), 4);
+        VERIFY_DATA(entries.front().sequence, 3);
+        VERIFY_DATA(entries.back().sequence, 6);
+        VERIFY_DATA(journal.read(4, 1).size(), 1);
+        VERIFY_DATA(journal.read(4, 1).front().inode_id, 4);
+        VERIFY_DATA(journal.read(6).size(), 0);
+
+        try {
+            (void)journal.read(1);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_JOURNAL_CURSOR_EXPIRED);
+            VERIFY_DATA(err.my_errno(), ESTALE);
+        }
+    }
+
+    {
+        /// instance 2: filesystem operations are journaled
+
+        INSTANCE("CHANGE JOURNAL: instance 2: filesystem operations are journaled");
+        inode_smi_t filesystem(7);
+        auto cursor = filesystem.get_journal_sequence();
+
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        auto conf = filesystem.make_child_dentry_under_parent(etc, "Xorg.conf");
+        filesystem.get_inode_by_id(conf)->write("Section", 7, 0);
+        filesystem.get_inode_by_id(conf)->truncate(3);
+        filesystem.record_change(change_journal_t::JOURNAL_SETATTR, conf);
+        filesystem.remove_child_dentry_under_parent(etc, "Xorg.conf");
+
+        auto entries = filesystem.read_change_journal(cursor);
+        VERIFY_DATA(entries.size(), 6);
+
+        VERIFY_DATA(entries[0].operation, change_journal_t::JOURNAL_CREATE);
+        VERIFY_DATA(entries[0].inode_id, etc);
+        VERIFY_DATA(entries[0].parent_inode_id, FILESYSTEM_ROOT_INODE_NUMBER);
+
+        VERIFY_DATA(entries[1].operation, change_journal_t::JOURNAL_CREATE);
+        VERIFY_DATA(entries[1].parent_inode_id, etc);
+
+        VERIFY_DATA(entries[2].operation, change_journal_t::JOURNAL_WRITE);
+        VERIFY_DATA(entries[2].inode_id, conf);
+        VERIFY_DATA(entries[2].offset, 0);
+        VERIFY_DATA(entries[2].length, 7);
+
+        VERIFY_DATA(entries[3].operation, change_journal_t::JOURNAL_TRUNCATE);
+        VERIFY_DATA(entries[3].offset, 3);
+
+        VERIFY_DATA(entries[4].operation, change_journal_t::JOURNAL_SETATTR);
+
+        VERIFY_DATA(entries[5].operation, change_journal_t::JOURNAL_UNLINK);
+        VERIFY_DATA(entries[5].inode_id, conf);
+        VERIFY_DATA(entries[5].parent_inode_id, etc);
+
+        // consumer resumes from the last entry it has seen
+        cursor = entries.back().sequence;
+        filesystem.make_child_dentry_under_parent(etc, "X11", true);
+        entries = filesystem.read_change_journal(cursor);
+        VERIFY_DATA(entries.size(), 1);
+        VERIFY_DATA(entries[0].sequence, cursor + 1);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/** @file
+ *
+ * This file defines test for dentry cache
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/dentry_cache.h>
+#include <iostream>
+#include <string>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+int main()
+{
+    {
+        /// instance 1: lookup, negative entries, invalidation and LRU eviction
+
+        INSTANCE("DENTRY CACHE: instance 1: lookup, negative entries, invalidation and LRU eviction");
+        dentry_cache_t dentry_cache(3);
+        inode_id_t inode_id = 0;
+
+        VERIFY_DATA(dentry_cache.lookup(0, FILESYSTEM_CUR_MODIFIABLE_VER, "etc", inode_id),
+                    dentry_cache_t::DENTRY_CACHE_MISS);
+
+        dentry_cache.insert(0, FILESYSTEM_CUR_MODIFIABLE_VER, "etc", 1);
+        dentry_cache.insert(0, "1", "etc", 2);
+        dentry_cache.insert_negative(1, FILESYSTEM_CUR_MODIFIABLE_VER, "X11");
+
+        VERIFY_DATA(dentry_cache.lookup(0, FILESYSTEM_CUR_MODIFIABLE_VER, "etc", inode_id),
+                    dentry_cache_t::DENTRY_CACHE_HIT);
+        VERIFY_DATA(inode_id, 1);
+        VERIFY_DATA(dentry_cache.lookup(0, "1", "etc", inode_id), dentry_cache_t::DENTRY_CACHE_HIT);
+        VERIFY_DATA(inode_id, 2);
+        VERIFY_DATA(dentry_cache.lookup(1, FILESYSTEM_CUR_MODIFIABLE_VER, "X11", inode_id),
+                    dentry_cache_t::DENTRY_CACHE_NEGATIVE);
+
+        // (0, etc, current) is the least recently used one
+        dentry_cache.insert(1, FILESYSTEM_CUR_MODIFIABLE_VER, "Xorg.conf", 3);
+        VERIFY_DATA(dentry_cache.size(), 3);
+        VERIFY_DATA(dentry_cache.lookup(0, FILESYSTEM_CUR_MODIFIABLE_VER, "etc", inode_id),
+                    dentry_cache_t::DENTRY_CACHE_MISS);
+
+        dentry_cache.invalidate(1, FILESYSTEM_CUR_MODIFIABLE_VER, "X11");
+        VERIFY_DATA(dentry_cache.lookup(1, FILESYSTEM_CUR_MODIFIABLE_VER, "X11", inode_id),
+                    dentry_cache_t::DENTRY_CACHE_MISS);
+
+        dentry_cache.invalidate_version("1");
+        VERIFY_DATA(dentry_cache.lookup(0, "1", "etc", inode_id), dentry_cache_t::DENTRY_CACHE_MISS);
+
+        dentry_cache.invalidate_directory(1, FILESYSTEM_CUR_MODIFIABLE_VER);
+        VERIFY_DATA(dentry_cache.size(), 0);
+    }
+
+    {
+        /// instance 2: pathname resolution never returns stale entries
+
+        INSTANCE("DENTRY CACHE: instance 2: pathname resolution never returns stale entries");
+        inode_smi_t filesystem(7);
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        auto x11 = filesystem.make_child_dentry_under_parent(etc, "X11", true);
+
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/X11"), x11);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/X11"), x11);
+
+        // negative entry is dropped by creation
+        try {
+            (void)filesystem.get_inode_id_by_path("/etc/X11/xorg.conf");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+
+        auto conf = filesystem.make_child_dentry_under_parent(x11, "xorg.conf");
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/X11/xorg.conf"), conf);
+
+        // snapshot keeps its own entries
+        filesystem.create_snapshot_volume("1");
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/.snapshot/1/etc/X11/xorg.conf"), conf);
+
+        // positive entry is dropped by removal
+        filesystem.remove_child_dentry_under_parent(x11, "xorg.conf");
+        try {
+            (void)filesystem.get_inode_id_by_path("/etc/X11/xorg.conf");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/.snapshot/1/etc/X11/xorg.conf"), conf);
+
+        // recreated snapshot volume with the same name does not see entries of the old one
+        filesystem.delete_snapshot_volume("1");
+        filesystem.create_snapshot_volume("1");
+        try {
+            (void)filesystem.get_inode_id_by_path("/.snapshot/1/etc/X11/xorg.conf");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+
+        // rename through directory resolvers
+        {
+            directory_resolver_t etc_resolver(filesystem.get_inode_by_id(etc), FILESYSTEM_CUR_MODIFIABLE_VER);
+            etc_resolver.add_path("X11.old", x11);
+            etc_resolver.remove_path("X11");
+            etc_resolver.save_current();
+        }
+
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/X11.old"), x11);
+        try {
+            (void)filesystem.get_inode_id_by_path("/etc/X11");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+
+        // unsaved changes are dropped together with entries seen in between
+        {
+            directory_resolver_t etc_resolver(filesystem.get_inode_by_id(etc), FILESYSTEM_CUR_MODIFIABLE_VER);
+            etc_resolver.add_path("unsaved", x11);
+            VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/unsaved"), x11);
+        }
+
+        try {
+            (void)filesystem.get_inode_id_by_path("/etc/unsaved");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+    }
+
+    {
+        /// instance 3: absent names are reported without throwing
+
+        INSTANCE("DENTRY CACHE: instance 3: absent names are reported without throwing");
+        inode_smi_t filesystem(7);
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        auto conf = filesystem.make_child_dentry_under_parent(etc, "ld.so.conf");
+        inode_id_t inode_id = 0;
+
+        // first miss is answered by directory, second one by negative entry
+        for (int i = 0; i < 2; i++)
+        {
+            VERIFY_DATA(filesystem.try_get_inode_id_by_path("/etc/ld.so.preload", inode_id), false);
+            VERIFY_DATA(filesystem.try_get_inode_id_by_path("/usr/lib/libc.so.6", inode_id), false);
+        }
+
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/etc/ld.so.conf", inode_id), true);
+        VERIFY_DATA(inode_id, conf);
+
+        // other errors are still thrown
+        try {
+            (void)filesystem.try_get_inode_id_by_path("/etc/ld.so.conf/libc.so.6", inode_id);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NOT_A_DIRECTORY);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -24,7 +24,7 @@ int main()
 
         INSTANCE("DIR RESOLV: instance 1: add entries in directory resolver, confined in cache");
         inode_smi_t filesystem(2);
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
         directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
         uint64_t count = 0xF0;
@@ -46,7 +46,7 @@ int main()
 
         INSTANCE("DIR RESOLV: instance 2: add entries in directory resolver save to inode");
         inode_smi_t filesystem(2);
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
         directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
         uint64_t count = 0xF0;
@@ -74,7 +74,7 @@ int main()
         try
         {
             inode_smi_t filesystem(2);
-            inode_t inode(2, 0, &filesystem, false);
+            inode_t inode(0, &filesystem, false);
             directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
         }
         catch (HTMPFS_error_t & err)
@@ -91,7 +91,7 @@ int main()
 
         INSTANCE("DIR RESOLV: instance 4: export vector");
         inode_smi_t filesystem(2);
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
         directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
         uint64_t count = 0xF0;
@@ -117,7 +117,7 @@ int main()
         try
         {
             inode_smi_t filesystem(2);
-            inode_t inode(2, 0, &filesystem, true);
+            inode_t inode(0, &filesystem, true);
             directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
             directory_resolver.add_path("dir", 0);
             directory_resolver.add_path("dir", 0);
@@ -136,7 +136,7 @@ int main()
 
         INSTANCE("DIR RESOLV: instance 6: makep dentry, both successful and failed");
         inode_smi_t filesystem(2);
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
         directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
         directory_resolver.add_path("dir", 0);
 
@@ -160,7 +160,7 @@ int main()
 
         INSTANCE("DIR RESOLV: instance 7: path remove, inter-actively, both successful and failed");
         inode_smi_t filesystem(2);
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
         directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
 
         uint64_t count = 0xF0;
@@ -213,7 +213,7 @@ int main()
 
         INSTANCE("DIR RESOLV: instance 8: check availability, both successful and failed");
         inode_smi_t filesystem(2);
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
         directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
         directory_resolver.add_path("dir", 0);
 
@@ -228,5 +228,247 @@ int main()
         }
     }
 
+    {
+        /// instance 9: large directory, removal keeps order across tombstone compaction
+
+        INSTANCE("DIR RESOLV: instance 9: large directory, removal keeps order across tombstone compaction");
+        inode_smi_t filesystem(4096);
+        inode_t inode(0, &filesystem, true);
+        directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+        const uint64_t entry_count = 100000;
+
+        for (uint64_t i = 0; i < entry_count; i++)
+        {
+            directory_resolver.add_path("file" + std::to_string(i), i);
+        }
+
+        // remove every entry except multiples of 3, compaction happens halfway
+        for (uint64_t i = 0; i < entry_count; i++)
+        {
+            if (i % 3 != 0)
+            {
+                directory_resolver.remove_path("file" + std::to_string(i));
+            }
+        }
+
+        VERIFY_DATA(directory_resolver.target_count(), (entry_count + 2) / 3);
+        VERIFY_DATA(directory_resolver.check_availability("file1"), true);
+        VERIFY_DATA(directory_resolver.namei("file99999"), 99999);
+
+        directory_resolver.save_current();
+        directory_resolver_t directory_resolver2(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+
+        uint64_t expected = 0;
+        for (const auto & i : directory_resolver2)
+        {
+            VERIFY_DATA(i.pathname, "file" + std::to_string(expected));
+            VERIFY_DATA(i.inode_id, expected);
+            expected += 3;
+        }
+
+        VERIFY_DATA(expected, entry_count + 2);
+    }
+
+    {
+        /// instance 10: incremental save, tombstones and appends are written in place
+
+        INSTANCE("DIR RESOLV: instance 10: incremental save, tombstones and appends are written in place");
+        inode_smi_t filesystem(64);
+        inode_t inode(0, &filesystem, true);
+
+        // "file0" is stored in full (3 + 1 + 5 bytes), "fileN" shares "file" with previous record (3 + 1 + 1)
+        const htmpfs_size_t first_record_size = 9, record_size = 5;
+
+        {
+            directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            for (uint64_t i = 0; i < 10; i++)
+            {
+                directory_resolver.add_path("file" + std::to_string(i), i);
+            }
+            directory_resolver.save_current();
+        }
+
+        VERIFY_DATA(inode.current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER), sizeof(uint64_t) + first_record_size + 9 * record_size);
+
+        {
+            // removal leaves a tombstone record, size unchanged
+            directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            directory_resolver.remove_path("file3");
+            directory_resolver.save_current();
+            VERIFY_DATA(inode.current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER), sizeof(uint64_t) + first_record_size + 9 * record_size);
+        }
+
+        {
+            // append adds exactly one record
+            directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            VERIFY_DATA(directory_resolver.target_count(), 9);
+            VERIFY_DATA(directory_resolver.check_availability("file3"), true);
+            directory_resolver.add_path("file3", 33);
+            directory_resolver.save_current();
+            VERIFY_DATA(inode.current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER), sizeof(uint64_t) + first_record_size + 10 * record_size);
+        }
+
+        {
+            // new dentry goes last, and tombstones get compacted once they outnumber live dentries
+            directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            auto vec = directory_resolver.to_vector();
+            VERIFY_DATA(vec.back().pathname, "file3");
+            VERIFY_DATA(vec.back().inode_id, 33);
+
+            for (uint64_t i = 4; i < 10; i++)
+            {
+                directory_resolver.remove_path("file" + std::to_string(i));
+            }
+            directory_resolver.save_current();
+            VERIFY_DATA(inode.current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER), sizeof(uint64_t) + first_record_size + 3 * record_size);
+        }
+
+        directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+        std::vector < std::string > names;
+        for (const auto & i : directory_resolver)
+        {
+            names.emplace_back(i.pathname);
+        }
+        VERIFY_DATA(names, std::vector < std::string >({"file0", "file1", "file2", "file3"}));
+        VERIFY_DATA(directory_resolver.namei("file3"), 33);
+    }
+
+    {
+        /// instance 11: long names are kept in full, names beyond DENTRY_NAME_MAX are rejected
+
+        INSTANCE("DIR RESOLV: instance 11: long names are kept in full, names beyond DENTRY_NAME_MAX are rejected");
+        inode_smi_t filesystem(64);
+        inode_t inode(0, &filesystem, true);
+        const std::string longest_name(DENTRY_NAME_MAX, 'a');
+        const std::string shared_prefix_name = std::string(200, 'a') + "b";
+
+        {
+            directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            directory_resolver.add_path(longest_name, 0x10000000000ULL);
+            directory_resolver.add_path(shared_prefix_name, 1);
+
+            try {
+                directory_resolver.add_path(longest_name + "a", 2);
+                return EXIT_FAILURE;
+            } catch (HTMPFS_error_t & err) {
+                VERIFY_DATA(err.my_errcode(), HTMPFS_NAME_TOO_LONG);
+                VERIFY_DATA(err.my_errno(), ENAMETOOLONG);
+            }
+
+            directory_resolver.save_current();
+        }
+
+        directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+        VERIFY_DATA(directory_resolver.namei(longest_name), 0x10000000000ULL);
+        VERIFY_DATA(directory_resolver.namei(shared_prefix_name), 1);
+
+        try {
+            filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, longest_name + "a");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NAME_TOO_LONG);
+        }
+    }
+
+    {
+        /// instance 12: parsed directory is shared, unsaved changes are discarded with their resolver
+
+        INSTANCE("DIR RESOLV: instance 12: parsed directory is shared, unsaved changes are discarded");
+        inode_smi_t filesystem(16);
+        auto dir = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "dir", true);
+        inode_t * inode = filesystem.get_inode_by_id(dir);
+
+        {
+            directory_resolver_t directory_resolver(inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            directory_resolver.add_path("saved", 1);
+            directory_resolver.save_current();
+
+            // resolver created afterwards sees saved changes without parsing inode again
+            directory_resolver_t another_resolver(inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            VERIFY_DATA(another_resolver.namei("saved"), 1);
+        }
+
+        filesystem.create_snapshot_volume("1");
+
+        {
+            directory_resolver_t directory_resolver(inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            directory_resolver.add_path("unsaved", 2);
+            directory_resolver.remove_path("saved");
+        }
+
+        {
+            directory_resolver_t directory_resolver(inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+            VERIFY_DATA(directory_resolver.check_availability("unsaved"), true);
+            VERIFY_DATA(directory_resolver.namei("saved"), 1);
+            directory_resolver.add_path("after_snapshot", 3);
+            directory_resolver.save_current();
+        }
+
+        directory_resolver_t current_resolver(inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+        directory_resolver_t snapshot_resolver(inode, "1");
+        VERIFY_DATA(current_resolver.target_count(), 2);
+        VERIFY_DATA(snapshot_resolver.target_count(), 1);
+        VERIFY_DATA(snapshot_resolver.check_availability("after_snapshot"), true);
+    }
+
+    {
+        /// instance 13: paginated listing resumes after a cookie across changes and compaction
+
+        INSTANCE("DIR RESOLV: instance 13: paginated listing resumes after a cookie");
+        inode_smi_t filesystem(64);
+        inode_t inode(0, &filesystem, true);
+        directory_resolver_t directory_resolver(&inode, FILESYSTEM_CUR_MODIFIABLE_VER);
+
+        for (uint64_t i = 0; i < 100; i++)
+        {
+            directory_resolver.add_path("file" + std::to_string(i), i);
+        }
+        directory_resolver.save_current();
+
+        // list by pages of 10 dentries, remove listed ones and add a new one in between
+        std::vector < uint64_t > listed;
+        uint64_t cookie = 0;
+        while (true)
+        {
+            std::vector < std::string > page;
+            directory_resolver.readdir(cookie, [&](const char * name, uint64_t inode_id, uint64_t next)
+            {
+                if (page.size() == 10)
+                {
+                    return false;
+                }
+
+                page.emplace_back(name);
+                listed.emplace_back(inode_id);
+                cookie = next;
+                return true;
+            });
+
+            if (page.empty())
+            {
+                break;
+            }
+
+            for (const auto & i : page)
+            {
+                directory_resolver.remove_path(i);
+            }
+
+            if (listed.size() == 50)
+            {
+                directory_resolver.add_path("late", 100);
+            }
+
+            directory_resolver.save_current();
+        }
+
+        // every original dentry is listed exactly once, in order, dentry added during listing comes last
+        VERIFY_DATA(listed.size(), 101);
+        for (uint64_t i = 0; i < 101; i++)
+        {
+            VERIFY_DATA(listed[i], i);
+        }
+    }
+
     return EXIT_SUCCESS;
 }
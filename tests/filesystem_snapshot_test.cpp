@@ -154,6 +154,102 @@ int main()
         }
     }
 
+    {
+        /// instance 3: per-file version history
+
+        INSTANCE("FILESYSTEM: instance 3: per-file version history");
+        inode_smi_t filesystem(27);
+        auto file = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER,
+                                                              "linux.boot", false);
+        auto * inode = filesystem.get_inode_by_id(file);
+
+        inode->write("vmlinuz", 7, 0);
+        filesystem.create_snapshot_volume("1");
+        filesystem.create_snapshot_volume("2");     // unchanged
+        inode->write("vmlinuz-lts", 11, 0);
+        filesystem.create_snapshot_volume("3");
+        inode->truncate(3);
+
+        auto history = filesystem.get_version_history("/linux.boot");
+        VERIFY_DATA(history.size(), 3);
+        VERIFY_DATA(history[0].versions, std::vector < snapshot_ver_t >({"1", "2"}));
+        VERIFY_DATA(history[0].data_size, 7);
+        VERIFY_DATA(history[1].versions, std::vector < snapshot_ver_t >({"3"}));
+        VERIFY_DATA(history[1].data_size, 11);
+        VERIFY_DATA(history[2].versions, std::vector < snapshot_ver_t >({FILESYSTEM_CUR_MODIFIABLE_VER}));
+        VERIFY_DATA(history[2].data_size, 3);
+
+        // removing a snapshot keeps remaining versions of the same content
+        filesystem.delete_snapshot_volume("1");
+        filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "linux.boot");
+
+        history = filesystem.get_version_history(make_path_with_version("/linux.boot", "3"));
+        VERIFY_DATA(history.size(), 2);
+        VERIFY_DATA(history[0].versions, std::vector < snapshot_ver_t >({"2"}));
+        VERIFY_DATA(history[1].versions, std::vector < snapshot_ver_t >({"3"}));
+    }
+
+    {
+        /// instance 4: background COW break after snapshot
+
+        INSTANCE("FILESYSTEM: instance 4: background COW break after snapshot");
+        inode_smi_t filesystem(4);
+        auto cold = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "cold");
+        auto hot = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "hot");
+        filesystem.get_inode_by_id(cold)->write("01234567", 8, 0);
+        filesystem.get_inode_by_id(hot)->write("0123456789abcdef", 16, 0);
+
+        VERIFY_DATA(filesystem.cow_break_pending(), false);
+        filesystem.create_snapshot_volume("1");
+        VERIFY_DATA(filesystem.cow_break_pending(), true);
+
+        // budget is never exceeded, most recently written inode goes first
+        VERIFY_DATA(filesystem.break_cow_step(4), 4);
+        VERIFY_DATA(filesystem.break_cow_step(1), 0);
+        VERIFY_DATA(filesystem.break_cow_step(7), 4);
+        VERIFY_DATA(filesystem.break_cow_step(1024), 8 + 8);
+        VERIFY_DATA(filesystem.cow_break_pending(), false);
+        VERIFY_DATA(filesystem.break_cow_step(1024), 0);
+
+        // snapshot content is untouched by writes to private blocks
+        filesystem.get_inode_by_id(hot)->write("ABCD", 4, 4, false);
+        VERIFY_DATA(filesystem.get_inode_by_id(hot)->to_string("1"), "0123456789abcdef");
+        VERIFY_DATA(filesystem.get_inode_by_id(hot)->to_string(FILESYSTEM_CUR_MODIFIABLE_VER),
+                    "0123ABCD89abcdef");
+
+        // removed inodes are dropped from queue
+        filesystem.create_snapshot_volume("2");
+        filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "hot");
+        VERIFY_DATA(filesystem.break_cow_step(1024), 8);
+
+        // budget below one block per interval is carried over, never spent ahead
+        filesystem.get_inode_by_id(cold)->write("76543210", 8, 0, false);
+        filesystem.create_snapshot_volume("3");
+        htmpfs_size_t credit = 0, granted = 0, copied = 0, intervals = 0;
+        while (filesystem.cow_break_pending())
+        {
+            credit += 3;
+            granted += 3;
+            intervals++;
+            copied += filesystem.break_cow_with_credit(credit);
+            VERIFY_DATA(copied <= granted, true);
+        }
+
+        VERIFY_DATA(copied, 8);
+        VERIFY_DATA(intervals, 3);
+        VERIFY_DATA(credit, 0);
+
+        // nothing pending, credit is not saved up
+        credit = 1024;
+        VERIFY_DATA(filesystem.break_cow_with_credit(credit), 0);
+        VERIFY_DATA(credit, 0);
+
+        filesystem.delete_snapshot_volume("1");
+        filesystem.delete_snapshot_volume("2");
+        filesystem.delete_snapshot_volume("3");
+        VERIFY_DATA(filesystem.get_inode_by_id(cold)->to_string(FILESYSTEM_CUR_MODIFIABLE_VER), "76543210");
+    }
+
     {
         /// mixed operation, verify file content and pathname
 
@@ -52,6 +52,22 @@ bool can_find(const std::vector < std::string > & list, const std::string & val)
     );
 }
 
+/// make a namespace operation under a parent given by inode id
+namespace_op_t make_op(namespace_op_t::operation_t operation, inode_id_t parent_inode_id, const std::string & name,
+                       const inode_stat_t & attributes = { }, const std::string & symlink_target = "")
+{
+    return { .operation = operation, .parent_inode_id = parent_inode_id, .parent_index = namespace_op_t::no_index,
+             .name = name, .symlink_target = symlink_target, .attributes = attributes };
+}
+
+/// make a namespace operation under a directory made earlier by the same batch
+namespace_op_t make_indexed_op(namespace_op_t::operation_t operation, uint64_t parent_index, const std::string & name,
+                               const inode_stat_t & attributes = { })
+{
+    return { .operation = operation, .parent_inode_id = 0, .parent_index = parent_index,
+             .name = name, .symlink_target = "", .attributes = attributes };
+}
+
 int main()
 {
     // generate a huge amount of random data
@@ -324,6 +340,265 @@ int main()
             }
         }
     }
+
+    {
+        /// instance 5: rename, replace, no-replace and exchange
+
+        INSTANCE("FILESYSTEM: instance 5: rename, replace, no-replace and exchange");
+        inode_smi_t filesystem(7);
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        auto usr = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "usr", true);
+        auto conf = filesystem.make_child_dentry_under_parent(etc, "ld.so.conf");
+        auto conf_new = filesystem.make_child_dentry_under_parent(etc, "ld.so.conf.new");
+        auto lib = filesystem.make_child_dentry_under_parent(usr, "lib", true);
+
+        auto verify_error = [&](const std::function < void () > & func, uint32_t code)->bool
+        {
+            try {
+                func();
+                return false;
+            } catch (HTMPFS_error_t & err) {
+                return err.my_errcode() == code;
+            }
+        };
+
+        // rename inside of one directory, replacing target
+        filesystem.rename(etc, "ld.so.conf.new", etc, "ld.so.conf");
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/ld.so.conf"), conf_new);
+        VERIFY_DATA(verify_error([&] { filesystem.get_inode_id_by_path("/etc/ld.so.conf.new"); },
+                                 HTMPFS_NO_SUCH_FILE_OR_DIR), true);
+        VERIFY_DATA(verify_error([&] { filesystem.count_link_for_inode(conf); },
+                                 HTMPFS_REQUESTED_INODE_NOT_FOUND), true);
+
+        // move across directories
+        filesystem.rename(etc, "ld.so.conf", usr, "ld.so.conf");
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/ld.so.conf"), conf_new);
+
+        // failed renames change nothing
+        auto hosts = filesystem.make_child_dentry_under_parent(etc, "hosts");
+        VERIFY_DATA(verify_error([&] { filesystem.rename(usr, "ld.so.conf", usr, "lib"); },
+                                 HTMPFS_IS_A_DIRECTORY), true);
+        VERIFY_DATA(verify_error([&] { filesystem.rename(usr, "lib", etc, "hosts"); },
+                                 HTMPFS_NOT_A_DIRECTORY), true);
+        VERIFY_DATA(verify_error([&] { filesystem.rename(etc, "hosts", usr, "ld.so.conf", RENAME_NOREPLACE); },
+                                 HTMPFS_DOUBLE_MKPATHNAME), true);
+        VERIFY_DATA(verify_error([&] { filesystem.rename(etc, "hosts", usr, "absent", RENAME_EXCHANGE); },
+                                 HTMPFS_NO_SUCH_FILE_OR_DIR), true);
+        VERIFY_DATA(verify_error([&] { filesystem.rename(etc, "absent", usr, "lib"); },
+                                 HTMPFS_NO_SUCH_FILE_OR_DIR), true);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/hosts"), hosts);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/ld.so.conf"), conf_new);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/lib"), lib);
+
+        // replacing a non-empty directory fails
+        auto lib64 = filesystem.make_child_dentry_under_parent(usr, "lib64", true);
+        filesystem.make_child_dentry_under_parent(lib, "libc.so.6");
+        VERIFY_DATA(verify_error([&] { filesystem.rename(usr, "lib64", usr, "lib"); },
+                                 HTMPFS_DIR_NOT_EMPTY), true);
+
+        // exchange
+        filesystem.rename(etc, "hosts", usr, "lib", RENAME_EXCHANGE);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/hosts"), lib);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/etc/hosts/libc.so.6") != 0, true);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/lib"), hosts);
+
+        // rename to itself
+        filesystem.rename(usr, "lib64", usr, "lib64");
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/lib64"), lib64);
+    }
+
+    {
+        /// instance 6: remove a whole tree, snapshot volumes keep their inodes
+
+        INSTANCE("FILESYSTEM: instance 6: remove a whole tree");
+        inode_smi_t filesystem(7);
+        auto verify_error = [&](const std::function < void () > & func, uint32_t code)->bool
+        {
+            try {
+                func();
+                return false;
+            } catch (HTMPFS_error_t & err) {
+                return err.my_errcode() == code;
+            }
+        };
+
+        auto workspace = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "workspace", true);
+        auto kept = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "kept");
+        std::vector < inode_id_t > inodes { workspace };
+        for (int i = 0; i < 10; i++)
+        {
+            auto dir = filesystem.make_child_dentry_under_parent(workspace, "dir" + std::to_string(i), true);
+            auto sub = filesystem.make_child_dentry_under_parent(dir, "sub", true);
+            auto file = filesystem.make_child_dentry_under_parent(sub, "file");
+            filesystem.get_inode_by_id(file)->write("payload", 7, 0);
+            inodes.insert(inodes.end(), { dir, sub, file });
+        }
+
+        filesystem.create_snapshot_volume("1");
+        filesystem.remove_tree(FILESYSTEM_ROOT_INODE_NUMBER, "workspace");
+
+        inode_id_t inode_id;
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/workspace", inode_id), false);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/kept"), kept);
+        VERIFY_DATA(filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size(), 2);
+
+        // snapshot volume still holds the tree
+        auto view = filesystem.pin_snapshot_volume("1");
+        char payload[8] { };
+        view->read(view->get_inode_id_by_path("/workspace/dir3/sub/file"), payload, 7, 0);
+        VERIFY_DATA(std::string(payload), "payload");
+        for (const auto & i : inodes)
+        {
+            VERIFY_DATA(filesystem.count_link_for_inode(i), 1);
+        }
+
+        // inodes are freed with the snapshot volume
+        filesystem.delete_snapshot_volume("1");
+        for (const auto & i : inodes)
+        {
+            VERIFY_DATA(verify_error([&] { filesystem.count_link_for_inode(i); },
+                                     HTMPFS_REQUESTED_INODE_NOT_FOUND), true);
+        }
+
+        // a regular file is removed the same way, absent names fail
+        filesystem.remove_tree(FILESYSTEM_ROOT_INODE_NUMBER, "kept");
+        VERIFY_DATA(verify_error([&] { filesystem.remove_tree(FILESYSTEM_ROOT_INODE_NUMBER, "kept"); },
+                                 HTMPFS_NO_SUCH_FILE_OR_DIR), true);
+        VERIFY_DATA(filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size(), 1);
+    }
+
+    {
+        /// instance 7: deferred block reclamation of unlinked and truncated files
+
+        INSTANCE("FILESYSTEM: instance 7: deferred block reclamation");
+        inode_smi_t filesystem(7);
+        const std::string data = gen_random_data(70);
+        filesystem.set_deferred_reclaim(true);
+
+        auto file = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "file");
+        auto kept = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "kept");
+        filesystem.get_inode_by_id(file)->write(data.c_str(), data.length(), 0);
+        filesystem.get_inode_by_id(kept)->write(data.c_str(), data.length(), 0);
+
+        // truncation drops 7 of 10 blocks, removal drops the rest
+        filesystem.get_inode_by_id(file)->truncate(15);
+        VERIFY_DATA(filesystem.reclaim_pending(), 7);
+        filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "file");
+        VERIFY_DATA(filesystem.reclaim_pending(), 10);
+
+        VERIFY_DATA(filesystem.reclaim_step(4), 4);
+        VERIFY_DATA(filesystem.reclaim_pending(), 6);
+        VERIFY_DATA(filesystem.reclaim_step(100), 6);
+        VERIFY_DATA(filesystem.reclaim_pending(), 0);
+        VERIFY_DATA(filesystem.reclaimed_blocks(), 10);
+
+        // blocks frozen by a snapshot volume stay readable after version 0 drops them
+        filesystem.create_snapshot_volume("1");
+        filesystem.get_inode_by_id(kept)->truncate(0);
+        VERIFY_DATA(filesystem.reclaim_pending(), 10);
+        filesystem.reclaim_step(UINT64_MAX);
+
+        std::string read_back(data.length(), 0);
+        auto view = filesystem.pin_snapshot_volume("1");
+        view->read(kept, read_back.data(), read_back.length(), 0);
+        VERIFY_DATA(read_back, data);
+
+        // turning deferral off reclaims pending blocks at once
+        auto other = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "other");
+        filesystem.get_inode_by_id(other)->write(data.c_str(), data.length(), 0);
+        filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "other");
+
+        // root directory is rewritten by the removal, its dropped blocks are pending as well
+        auto pending = filesystem.reclaim_pending();
+        VERIFY_DATA(pending >= 10, true);
+        filesystem.set_deferred_reclaim(false);
+        VERIFY_DATA(filesystem.reclaim_pending(), 0);
+        VERIFY_DATA(filesystem.reclaimed_blocks(), 20 + pending);
+    }
+
+    {
+        /// instance 8: namespace batch, all or nothing
+
+        INSTANCE("FILESYSTEM: instance 8: namespace batch");
+        inode_smi_t filesystem(7);
+        auto usr = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "usr", true);
+
+        inode_stat_t attributes;
+        attributes.st_mode = 0750;
+        attributes.st_uid = 1000;
+        attributes.st_gid = 100;
+        attributes.st_mtim.tv_sec = 1234;
+
+        std::vector < namespace_op_t > batch;
+        batch.push_back(make_op(namespace_op_t::NAMESPACE_MKDIR, usr, "bin", attributes));
+        for (int i = 0; i < 100; i++)
+        {
+            batch.push_back(make_indexed_op(namespace_op_t::NAMESPACE_CREATE, 0, "tool" + std::to_string(i), attributes));
+        }
+
+        batch.push_back(make_op(namespace_op_t::NAMESPACE_SYMLINK, usr, "sbin", attributes, "bin"));
+        attributes.st_mode = 0644;
+        batch.push_back(make_indexed_op(namespace_op_t::NAMESPACE_SETATTR, 0, "tool7", attributes));
+        batch.push_back(make_op(namespace_op_t::NAMESPACE_SETATTR, FILESYSTEM_ROOT_INODE_NUMBER, "usr", attributes));
+
+        auto sequence = filesystem.get_journal_sequence();
+        auto result = filesystem.apply_namespace_batch(batch);
+        VERIFY_DATA(result.size(), batch.size());
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/bin"), result[0]);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/usr/bin/tool99"), result[100]);
+        VERIFY_DATA(result[102], result[8]);
+        VERIFY_DATA(result[103], usr);
+        VERIFY_DATA(filesystem.get_journal_sequence() > sequence, true);
+
+        auto * bin = filesystem.get_inode_by_id(result[0]);
+        VERIFY_DATA(bin->fs_stat.st_mode, (uint32_t)(S_IFDIR | 0750));
+        VERIFY_DATA(bin->fs_stat.st_uid, 1000);
+        VERIFY_DATA(bin->fs_stat.st_mtim.tv_sec, 1234);
+        VERIFY_DATA(filesystem.get_inode_by_id(result[8])->fs_stat.st_mode, (uint32_t)(S_IFREG | 0644));
+        VERIFY_DATA(filesystem.get_inode_by_id(usr)->fs_stat.st_mode & ~S_IFMT, 0644);
+
+        char target[4] { };
+        auto * sbin = filesystem.get_inode_by_id(result[101]);
+        VERIFY_DATA(sbin->fs_stat.st_mode, (uint32_t)(S_IFLNK | 0750));
+        sbin->read(FILESYSTEM_CUR_MODIFIABLE_VER, target, 3, 0);
+        VERIFY_DATA(std::string(target), "bin");
+
+        // a name taken by the tree fails the whole batch, nothing is made
+        auto inode_count = filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size();
+        std::vector < namespace_op_t > failed {
+                make_op(namespace_op_t::NAMESPACE_MKDIR, usr, "lib"),
+                make_indexed_op(namespace_op_t::NAMESPACE_CREATE, 0, "libc.so"),
+                make_op(namespace_op_t::NAMESPACE_CREATE, result[0], "tool3"),
+        };
+
+        try {
+            filesystem.apply_namespace_batch(failed);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_DOUBLE_MKPATHNAME);
+        }
+
+        inode_id_t inode_id;
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/usr/lib", inode_id), false);
+        VERIFY_DATA(filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size(), inode_count);
+
+        // parent must be an earlier mkdir of the batch
+        failed = {
+                make_indexed_op(namespace_op_t::NAMESPACE_CREATE, 1, "early"),
+                make_op(namespace_op_t::NAMESPACE_MKDIR, usr, "late"),
+        };
+
+        try {
+            filesystem.apply_namespace_batch(failed);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_INVALID_BATCH_OPERATION);
+        }
+
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/usr/late", inode_id), false);
+    }
+
 #endif // CMAKE_BUILD_DEBUG
+
     return EXIT_SUCCESS;
 }
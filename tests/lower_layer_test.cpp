@@ -0,0 +1,213 @@
+/** @file
+ *
+ * This file defines test for lazily populated lower layer
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+/// write a host file
+void write_host_file(const std::string & pathname, const std::string & data)
+{
+    std::ofstream file(pathname, std::ios::binary);
+    file << data;
+}
+
+/// read a host file
+std::string read_host_file(const std::string & pathname)
+{
+    std::ifstream file(pathname, std::ios::binary);
+    return { std::istreambuf_iterator < char > (file), std::istreambuf_iterator < char > () };
+}
+
+/// read all data of a file of a version
+std::string read_file(inode_smi_t & filesystem, const std::string & pathname,
+                      const snapshot_ver_t & version = FILESYSTEM_CUR_MODIFIABLE_VER)
+{
+    auto * inode = filesystem.get_inode_by_id(filesystem.get_inode_id_by_path(pathname));
+    return inode->to_string(version);
+}
+
+int main()
+{
+    char host_root [] = "/tmp/htmpfs_lower_layer.XXXXXX";
+    if (!mkdtemp(host_root))
+    {
+        return EXIT_FAILURE;
+    }
+
+    const std::string root = host_root;
+    std::string large_data(3 * 4096 + 17, 0);
+    for (uint64_t i = 0; i < large_data.length(); i++)
+    {
+        large_data[i] = (char)(i * 131 % 251);
+    }
+
+    mkdir((root + "/usr").c_str(), 0755);
+    mkdir((root + "/usr/bin").c_str(), 0755);
+    mkdir((root + "/usr/lib").c_str(), 0700);
+    mkdir((root + "/opt").c_str(), 0755);
+    mkdir((root + "/opt/unused").c_str(), 0755);
+    write_host_file(root + "/usr/bin/cc", large_data);
+    write_host_file(root + "/usr/bin/ld", "linker");
+    write_host_file(root + "/usr/lib/libc.so", "ELF");
+    write_host_file(root + "/opt/unused/big", large_data);
+    write_host_file(root + "/etc", "host etc");
+    symlink("bin/cc", (root + "/usr/gcc").c_str());
+
+    int ret = EXIT_FAILURE;
+    auto run = [&]()->int
+    {
+        {
+            /// instance 1: dentries and data are read from host on first access
+
+            INSTANCE("LOWER LAYER: instance 1: lazy population");
+            inode_smi_t filesystem(4096);
+            auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc");
+            filesystem.get_inode_by_id(etc)->write("upper etc", 9, 0);
+
+            filesystem.attach_lower_layer(root);
+            VERIFY_DATA(filesystem.lower_layer_pending(), 1);
+
+            // root is listed, its subdirectories are not
+            inode_id_t inode_id;
+            VERIFY_DATA(filesystem.try_get_inode_id_by_path("/missing", inode_id), false);
+            VERIFY_DATA(filesystem.lower_layer_pending(), 2 /* usr and opt, etc is shadowed */);
+            VERIFY_DATA(read_file(filesystem, "/etc"), "upper etc");
+
+            // file data is read from host, no block is made
+            auto * cc = filesystem.get_inode_by_id(filesystem.get_inode_id_by_path("/usr/bin/cc"));
+            VERIFY_DATA(cc->current_data_size(FILESYSTEM_CUR_MODIFIABLE_VER), large_data.length());
+            VERIFY_DATA(cc->to_string(FILESYSTEM_CUR_MODIFIABLE_VER), large_data);
+            char buffer [16];
+            VERIFY_DATA(cc->read(FILESYSTEM_CUR_MODIFIABLE_VER, buffer, sizeof(buffer), 4096 * 3 + 10), 7);
+            VERIFY_DATA(std::string(buffer, 7), large_data.substr(4096 * 3 + 10));
+            VERIFY_DATA(filesystem.lower_layer_pending(), 5 /* opt, lib, gcc, cc, ld */);
+            VERIFY_DATA((cc->fs_stat.st_mode & 07777), 0644);
+
+            auto * gcc = filesystem.get_inode_by_id(filesystem.get_inode_id_by_path("/usr/gcc"));
+            VERIFY_DATA(S_ISLNK(gcc->fs_stat.st_mode), true);
+            VERIFY_DATA(gcc->to_string(FILESYSTEM_CUR_MODIFIABLE_VER), "bin/cc");
+            VERIFY_DATA((filesystem.get_inode_by_id(
+                    filesystem.get_inode_id_by_path("/usr/lib"))->fs_stat.st_mode & 07777), 0700);
+
+            // written file is copied up, host is left untouched
+            cc->write("CC", 2, 4096 + 1, false);
+            VERIFY_DATA(filesystem.lower_layer_pending(), 4 /* opt, gcc, ld, libc.so */);
+            VERIFY_DATA(cc->to_string(FILESYSTEM_CUR_MODIFIABLE_VER),
+                        large_data.substr(0, 4097) + "CC" + large_data.substr(4099));
+            VERIFY_DATA(read_host_file(root + "/usr/bin/cc"), large_data);
+
+            // truncated file copies only what is kept
+            auto * ld = filesystem.get_inode_by_id(filesystem.get_inode_id_by_path("/usr/bin/ld"));
+            ld->truncate(3);
+            VERIFY_DATA(ld->to_string(FILESYSTEM_CUR_MODIFIABLE_VER), "lin");
+            ld->truncate(0);
+            VERIFY_DATA(read_host_file(root + "/usr/bin/ld"), "linker");
+
+            // directories on host are no longer seen once removed
+            filesystem.remove_tree(FILESYSTEM_ROOT_INODE_NUMBER, "opt");
+            VERIFY_DATA(filesystem.try_get_inode_id_by_path("/opt/unused", inode_id), false);
+
+            // non-empty directory of host is not empty in version 0 either
+            try {
+                filesystem.remove_child_dentry_under_parent(filesystem.get_inode_id_by_path("/usr"), "lib");
+                return EXIT_FAILURE;
+            } catch (HTMPFS_error_t & err) {
+                VERIFY_DATA(err.my_errcode(), HTMPFS_DIR_NOT_EMPTY);
+            }
+
+            // renamed inode keeps reading its host file
+            auto lib = filesystem.get_inode_id_by_path("/usr/lib");
+            filesystem.rename(lib, "libc.so", FILESYSTEM_ROOT_INODE_NUMBER, "libc.so");
+            VERIFY_DATA(read_file(filesystem, "/libc.so"), "ELF");
+
+            // removing a file on lower layer forgets it
+            auto pending = filesystem.lower_layer_pending();
+            filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "libc.so");
+            VERIFY_DATA(filesystem.lower_layer_pending(), pending - 1);
+        }
+
+        {
+            /// instance 2: snapshot volume maps files left on host instead of copying them
+
+            INSTANCE("LOWER LAYER: instance 2: snapshot volume");
+            inode_smi_t filesystem(4096);
+            filesystem.attach_lower_layer(root);
+            filesystem.create_snapshot_volume("1");
+            VERIFY_DATA(filesystem.lower_layer_pending(), 0);
+
+            VERIFY_DATA(read_file(filesystem, "/.snapshot/1/opt/unused/big", "1"), large_data);
+            VERIFY_DATA(read_file(filesystem, "/.snapshot/1/usr/gcc", "1"), "bin/cc");
+
+            auto view = filesystem.pin_snapshot_volume("1");
+            char payload [8] { };
+            view->read(view->get_inode_id_by_path("/usr/bin/ld"), payload, 6, 0);
+            VERIFY_DATA(std::string(payload), "linker");
+
+            // version 0 keeps working after host is gone
+            unlink((root + "/usr/bin/ld").c_str());
+            VERIFY_DATA(read_file(filesystem, "/usr/bin/ld"), "linker");
+
+            // written file gets private blocks, snapshot volume and host keep mapped data
+            auto * cc = filesystem.get_inode_by_id(filesystem.get_inode_id_by_path("/usr/bin/cc"));
+            cc->write("CC", 2, 4096 + 1, false);
+            VERIFY_DATA(read_file(filesystem, "/usr/bin/cc"),
+                        large_data.substr(0, 4097) + "CC" + large_data.substr(4099));
+            VERIFY_DATA(read_file(filesystem, "/.snapshot/1/usr/bin/cc", "1"), large_data);
+            VERIFY_DATA(read_host_file(root + "/usr/bin/cc"), large_data);
+
+            // data is not copied, host is changed here only to show it is read in place
+            {
+                std::fstream big(root + "/opt/unused/big", std::ios::binary | std::ios::in | std::ios::out);
+                big.seekp(4096 * 2);
+                big << "in place";
+            }
+
+            auto changed = large_data;
+            changed.replace(4096 * 2, 8, "in place");
+            VERIFY_DATA(read_file(filesystem, "/.snapshot/1/opt/unused/big", "1"), changed);
+        }
+
+        {
+            /// instance 3: attaching what cannot be a lower layer
+
+            INSTANCE("LOWER LAYER: instance 3: invalid lower layer");
+            inode_smi_t filesystem(4096);
+
+            try {
+                filesystem.attach_lower_layer(root + "/etc");
+                return EXIT_FAILURE;
+            } catch (HTMPFS_error_t & err) {
+                VERIFY_DATA(err.my_errcode(), HTMPFS_NOT_A_DIRECTORY);
+            }
+
+            try {
+                filesystem.attach_lower_layer(root + "/missing");
+                return EXIT_FAILURE;
+            } catch (HTMPFS_error_t & err) {
+                VERIFY_DATA(err.my_errcode(), HTMPFS_LOWER_LAYER_ERROR);
+            }
+
+            VERIFY_DATA(filesystem.lower_layer_pending(), 0);
+        }
+
+        return EXIT_SUCCESS;
+    };
+
+    try {
+        ret = run();
+    } catch (std::exception & err) {
+        std::cerr << err.what() << std::endl;
+    }
+
+    system(("rm -rf " + root).c_str());
+    return ret;
+}
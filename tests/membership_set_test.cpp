@@ -0,0 +1,93 @@
+/** @file
+ *
+ * This file defines test for per-version inode membership
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/membership_set.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+int main()
+{
+    {
+        /// instance 1: insertion, removal and ordered iteration
+
+        INSTANCE("MEMBERSHIP SET: instance 1: insertion, removal and ordered iteration");
+        membership_set_t set;
+
+        VERIFY_DATA(set.insert(70000), true);
+        VERIFY_DATA(set.insert(3), true);
+        VERIFY_DATA(set.insert(64), true);
+        VERIFY_DATA(set.insert(3), false);
+        VERIFY_DATA(set.size(), 3);
+        VERIFY_DATA(set.contains(64), true);
+        VERIFY_DATA(set.contains(65), false);
+        VERIFY_DATA(set.contains(1ULL << 31), false);
+
+        VERIFY_DATA(set.erase(64), true);
+        VERIFY_DATA(set.erase(64), false);
+
+        std::vector < uint64_t > members;
+        set.for_each([&](uint64_t index) { members.emplace_back(index); });
+        VERIFY_DATA(members, std::vector < uint64_t > ({ 3, 70000 }));
+    }
+
+    {
+        /// instance 2: copies are independent
+
+        INSTANCE("MEMBERSHIP SET: instance 2: copies are independent");
+        membership_set_t current;
+        for (uint64_t i = 0; i < 10000; i++)
+        {
+            current.insert(i);
+        }
+
+        auto snapshot = current;
+        current.erase(5);
+        current.insert(20000);
+        snapshot.erase(6);
+
+        VERIFY_DATA(current.contains(5), false);
+        VERIFY_DATA(current.contains(6), true);
+        VERIFY_DATA(current.contains(20000), true);
+        VERIFY_DATA(snapshot.contains(5), true);
+        VERIFY_DATA(snapshot.contains(6), false);
+        VERIFY_DATA(snapshot.contains(20000), false);
+        VERIFY_DATA(current.size(), 10000);
+        VERIFY_DATA(snapshot.size(), 9999);
+    }
+
+    {
+        /// instance 3: removing a large tree keeps snapshot membership intact
+
+        INSTANCE("MEMBERSHIP SET: instance 3: removing a large tree keeps snapshot membership intact");
+        inode_smi_t filesystem(4096);
+        auto dir = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "node_modules", true);
+        for (int i = 0; i < 20000; i++)
+        {
+            filesystem.make_child_dentry_under_parent(dir, "index" + std::to_string(i) + ".js");
+        }
+
+        filesystem.create_snapshot_volume("1");
+
+        for (int i = 0; i < 20000; i++)
+        {
+            filesystem.remove_child_dentry_under_parent(dir, "index" + std::to_string(i) + ".js");
+        }
+        filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "node_modules");
+
+        VERIFY_DATA(filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size(), 1);
+        VERIFY_DATA(filesystem._snapshot_version_list.at("1").size(), 20002);
+        VERIFY_DATA(filesystem.export_as_filesystem_map(FILESYSTEM_CUR_MODIFIABLE_VER).empty(), true);
+
+        filesystem.delete_snapshot_volume("1");
+        filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "node_modules", true);
+        VERIFY_DATA(filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size(), 2);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+/** @file
+ *
+ * This file defines test for interned dentry names
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/name_table.h>
+#include <iostream>
+#include <string>
+#include <cstring>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+int main()
+{
+    {
+        /// instance 1: interning, reference counting and id reuse
+
+        INSTANCE("NAME TABLE: instance 1: interning, reference counting and id reuse");
+        name_table_t name_table;
+
+        auto makefile = name_table.intern("Makefile");
+        auto readme = name_table.intern("README");
+        VERIFY_DATA(name_table.intern("Makefile"), makefile);
+        VERIFY_DATA(makefile != readme, true);
+        VERIFY_DATA(name_table.size(), 2);
+        VERIFY_DATA(name_table.find("Makefile"), makefile);
+        VERIFY_DATA(name_table.find("makefile"), name_table_t::no_name);
+        VERIFY_DATA(name_table.get(readme), "README");
+        VERIFY_DATA(strcmp(name_table.c_str(readme), "README"), 0);
+
+        // Makefile is referenced twice
+        name_table.unlink(makefile);
+        VERIFY_DATA(name_table.find("Makefile"), makefile);
+        name_table.unlink(makefile);
+        VERIFY_DATA(name_table.find("Makefile"), name_table_t::no_name);
+        VERIFY_DATA(name_table.size(), 1);
+
+        // id of a dropped name is reused
+        VERIFY_DATA(name_table.intern("index.js"), makefile);
+        VERIFY_DATA(name_table.get(makefile), "index.js");
+    }
+
+    {
+        /// instance 2: directories share names, names are dropped with their last dentry
+
+        INSTANCE("NAME TABLE: instance 2: directories share names, names are dropped with their last dentry");
+        inode_smi_t filesystem(16);
+        auto & name_table = filesystem.get_name_table();
+        const auto names_of_empty_filesystem = name_table.size();
+
+        for (int i = 0; i < 100; i++)
+        {
+            auto dir = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER,
+                                                                 "dir" + std::to_string(i), true);
+            filesystem.make_child_dentry_under_parent(dir, "Makefile");
+            filesystem.make_child_dentry_under_parent(dir, "__init__.py");
+        }
+
+        VERIFY_DATA(name_table.size(), names_of_empty_filesystem + 102);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/dir42/Makefile") != FILESYSTEM_ROOT_INODE_NUMBER, true);
+
+        // a snapshot shares names with version 0
+        filesystem.create_snapshot_volume("1");
+        VERIFY_DATA(name_table.size(), names_of_empty_filesystem + 102);
+
+        for (int i = 0; i < 100; i++)
+        {
+            auto dir = filesystem.get_inode_id_by_path("/dir" + std::to_string(i));
+            filesystem.remove_child_dentry_under_parent(dir, "Makefile");
+            filesystem.remove_child_dentry_under_parent(dir, "__init__.py");
+            filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "dir" + std::to_string(i));
+        }
+
+        VERIFY_DATA(name_table.size(), names_of_empty_filesystem);
+
+        // names of version 0 are gone, snapshot still resolves its own
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/.snapshot/1/dir42/Makefile")
+                    != FILESYSTEM_ROOT_INODE_NUMBER, true);
+        inode_id_t inode_id;
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/dir42/Makefile", inode_id), false);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -4,6 +4,8 @@
  */
 
 #include <htmpfs/path_t.h>
+#include <htmpfs_error.h>
+#include <uni_utils.h>
 #include <string>
 #include <iostream>
 #include <debug.h>
@@ -51,5 +53,48 @@ int main(int argc, char ** argv)
         VERIFY_DATA(path2.to_string(), "/etc");
     }
 
+    {
+        /// instance 5: component views
+
+        INSTANCE("PATH_T: instance 5: component views");
+        const char * pathname = "//usr/bin//bash/";
+        std::vector < std::string > list ({"usr", "bin", "bash"});
+
+        int off = 0;
+        for (const auto & i : path_view_t(pathname))
+        {
+            VERIFY_DATA(i, list[off++]);
+        }
+        VERIFY_DATA(off, 3);
+        VERIFY_DATA(path_view_t("/").empty(), true);
+        VERIFY_DATA(path_view_t("").empty(), true);
+    }
+
+    {
+        /// instance 6: snapshot prefix
+
+        INSTANCE("PATH_T: instance 6: snapshot prefix");
+        std::string_view version, pathname;
+        VERIFY_DATA(parse_snapshot_prefix("/etc/X11", version, pathname), false);
+        VERIFY_DATA(pathname, "/etc/X11");
+        VERIFY_DATA(parse_snapshot_prefix("/.snapshot/1/etc/X11", version, pathname), true);
+        VERIFY_DATA(version, "1");
+        VERIFY_DATA(pathname, "/etc/X11");
+        VERIFY_DATA(parse_snapshot_prefix("/.snapshot/1", version, pathname), true);
+        VERIFY_DATA(pathname, "");
+        VERIFY_DATA(parse_snapshot_prefix("/.snapshots/1", version, pathname), false);
+
+        try {
+            parse_snapshot_prefix("/.snapshot/", version, pathname);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_INVALID_DENTRY_NAME);
+        }
+
+        std::string output;
+        VERIFY_DATA(if_snapshot("/.snapshot//1//etc/X11", output), "1");
+        VERIFY_DATA(output, "/etc/X11");
+    }
+
     return EXIT_SUCCESS;
 }
@@ -21,7 +21,7 @@ int main(int argc, char ** argv)
         /// instance 1: bare write, resize enabled, no offset, no snapshot
 
         INSTANCE("INODE: instance 1: bare write, resize enabled, no offset, no snapshot");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA(inode, "123456789");
     }
@@ -30,7 +30,7 @@ int main(int argc, char ** argv)
         /// instance 2: bare write, resize enabled, no offset, check snapshot
 
         INSTANCE("INODE: instance 2: bare write, resize enabled, no offset, check snapshot");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_VER(inode, "1", "123456789");
@@ -40,7 +40,7 @@ int main(int argc, char ** argv)
         /// instance 3: bare write, resize enabled, no offset, enable snapshot, modify root
 
         INSTANCE("INODE: instance 3: bare write, resize enabled, no offset, enable snapshot, modify root");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 8), 2);
@@ -53,7 +53,7 @@ int main(int argc, char ** argv)
         /// instance 4: bare write, resize enabled, with offset, enable snapshot multiple times, modify root
 
         INSTANCE("INODE: instance 4: bare write, resize enabled, with offset, enable snapshot multiple times, modify root");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 8), 2);
@@ -69,7 +69,7 @@ int main(int argc, char ** argv)
         /// instance 5: bare write, resize enabled, with offset, snapshot causes grow size
 
         INSTANCE("INODE: instance 5: bare write, resize enabled, with offset, snapshot causes grow size");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
 
         inode.write("1", 1, 0);
         inode.create_new_volume("1");
@@ -84,7 +84,7 @@ int main(int argc, char ** argv)
         /// instance 6: bare write, shortage, resize enabled, with offset
 
         INSTANCE("INODE: instance 6: bare write, shortage, resize enabled, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 2), 2);
@@ -98,7 +98,7 @@ int main(int argc, char ** argv)
         /// instance 7: bare write, shortage, resize enabled, with offset, middle modify
 
         INSTANCE("INODE: instance 7: bare write, shortage, resize enabled, with offset, middle modify");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_OPS_LEN(inode.write("987654321", 9, 0), 9);
@@ -111,7 +111,7 @@ int main(int argc, char ** argv)
         /// instance 8: bare write, shortage, resize disabled, without offset
 
         INSTANCE("INODE: instance 8: bare write, shortage, resize disabled, without offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 0, false), 2);
@@ -123,7 +123,7 @@ int main(int argc, char ** argv)
         /// instance 9: bare write, extended, resize disabled, without offset
 
         INSTANCE("INODE: instance 9: bare write, extended, resize disabled, without offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
         VERIFY_DATA_OPS_LEN(inode.write("0000000123456", 13, 0, false), 9);
@@ -134,7 +134,7 @@ int main(int argc, char ** argv)
         /// instance 10: bare read, bank size shortage, with offset
 
         INSTANCE("INODE: instance 10: bare read, bank size shortage, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         char buff[512]{};
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
@@ -146,7 +146,7 @@ int main(int argc, char ** argv)
         /// instance 11: bare read, bank size shortage, with offset
 
         INSTANCE("INODE: instance 11: bare read, bank size shortage, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         char buff[512]{};
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         inode.create_new_volume("1");
@@ -166,7 +166,7 @@ int main(int argc, char ** argv)
         /// instance 12: bare write, resize enabled, no offset, delete snapshot volume
 
         INSTANCE("INODE: instance 12: bare write, resize enabled, no offset, delete snapshot volume");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
 
         inode.write("123456789", 9, 0);
         inode.create_new_volume("1");
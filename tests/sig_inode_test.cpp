@@ -14,13 +14,13 @@
 
 int main(int argc, char ** argv)
 {
-    inode_smi_t filesystem(4);
+    inode_smi_t filesystem(2);
 
     {
         /// instance 1: bare write, resize enabled, no offset
 
         INSTANCE("INODE: instance 1: bare write, resize enabled, no offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA(inode, "123456789");
     }
@@ -29,7 +29,7 @@ int main(int argc, char ** argv)
         /// instance 2: bare write, extended, resize enabled, with offset
 
         INSTANCE("INODE: instance 2: bare write, extended, resize enabled, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 8), 2);
         VERIFY_DATA(inode, "1234567810");
@@ -39,7 +39,7 @@ int main(int argc, char ** argv)
         /// instance 3: bare write, shortage, resize enabled, without offset
 
         INSTANCE("INODE: instance 3: bare write, shortage, resize enabled, without offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 0), 2);
         VERIFY_DATA(inode, "10");
@@ -49,7 +49,7 @@ int main(int argc, char ** argv)
         /// instance 4: bare write, shortage, resize enabled, with offset
 
         INSTANCE("INODE: instance 4: bare write, shortage, resize enabled, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 2), 2);
         VERIFY_DATA(inode, "1210");
@@ -59,7 +59,7 @@ int main(int argc, char ** argv)
         /// instance 5: bare write, shortage, resize disabled, without offset
 
         INSTANCE("INODE: instance 5: bare write, shortage, resize disabled, without offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 0, false), 2);
         VERIFY_DATA(inode, "103456789");
@@ -69,7 +69,7 @@ int main(int argc, char ** argv)
         /// instance 6: bare write, shortage, resize disabled, with offset
 
         INSTANCE("INODE: instance 6: bare write, shortage, resize disabled, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("10", 2, 2, false), 2);
         VERIFY_DATA(inode, "121056789");
@@ -79,7 +79,7 @@ int main(int argc, char ** argv)
         /// instance 7: bare write, extended, resize disabled, without offset
 
         INSTANCE("INODE: instance 7: bare write, extended, resize disabled, without offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("0000000123456", 13, 0, false), 9);
         VERIFY_DATA(inode, "000000012");
@@ -89,7 +89,7 @@ int main(int argc, char ** argv)
         /// instance 8: bare write, extended, resize disabled, with offset
 
         INSTANCE("INODE: instance 8: bare write, extended, resize disabled, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.write("12345678910", 11, 5, false), 4);
         VERIFY_DATA(inode, "123451234");
@@ -99,7 +99,7 @@ int main(int argc, char ** argv)
         /// instance 9: bare write, offset > bank size, resize disabled
 
         INSTANCE("INODE: instance 9: bare write, offset > bank size, resize disabled");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 12, false), 0);
     }
 
@@ -107,7 +107,7 @@ int main(int argc, char ** argv)
         /// instance 10: bare read
 
         INSTANCE("INODE: instance 10: bare read");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         char buff[512]{};
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.read(FILESYSTEM_CUR_MODIFIABLE_VER, buff, 9, 0), 9);
@@ -118,7 +118,7 @@ int main(int argc, char ** argv)
         /// instance 11: bare read, bank size shortage, without offset
 
         INSTANCE("INODE: instance 11: bare read, bank size shortage, without offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         char buff[512]{};
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.read(FILESYSTEM_CUR_MODIFIABLE_VER, buff, sizeof(buff), 0), 9);
@@ -129,7 +129,7 @@ int main(int argc, char ** argv)
         /// instance 12: bare read, bank size shortage, with offset
 
         INSTANCE("INODE: instance 12: bare read, bank size shortage, with offset");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         char buff[512]{};
         VERIFY_DATA_OPS_LEN(inode.write("123456789", 9, 0), 9);
         VERIFY_DATA_OPS_LEN(inode.read(FILESYSTEM_CUR_MODIFIABLE_VER, buff, sizeof(buff), 3), 6);
@@ -140,7 +140,7 @@ int main(int argc, char ** argv)
         /// instance 12: bare read, offset > bank size
 
         INSTANCE("INODE: instance 13: bare read, offset > bank size");
-        inode_t inode(2, 0, &filesystem);
+        inode_t inode(0, &filesystem);
         VERIFY_DATA_OPS_LEN(inode.read(FILESYSTEM_CUR_MODIFIABLE_VER, nullptr, 9, 12), 0);
     }
 
@@ -148,7 +148,7 @@ int main(int argc, char ** argv)
         /// instance 14: invalid write access
 
         INSTANCE("INODE: instance 14: invalid write access");
-        inode_t inode(2, 0, &filesystem, true);
+        inode_t inode(0, &filesystem, true);
 
         try
         {
@@ -168,7 +168,7 @@ int main(int argc, char ** argv)
 
         inode_smi_t _filesystem(2);
         INSTANCE("INODE: instance 15: resize manually");
-        inode_t inode(2, 0, &_filesystem, false);
+        inode_t inode(0, &_filesystem, false);
 
         inode.write("123456789", 9, 0);
         inode.truncate(3);
@@ -185,7 +185,7 @@ int main(int argc, char ** argv)
 
         inode_smi_t _filesystem(32 * 1024);
         INSTANCE("INODE: instance 16: resize manually, large bank size");
-        inode_t inode(32 * 1024, 0, &_filesystem, false);
+        inode_t inode(0, &_filesystem, false);
 
         inode.write("123456789", 9, 0);
         inode.truncate(3);
@@ -202,7 +202,7 @@ int main(int argc, char ** argv)
 
         inode_smi_t _filesystem(32 * 1024);
         INSTANCE("INODE: instance 17: resize to 0, append data");
-        inode_t inode(32 * 1024, 0, &_filesystem, false);
+        inode_t inode(0, &_filesystem, false);
 
         inode.write("123456789", 9, 0);
         inode.truncate(0);
@@ -215,5 +215,18 @@ int main(int argc, char ** argv)
         }
     }
 
+    {
+        /// instance 18: memory footprint of an inode
+
+        INSTANCE("INODE: instance 18: memory footprint of an inode");
+        std::cout << "bytes per inode: " << inode_smi_t::bytes_per_inode() << std::endl;
+
+        // regression ceiling, raise it only on purpose
+        if (inode_smi_t::bytes_per_inode() > 184)
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,109 @@
+/** @file
+ *
+ * This file defines test for slot map
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/slot_map.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+int main()
+{
+    {
+        /// instance 1: allocation, lookup and stale id rejection
+
+        INSTANCE("SLOT MAP: instance 1: allocation, lookup and stale id rejection");
+        slot_map_t < std::string > slot_map;
+
+        VERIFY_DATA(slot_map.next_id(), 0);
+        auto first = slot_map.emplace("first");
+        auto second = slot_map.emplace("second");
+        VERIFY_DATA(first, 0);
+        VERIFY_DATA(second, 1);
+        VERIFY_DATA(slot_map.size(), 2);
+        VERIFY_DATA(*slot_map.find(first), "first");
+        VERIFY_DATA(slot_map.at(second), "second");
+
+        slot_map.erase(first);
+        VERIFY_DATA(slot_map.size(), 1);
+        VERIFY_DATA(slot_map.find(first), nullptr);
+
+        // slot is reused, but with a new generation
+        auto third = slot_map.emplace("third");
+        VERIFY_DATA(third & 0xFFFFFFFF, first);
+        VERIFY_DATA(third != first, true);
+        VERIFY_DATA(slot_map.find(first), nullptr);
+        VERIFY_DATA(*slot_map.find(third), "third");
+
+        // erasing a stale id changes nothing
+        slot_map.erase(first);
+        VERIFY_DATA(slot_map.size(), 2);
+        VERIFY_DATA(*slot_map.find(third), "third");
+
+        try {
+            (void)slot_map.at(first);
+            return EXIT_FAILURE;
+        } catch (std::out_of_range &) {
+        }
+
+        VERIFY_DATA(slot_map.find(1024), nullptr);
+    }
+
+    {
+        /// instance 2: objects never move across chunk growth
+
+        INSTANCE("SLOT MAP: instance 2: objects never move across chunk growth");
+        slot_map_t < std::string > slot_map;
+        std::vector < uint64_t > ids;
+        std::vector < std::string * > addresses;
+
+        for (int i = 0; i < 5000; i++)
+        {
+            auto id = slot_map.emplace(std::to_string(i));
+            ids.emplace_back(id);
+            addresses.emplace_back(slot_map.find(id));
+        }
+
+        for (int i = 0; i < 5000; i += 2)
+        {
+            slot_map.erase(ids[i]);
+        }
+
+        for (int i = 0; i < 2500; i++)
+        {
+            slot_map.emplace("refill");
+        }
+
+        VERIFY_DATA(slot_map.size(), 5000);
+        for (int i = 1; i < 5000; i += 2)
+        {
+            VERIFY_DATA(slot_map.find(ids[i]), addresses[i]);
+            VERIFY_DATA(*addresses[i], std::to_string(i));
+        }
+    }
+
+    {
+        /// instance 3: inode ids of removed files are never resolved again
+
+        INSTANCE("SLOT MAP: instance 3: inode ids of removed files are never resolved again");
+        inode_smi_t filesystem(7);
+        auto conf = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "Xorg.conf");
+        filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "Xorg.conf");
+        auto x11 = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "X11");
+        VERIFY_DATA(x11 != conf, true);
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/X11"), x11);
+
+        try {
+            (void)filesystem.get_inode_by_id(conf);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_REQUESTED_INODE_NOT_FOUND);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
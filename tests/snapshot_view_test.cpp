@@ -0,0 +1,251 @@
+/** @file
+ *
+ * This file defines test for immutable snapshot views
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/snapshot_view.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstring>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+int main()
+{
+    const std::string data = "Section \"Device\"\n\tIdentifier \"nvidia\"\nEndSection\n";
+
+    {
+        /// instance 1: view is not affected by changes in version 0
+
+        INSTANCE("SNAPSHOT VIEW: instance 1: view is not affected by changes in version 0");
+        inode_smi_t filesystem(7);
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        auto conf = filesystem.make_child_dentry_under_parent(etc, "Xorg.conf");
+        filesystem.get_inode_by_id(conf)->write(data.c_str(), data.length(), 0);
+
+        filesystem.create_snapshot_volume("1");
+        filesystem.get_inode_by_id(conf)->write("overwritten", 11, 3);
+        filesystem.make_child_dentry_under_parent(etc, "X11", true);
+
+        auto view = filesystem.pin_snapshot_volume("1");
+        auto view_conf = view->get_inode_id_by_path("/etc/Xorg.conf");
+        VERIFY_DATA(view_conf, conf);
+        VERIFY_DATA(view->data_size(view_conf), data.length());
+
+        int dentry_count = 0;
+        view->readdir(etc, [&](const char *, inode_id_t) { dentry_count++; });
+        VERIFY_DATA(dentry_count, 1);
+
+        std::string read_back(data.length(), 0);
+        VERIFY_DATA(view->read(view_conf, read_back.data(), read_back.length(), 0), data.length());
+        VERIFY_DATA(read_back, data);
+
+        try {
+            (void)view->get_inode_id_by_path("/etc/X11");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+    }
+
+    {
+        /// instance 2: pinned view survives snapshot deletion
+
+        INSTANCE("SNAPSHOT VIEW: instance 2: pinned view survives snapshot deletion");
+        inode_smi_t filesystem(7);
+        auto conf = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "Xorg.conf");
+        filesystem.get_inode_by_id(conf)->write(data.c_str(), data.length(), 0);
+        filesystem.create_snapshot_volume("1");
+
+        {
+            auto view = filesystem.pin_snapshot_volume("1");
+            filesystem.delete_snapshot_volume("1");
+            filesystem.remove_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "Xorg.conf");
+
+            std::string read_back(data.length(), 0);
+            view->read(view->get_inode_id_by_path("/Xorg.conf"), read_back.data(), read_back.length(), 0);
+            VERIFY_DATA(read_back, data);
+        }
+
+        try {
+            filesystem.pin_snapshot_volume("1");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_SNAPSHOT);
+        }
+    }
+
+    {
+        /// instance 3: concurrent readers while version 0 and snapshot list are being modified
+
+        INSTANCE("SNAPSHOT VIEW: instance 3: concurrent readers while version 0 is being modified");
+        inode_smi_t filesystem(7);
+        auto conf = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "Xorg.conf");
+        filesystem.get_inode_by_id(conf)->write(data.c_str(), data.length(), 0);
+        filesystem.create_snapshot_volume("1");
+
+        std::atomic < bool > stop { false };
+        std::atomic < uint64_t > mismatch { 0 };
+        std::vector < std::thread > readers;
+
+        for (int i = 0; i < 4; i++)
+        {
+            readers.emplace_back([&]
+            {
+                std::string read_back(data.length(), 0);
+                while (!stop)
+                {
+                    auto view = filesystem.pin_snapshot_volume("1");
+                    view->read(view->get_inode_id_by_path("/Xorg.conf"),
+                               read_back.data(), read_back.length(), 0);
+                    if (read_back != data)
+                    {
+                        mismatch++;
+                    }
+                }
+            });
+        }
+
+        // writer: modify version 0 and create/delete other snapshots
+        for (int i = 0; i < 200; i++)
+        {
+            filesystem.get_inode_by_id(conf)->write("modified", 8, i % 16);
+            filesystem.create_snapshot_volume("tmp");
+            filesystem.delete_snapshot_volume("tmp");
+        }
+
+        stop = true;
+        for (auto & i : readers)
+        {
+            i.join();
+        }
+
+        VERIFY_DATA(mismatch.load(), 0);
+    }
+
+    {
+        /// instance 4: epoch reclamation waits for pinned readers
+
+        INSTANCE("SNAPSHOT VIEW: instance 4: epoch reclamation waits for pinned readers");
+        epoch_domain_t domain;
+        bool reclaimed = false;
+
+        {
+            auto guard = domain.pin();
+            domain.retire([&] { reclaimed = true; });
+            domain.collect();
+            VERIFY_DATA(reclaimed, false);
+            VERIFY_DATA(domain.pending(), 1);
+        }
+
+        domain.collect();
+        VERIFY_DATA(reclaimed, true);
+        VERIFY_DATA(domain.pending(), 0);
+    }
+
+    {
+        /// instance 5: sealed view serves the same content as the unsealed one
+
+        INSTANCE("SNAPSHOT VIEW: instance 5: sealed view serves the same content");
+        inode_smi_t filesystem(7);
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        std::vector < inode_id_t > files;
+        for (int i = 0; i < 200; i++)
+        {
+            auto file = filesystem.make_child_dentry_under_parent(etc, "file" + std::to_string(i));
+            filesystem.get_inode_by_id(file)->write(data.c_str(), data.length(), i);
+            files.emplace_back(file);
+        }
+
+        filesystem.create_snapshot_volume("1");
+        auto unsealed = filesystem.pin_snapshot_volume("1");
+        VERIFY_DATA(unsealed->is_sealed(), false);
+
+        filesystem.seal_snapshot_volume("1");
+        filesystem.seal_snapshot_volume("1");
+        auto sealed = filesystem.pin_snapshot_volume("1");
+        VERIFY_DATA(sealed->is_sealed(), true);
+
+        std::vector < std::string > unsealed_names, sealed_names;
+        unsealed->readdir(etc, [&](const char * name, inode_id_t) { unsealed_names.emplace_back(name); });
+        sealed->readdir(etc, [&](const char * name, inode_id_t) { sealed_names.emplace_back(name); });
+        VERIFY_DATA(sealed_names, unsealed_names);
+
+        for (int i = 0; i < 200; i++)
+        {
+            auto path = "/etc/file" + std::to_string(i);
+            auto inode_id = sealed->get_inode_id_by_path(path);
+            VERIFY_DATA(inode_id, files[i]);
+            VERIFY_DATA(sealed->data_size(inode_id), data.length() + i);
+            VERIFY_DATA(sealed->get_stat(inode_id).st_size, unsealed->get_stat(inode_id).st_size);
+            VERIFY_DATA(sealed->is_dentry(inode_id), false);
+
+            std::string sealed_data(data.length() + i, 0), unsealed_data(data.length() + i, 0);
+            sealed->read(inode_id, sealed_data.data(), sealed_data.length(), 0);
+            unsealed->read(inode_id, unsealed_data.data(), unsealed_data.length(), 0);
+            VERIFY_DATA(sealed_data, unsealed_data);
+        }
+
+        inode_id_t inode_id = 0;
+        VERIFY_DATA(sealed->try_get_inode_id_by_path("/etc/file200", inode_id), false);
+        VERIFY_DATA(unsealed->try_get_inode_id_by_path("/etc/file200", inode_id), false);
+        VERIFY_DATA(sealed->try_get_inode_id_by_path("/etc/file199", inode_id), true);
+        VERIFY_DATA(inode_id, files[199]);
+
+        try {
+            (void)sealed->get_inode_id_by_path("/etc/file200");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NO_SUCH_FILE_OR_DIR);
+        }
+
+        try {
+            (void)sealed->get_inode_id_by_path("/etc/file0/file1");
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NOT_A_DIRECTORY);
+        }
+    }
+
+    {
+        /// instance 6: view deleted while pinned is collected once its reader leaves
+
+        INSTANCE("SNAPSHOT VIEW: instance 6: view deleted while pinned is collected after unpin");
+        inode_smi_t filesystem(7);
+        auto conf = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "Xorg.conf");
+        filesystem.get_inode_by_id(conf)->write(data.c_str(), data.length(), 0);
+        const auto blocks_before_snapshot = filesystem.block_count();
+
+        filesystem.create_snapshot_volume("1");
+
+        {
+            auto view = filesystem.pin_snapshot_volume("1");
+            filesystem.delete_snapshot_volume("1");
+
+            // frozen blocks are replaced in version 0, only the retired view links them
+            std::string rewritten(data.length(), 'x');
+            filesystem.get_inode_by_id(conf)->write(rewritten.c_str(), rewritten.length(), 0);
+            VERIFY_DATA(filesystem.block_count() > blocks_before_snapshot, true);
+            VERIFY_DATA(filesystem.retired_pending() > 0, true);
+
+            filesystem.collect_retired();
+            VERIFY_DATA(filesystem.retired_pending() > 0, true);
+
+            std::string read_back(data.length(), 0);
+            view->read(view->get_inode_id_by_path("/Xorg.conf"), read_back.data(), read_back.length(), 0);
+            VERIFY_DATA(read_back, data);
+        }
+
+        // nothing else happens to snapshot volumes, collection alone frees view and its blocks
+        VERIFY_DATA(filesystem.retired_pending() > 0, true);
+        filesystem.collect_retired();
+        VERIFY_DATA(filesystem.retired_pending(), 0);
+        VERIFY_DATA(filesystem.block_count(), blocks_before_snapshot);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,352 @@
+/** @file
+ *
+ * This file defines test for tar archive import and export
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/tar_archive.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <sys/sysmacros.h>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+/// make a ustar entry by hand, data is padded
+std::string make_entry(const std::string & name, char typeflag, const std::string & data = "",
+                       const std::string & linkname = "")
+{
+    char header [512] { };
+    memcpy(header, name.c_str(), name.length());
+    snprintf(header + 100, 8, "%07o", 0644);
+    snprintf(header + 108, 8, "%07o", 0);
+    snprintf(header + 116, 8, "%07o", 0);
+    snprintf(header + 124, 12, "%011lo", (unsigned long)data.length());
+    snprintf(header + 136, 12, "%011o", 0);
+    header[156] = typeflag;
+    memcpy(header + 157, linkname.c_str(), linkname.length());
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    unsigned int checksum = 0;
+    memset(header + 148, ' ', 8);
+    for (unsigned char i : header)
+    {
+        checksum += i;
+    }
+
+    snprintf(header + 148, 8, "%06o", checksum);
+
+    std::string entry(header, 512);
+    entry += data;
+    entry.append((512 - data.length() % 512) % 512, 0);
+    return entry;
+}
+
+/// read all data of a file of a version
+std::string read_file(inode_smi_t & filesystem, const std::string & pathname,
+                      const snapshot_ver_t & version = FILESYSTEM_CUR_MODIFIABLE_VER)
+{
+    auto * inode = filesystem.get_inode_by_id(filesystem.get_inode_id_by_path(pathname));
+    std::string data(inode->current_data_size(version), 0);
+    inode->read(version, data.data(), data.length(), 0);
+    return data;
+}
+
+/// archive stream that records whether a lock was held while it was read
+class lock_checking_streambuf_t : public std::streambuf
+{
+private:
+    std::string bytes;
+    htmpfs_size_t offset = 0;
+    std::mutex & lock;
+
+protected:
+    int_type underflow() override
+    {
+        if (offset >= bytes.length())
+        {
+            return traits_type::eof();
+        }
+
+        // lock is tried from another thread, calling thread may own it
+        std::thread([&] {
+            if (lock.try_lock())
+            {
+                lock.unlock();
+            }
+            else
+            {
+                read_while_locked = true;
+            }
+        }).join();
+
+        auto length = std::min < htmpfs_size_t > (4096, bytes.length() - offset);
+        setg(bytes.data() + offset, bytes.data() + offset, bytes.data() + offset + length);
+        offset += length;
+        return traits_type::to_int_type(*gptr());
+    }
+
+public:
+    bool read_while_locked = false;
+
+    lock_checking_streambuf_t(std::string _bytes, std::mutex & _lock) : bytes(std::move(_bytes)), lock(_lock) { }
+};
+
+int main()
+{
+    const std::string long_name(150, 'n');
+    std::string large_data(3 * 1024 * 1024 + 17, 0);
+    for (uint64_t i = 0; i < large_data.length(); i++)
+    {
+        large_data[i] = (char)(i * 131 % 251);
+    }
+
+    std::string archive;
+
+    {
+        /// instance 1: export and import back, byte for byte
+
+        INSTANCE("TAR ARCHIVE: instance 1: export and import back");
+        inode_smi_t filesystem(4096);
+        auto etc = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "etc", true);
+        auto conf = filesystem.make_child_dentry_under_parent(etc, "Xorg.conf");
+        filesystem.get_inode_by_id(conf)->write("Section \"Device\"", 16, 0);
+        auto deep = filesystem.make_child_dentry_under_parent(etc, long_name, true);
+        auto large = filesystem.make_child_dentry_under_parent(deep, "large");
+        filesystem.get_inode_by_id(large)->write(large_data.c_str(), large_data.length(), 0);
+        filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "empty", true);
+
+        inode_stat_t attributes;
+        attributes.st_mode = 0777;
+        filesystem.apply_namespace_batch({
+            { .operation = namespace_op_t::NAMESPACE_SYMLINK, .parent_inode_id = etc,
+              .name = "X11", .symlink_target = "../usr/share/X11/" + long_name, .attributes = attributes },
+        });
+
+        std::ostringstream output;
+        auto exported = tar_export(filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, output);
+        archive = output.str();
+        VERIFY_DATA(exported.directories, 3);
+        VERIFY_DATA(exported.files, 2);
+        VERIFY_DATA(exported.symlinks, 1);
+        VERIFY_DATA(exported.bytes, large_data.length() + 16);
+        VERIFY_DATA(archive.length() % 512, 0);
+
+        inode_smi_t imported_filesystem(4096);
+        std::istringstream input(archive);
+        auto imported = tar_import(imported_filesystem, input);
+        VERIFY_DATA(imported.directories, 3);
+        VERIFY_DATA(imported.files, 2);
+        VERIFY_DATA(imported.symlinks, 1);
+        VERIFY_DATA(imported.skipped, 0);
+
+        VERIFY_DATA(read_file(imported_filesystem, "/etc/Xorg.conf"), "Section \"Device\"");
+        VERIFY_DATA(read_file(imported_filesystem, "/etc/" + long_name + "/large"), large_data);
+        VERIFY_DATA(read_file(imported_filesystem, "/etc/X11"), "../usr/share/X11/" + long_name);
+        auto * link = imported_filesystem.get_inode_by_id(imported_filesystem.get_inode_id_by_path("/etc/X11"));
+        VERIFY_DATA(S_ISLNK(link->fs_stat.st_mode), true);
+        VERIFY_DATA(imported_filesystem.get_inode_by_id(
+                imported_filesystem.get_inode_id_by_path("/empty"))->__is_dentry(), true);
+
+        std::ostringstream reexported;
+        tar_export(imported_filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, reexported);
+        VERIFY_DATA(reexported.str(), archive);
+
+        // a shared filesystem is not locked while archive is read
+        inode_smi_t shared_filesystem(4096);
+        std::mutex lock;
+        lock_checking_streambuf_t checking_buffer(archive, lock);
+        std::istream checking_input(&checking_buffer);
+        auto locked_import = tar_import(shared_filesystem, checking_input, FILESYSTEM_ROOT_INODE_NUMBER, &lock);
+        VERIFY_DATA(checking_buffer.read_while_locked, false);
+        VERIFY_DATA(locked_import.bytes, large_data.length() + 16);
+        VERIFY_DATA(read_file(shared_filesystem, "/etc/" + long_name + "/large"), large_data);
+
+        // snapshot volume is exported as it was
+        filesystem.create_snapshot_volume("1");
+        filesystem.remove_tree(FILESYSTEM_ROOT_INODE_NUMBER, "etc");
+        std::ostringstream snapshot_output;
+        tar_export(filesystem, "1", snapshot_output);
+        VERIFY_DATA(snapshot_output.str(), archive);
+    }
+
+    {
+        /// instance 2: import into an existing tree
+
+        INSTANCE("TAR ARCHIVE: instance 2: import into an existing tree");
+        inode_smi_t filesystem(7);
+        auto srv = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "srv", true);
+        auto etc = filesystem.make_child_dentry_under_parent(srv, "etc", true);
+        auto kept = filesystem.make_child_dentry_under_parent(etc, "kept");
+        filesystem.get_inode_by_id(kept)->write("kept", 4, 0);
+        auto replaced = filesystem.make_child_dentry_under_parent(etc, "replaced");
+        filesystem.get_inode_by_id(replaced)->write("old content", 11, 0);
+
+        std::string input_archive =
+                make_entry("./etc/", '5')
+                + make_entry("./etc/replaced", '0', "new")
+                + make_entry("./usr/lib/libc.so", '0', "ELF")     /* parent directories are made */
+                + make_entry("./usr/lib/hard", '1', "", "usr/lib/libc.so")
+                + make_entry("../escape", '0', "escape")
+                + make_entry("./etc/replaced", '0', "newer")     /* listed twice, last one wins */
+                + std::string(1024, 0)
+                + make_entry("after_end", '0', "ignored");
+
+        std::istringstream input(input_archive);
+        auto imported = tar_import(filesystem, input, srv);
+        VERIFY_DATA(imported.directories, 1);
+        VERIFY_DATA(imported.files, 3);
+        VERIFY_DATA(imported.skipped, 2);
+
+        VERIFY_DATA(filesystem.get_inode_id_by_path("/srv/etc"), etc);
+        VERIFY_DATA(read_file(filesystem, "/srv/etc/kept"), "kept");
+        VERIFY_DATA(read_file(filesystem, "/srv/etc/replaced"), "newer");
+        VERIFY_DATA(read_file(filesystem, "/srv/usr/lib/libc.so"), "ELF");
+        VERIFY_DATA((filesystem.get_inode_by_id(
+                filesystem.get_inode_id_by_path("/srv/usr/lib/libc.so"))->fs_stat.st_mode & 07777), 0644);
+
+        inode_id_t inode_id;
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/srv/usr/lib/hard", inode_id), false);
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/escape", inode_id), false);
+        VERIFY_DATA(filesystem.try_get_inode_id_by_path("/srv/after_end", inode_id), false);
+    }
+
+    {
+        /// instance 3: malformed archives
+
+        INSTANCE("TAR ARCHIVE: instance 3: malformed archives");
+        inode_smi_t filesystem(7);
+
+        auto verify_malformed = [&](const std::string & input_archive)->bool
+        {
+            try {
+                std::istringstream input(input_archive);
+                tar_import(filesystem, input);
+                return false;
+            } catch (HTMPFS_error_t & err) {
+                return err.my_errcode() == HTMPFS_MALFORMED_ARCHIVE;
+            }
+        };
+
+        // bad checksum
+        auto corrupted = make_entry("file", '0', "data");
+        corrupted[0] = 'F';
+        VERIFY_DATA(verify_malformed(corrupted), true);
+
+        // truncated data and truncated header
+        VERIFY_DATA(verify_malformed(make_entry("file", '0', "data").substr(0, 514)), true);
+        VERIFY_DATA(verify_malformed(archive.substr(0, 100)), true);
+
+        // nothing was made by failed imports
+        VERIFY_DATA(filesystem._snapshot_version_list.at(FILESYSTEM_CUR_MODIFIABLE_VER).size(), 1);
+    }
+
+    {
+        /// instance 4: base image shared by filesystems
+
+        INSTANCE("TAR ARCHIVE: instance 4: base image shared by filesystems");
+        char image [] = "/tmp/htmpfs_image.XXXXXX";
+        int fd = mkstemp(image);
+        VERIFY_DATA(write(fd, archive.c_str(), archive.length()), (ssize_t)archive.length());
+        close(fd);
+
+        const std::string large_path = "/etc/" + long_name + "/large";
+        inode_smi_t first(4096), second(4096);
+        auto loaded = tar_load_image(first, image);
+        tar_load_image(second, image);
+        unlink(image);
+        VERIFY_DATA(loaded.files, 2);
+        VERIFY_DATA(loaded.bytes, large_data.length() + 16);
+        VERIFY_DATA(read_file(first, large_path), large_data);
+        VERIFY_DATA(read_file(second, "/etc/Xorg.conf"), "Section \"Device\"");
+
+        // writes are made on private blocks, image and other filesystem are left untouched
+        first.create_snapshot_volume("1");
+        auto * large = first.get_inode_by_id(first.get_inode_id_by_path(large_path));
+        large->write("written", 7, 4096 * 2 + 1, false);
+        large->truncate(4096 * 3 + 1);
+        auto expected = large_data.substr(0, 4096 * 2 + 1) + "written" + large_data.substr(4096 * 2 + 8, 4096 - 7);
+        VERIFY_DATA(read_file(first, large_path), expected);
+        VERIFY_DATA(read_file(first, "/.snapshot/1" + large_path, "1"), large_data);
+        VERIFY_DATA(read_file(second, large_path), large_data);
+
+        // exported as it was imported
+        std::ostringstream output;
+        tar_export(second, FILESYSTEM_CUR_MODIFIABLE_VER, output);
+        VERIFY_DATA(output.str(), archive);
+    }
+
+    {
+        /// instance 5: fifos and device nodes are kept, sockets are skipped
+
+        INSTANCE("TAR ARCHIVE: instance 5: special files");
+        inode_smi_t filesystem(4096);
+        auto dev = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "dev", true);
+
+        inode_stat_t fifo, null, loop, socket;
+        fifo.st_mode = S_IFIFO | 0600;
+        null.st_mode = S_IFCHR | 0666;
+        null.st_dev = makedev(1, 3);
+        loop.st_mode = S_IFBLK | 0660;
+        loop.st_dev = makedev(7, 1);
+        socket.st_mode = S_IFSOCK | 0755;
+        filesystem.apply_namespace_batch({
+            { .operation = namespace_op_t::NAMESPACE_MKNOD, .parent_inode_id = dev,
+              .name = "initctl", .symlink_target = "", .attributes = fifo },
+            { .operation = namespace_op_t::NAMESPACE_MKNOD, .parent_inode_id = dev,
+              .name = "null", .symlink_target = "", .attributes = null },
+            { .operation = namespace_op_t::NAMESPACE_MKNOD, .parent_inode_id = dev,
+              .name = "loop1", .symlink_target = "", .attributes = loop },
+            { .operation = namespace_op_t::NAMESPACE_MKNOD, .parent_inode_id = dev,
+              .name = "log", .symlink_target = "", .attributes = socket },
+        });
+
+        std::ostringstream output;
+        auto exported = tar_export(filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, output);
+        VERIFY_DATA(exported.specials, 3);
+        VERIFY_DATA(exported.skipped, 1);
+        VERIFY_DATA(exported.files, 0);
+
+        inode_smi_t imported_filesystem(4096);
+        std::istringstream input(output.str());
+        auto imported = tar_import(imported_filesystem, input);
+        VERIFY_DATA(imported.specials, 3);
+
+        auto stat_of = [&](const std::string & pathname)
+        {
+            return imported_filesystem.get_inode_by_id(imported_filesystem.get_inode_id_by_path(pathname))->fs_stat;
+        };
+
+        VERIFY_DATA(stat_of("/dev/initctl").st_mode, (uint32_t)(S_IFIFO | 0600));
+        VERIFY_DATA(stat_of("/dev/null").st_mode, (uint32_t)(S_IFCHR | 0666));
+        VERIFY_DATA(stat_of("/dev/null").st_dev, makedev(1, 3));
+        VERIFY_DATA(stat_of("/dev/loop1").st_mode, (uint32_t)(S_IFBLK | 0660));
+        VERIFY_DATA(stat_of("/dev/loop1").st_dev, makedev(7, 1));
+        inode_id_t inode_id;
+        VERIFY_DATA(imported_filesystem.try_get_inode_id_by_path("/dev/log", inode_id), false);
+
+        std::ostringstream reexported;
+        tar_export(imported_filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, reexported);
+        VERIFY_DATA(reexported.str(), output.str());
+
+        // a regular file is not made by mknod
+        try {
+            filesystem.apply_namespace_batch({
+                { .operation = namespace_op_t::NAMESPACE_MKNOD, .parent_inode_id = dev,
+                  .name = "file", .symlink_target = "", .attributes = inode_stat_t { } },
+            });
+
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_INVALID_BATCH_OPERATION);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
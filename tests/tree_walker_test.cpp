@@ -0,0 +1,208 @@
+/** @file
+ *
+ * This file defines test for full-tree traversal
+ */
+
+#include <htmpfs/htmpfs.h>
+#include <htmpfs/tree_walker.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+
+#define VERIFY_DATA(val, tag) if ((tag) != (val)) { return EXIT_FAILURE; } __asm__("nop")
+
+/// list pathnames met by a cursor
+std::vector < std::string > list_by_cursor(tree_cursor_t & cursor)
+{
+    std::vector < std::string > ret;
+    tree_entry_t entry { };
+    while (cursor.next(entry))
+    {
+        ret.emplace_back(entry.pathname);
+    }
+
+    return ret;
+}
+
+int main()
+{
+    /*
+     * /a/            /b/
+     *  x              d/
+     *  c/              y
+     *   z             e/
+     *                  f/
+     *                   w
+     * */
+    inode_smi_t filesystem(7);
+    auto a = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "a", true);
+    auto b = filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "b", true);
+    auto x = filesystem.make_child_dentry_under_parent(a, "x");
+    filesystem.get_inode_by_id(x)->write("data of x", 9, 0);
+    auto c = filesystem.make_child_dentry_under_parent(a, "c", true);
+    filesystem.make_child_dentry_under_parent(c, "z");
+    auto d = filesystem.make_child_dentry_under_parent(b, "d", true);
+    filesystem.make_child_dentry_under_parent(d, "y");
+    auto e = filesystem.make_child_dentry_under_parent(b, "e", true);
+    auto f = filesystem.make_child_dentry_under_parent(e, "f", true);
+    filesystem.make_child_dentry_under_parent(f, "w");
+
+    const std::vector < std::string > pre_order = {
+            "/a", "/a/x", "/a/c", "/a/c/z", "/b", "/b/d", "/b/d/y", "/b/e", "/b/e/f", "/b/e/f/w" };
+
+    {
+        /// instance 1: pre-order walk of version 0
+
+        INSTANCE("TREE WALKER: instance 1: pre-order walk");
+        std::vector < std::string > visited;
+        walk_tree(filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, [&](const tree_entry_t & entry)
+        {
+            visited.emplace_back(entry.pathname);
+            if (entry.pathname == "/a/x")
+            {
+                if (entry.inode_id != x || entry.attributes.st_size != 9 || entry.is_dentry || entry.depth != 2)
+                {
+                    visited.emplace_back("bad entry");
+                }
+            }
+
+            return TREE_WALK_CONTINUE;
+        });
+
+        VERIFY_DATA(visited, pre_order);
+        VERIFY_DATA(filesystem.export_as_filesystem_map(FILESYSTEM_CUR_MODIFIABLE_VER), pre_order);
+    }
+
+    {
+        /// instance 2: subtrees skipped and walk stopped
+
+        INSTANCE("TREE WALKER: instance 2: skip and stop");
+        std::vector < std::string > visited;
+        walk_tree(filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, [&](const tree_entry_t & entry)
+        {
+            visited.emplace_back(entry.pathname);
+            if (entry.inode_id == a || entry.inode_id == d)
+            {
+                return TREE_WALK_SKIP_SUBTREE;
+            }
+
+            return entry.inode_id == f ? TREE_WALK_STOP : TREE_WALK_CONTINUE;
+        });
+
+        VERIFY_DATA(visited, std::vector < std::string > ({ "/a", "/b", "/b/d", "/b/e", "/b/e/f" }));
+
+        // subtree walked alone
+        tree_cursor_t cursor(filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, b, "/b");
+        VERIFY_DATA(list_by_cursor(cursor), std::vector < std::string > (pre_order.begin() + 5, pre_order.end()));
+
+        try {
+            tree_cursor_t file_cursor(filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, x);
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_NOT_A_DIRECTORY);
+        }
+    }
+
+    {
+        /// instance 3: cursor walks snapshot volume while version 0 changes
+
+        INSTANCE("TREE WALKER: instance 3: snapshot cursor");
+        filesystem.create_snapshot_volume("1");
+        tree_cursor_t cursor(filesystem, "1");
+        tree_entry_t entry { };
+        VERIFY_DATA(cursor.next(entry), true);
+        VERIFY_DATA(entry.pathname, "/a");
+
+        filesystem.remove_tree(FILESYSTEM_ROOT_INODE_NUMBER, "b");
+        filesystem.make_child_dentry_under_parent(FILESYSTEM_ROOT_INODE_NUMBER, "g");
+
+        std::vector < std::string > visited { "/a" };
+        auto rest = list_by_cursor(cursor);
+        visited.insert(visited.end(), rest.begin(), rest.end());
+        VERIFY_DATA(visited, pre_order);
+        VERIFY_DATA(filesystem.export_as_filesystem_map("1"), pre_order);
+        VERIFY_DATA(filesystem.export_as_filesystem_map(FILESYSTEM_CUR_MODIFIABLE_VER),
+                    std::vector < std::string > ({ "/a", "/a/x", "/a/c", "/a/c/z", "/g" }));
+    }
+
+    {
+        /// instance 4: parallel walk of a wide snapshot volume
+
+        INSTANCE("TREE WALKER: instance 4: parallel walk");
+        inode_smi_t wide_filesystem(7);
+        std::set < std::string > expected;
+        for (int i = 0; i < 16; i++)
+        {
+            auto directory = wide_filesystem.make_child_dentry_under_parent(
+                    FILESYSTEM_ROOT_INODE_NUMBER, "dir" + std::to_string(i), true);
+            expected.emplace("/dir" + std::to_string(i));
+            for (int j = 0; j < 32; j++)
+            {
+                auto sub = wide_filesystem.make_child_dentry_under_parent(directory, "sub" + std::to_string(j), true);
+                wide_filesystem.make_child_dentry_under_parent(sub, "file");
+                expected.emplace("/dir" + std::to_string(i) + "/sub" + std::to_string(j));
+                expected.emplace("/dir" + std::to_string(i) + "/sub" + std::to_string(j) + "/file");
+            }
+        }
+
+        wide_filesystem.create_snapshot_volume("1");
+
+        std::mutex lock;
+        std::set < std::string > visited;
+        bool depth_mismatch = false;
+        walk_tree_parallel(wide_filesystem, "1", 4, [&](const tree_entry_t & entry)
+        {
+            std::lock_guard < std::mutex > guard(lock);
+            auto depth = (htmpfs_size_t)std::count(entry.pathname.begin(), entry.pathname.end(), '/');
+            depth_mismatch |= depth != entry.depth;
+            visited.emplace(entry.pathname);
+            return TREE_WALK_CONTINUE;
+        });
+
+        VERIFY_DATA(visited, expected);
+        VERIFY_DATA(depth_mismatch, false);
+
+        // skipped subtrees are not handed out
+        std::atomic < uint64_t > count { 0 };
+        walk_tree_parallel(wide_filesystem, "1", 4, [&](const tree_entry_t & entry)
+        {
+            count++;
+            return entry.depth == 1 ? TREE_WALK_SKIP_SUBTREE : TREE_WALK_CONTINUE;
+        });
+
+        VERIFY_DATA(count.load(), 16);
+
+        // an exception thrown by a worker reaches caller
+        try {
+            walk_tree_parallel(wide_filesystem, "1", 4, [&](const tree_entry_t & entry)->tree_walk_action_t
+            {
+                if (entry.pathname == "/dir7/sub3/file")
+                {
+                    THROW_HTMPFS_ERROR_STDERR(HTMPFS_REQUESTED_INODE_NOT_FOUND);
+                }
+
+                return TREE_WALK_CONTINUE;
+            });
+
+            return EXIT_FAILURE;
+        } catch (HTMPFS_error_t & err) {
+            VERIFY_DATA(err.my_errcode(), HTMPFS_REQUESTED_INODE_NOT_FOUND);
+        }
+
+        // version 0 is walked on calling thread
+        visited.clear();
+        walk_tree_parallel(wide_filesystem, FILESYSTEM_CUR_MODIFIABLE_VER, 4, [&](const tree_entry_t & entry)
+        {
+            visited.emplace(entry.pathname);
+            return TREE_WALK_CONTINUE;
+        });
+
+        VERIFY_DATA(visited, expected);
+    }
+
+    return EXIT_SUCCESS;
+}